@@ -6,18 +6,71 @@
 #include <iostream>
 #include <vector>
 #include <cstring>
+#include <cstdlib>
+#include <algorithm>
 #include <Utils.h>
 
 namespace asio = boost::asio;
 using tcp = asio::ip::tcp;
+using udp = asio::ip::udp;
 using error_code = boost::system::error_code;
 
+constexpr uint64_t MCAST_MAX_MISSING = 65536;     // larger gaps are not requested: lost, state refreshed by a snapshot
+
+
+// "BTCUSDT" | "*" | "BTCUSDT,ETHUSDT:150000,..." (per-symbol treshold overrides 'def_treshold')
+static std::vector<std::pair<std::string, double>> parse_symbol_list(const std::string& list, double def_treshold)
+{
+    std::vector<std::pair<std::string, double>> symbols;
+
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos)
+            end = list.size();
+
+        std::string item = list.substr(start, end - start);
+        double treshold = def_treshold;
+
+        size_t colon = item.find(':');
+        if (colon != std::string::npos)
+        {
+            treshold = std::atof(item.c_str() + colon + 1);
+            item.resize(colon);
+        }
+
+        if (!item.empty() && item.size() <= 255)
+            symbols.emplace_back(item, treshold);
+
+        start = end + 1;
+    }
+
+    return symbols;
+}
+
+static void put_symbol(std::vector<uint8_t>& payload, const std::string& symbol, double treshold_val)
+{
+    //symbol name
+    payload.push_back(static_cast<uint8_t>(symbol.length()));
+    payload.insert(payload.end(), (uint8_t*)symbol.data(), (uint8_t*)symbol.data() + symbol.length());
+
+    // treshold
+    uint64_t treshold;
+    static_assert(sizeof(treshold) == sizeof(treshold_val), "double size mismatch");
+    std::memcpy(&treshold, &treshold_val, sizeof(treshold));
+    treshold = host_to_net_u64(treshold);
+    payload.insert(payload.end(), (uint8_t*)&treshold, (uint8_t*)&treshold + 8);
+}
+
 
 Client::Client(asio::io_context& io, const std::string& host, uint16_t port, EProtocolDataType signal_type, std::string& coin_symbol)
     : m_io(io),
     m_socket(io),
     m_resolver(io),
     m_reconnect_timer(io),
+    m_query_timer(io),
+    m_mcast_socket(io),
     m_host(host),
     m_port(port),
     m_data_type(signal_type),
@@ -32,6 +85,8 @@ Client::~Client()
 
 void Client::Start()
 {
+    m_subscriptions = parse_symbol_list(m_coin_symbol, m_treshold);
+
     m_reconnect_timer.cancel();
     connect();
 
@@ -44,6 +99,10 @@ void Client::Stop()
     error_code ec;
 
     m_reconnect_timer.cancel();
+    m_query_timer.cancel();
+
+    if (m_mcast_socket.is_open())
+        m_mcast_socket.close(ec);
 
     if (m_socket.is_open())
     {
@@ -88,6 +147,11 @@ void Client::connect()
                     if (m_show_log_msg)
                         std::cout << "Connected to server\n";
 
+                    SocketProfile profile = m_socket_profile;
+                    profile.tx_timestamps = false;
+                    if (!ApplySocketProfile(m_socket, profile))
+                        std::cerr << "Socket profile not fully applied (" << SocketProfileToString(profile) << ")\n";
+
                     clear_data();
 
                     send_subscribe();
@@ -101,26 +165,379 @@ void Client::send_subscribe()
     std::vector<uint8_t> payload;
     payload.push_back(static_cast<uint8_t>(m_data_type));
 
+    if (m_mcast_enabled)
+    {
+        // whales come by multicast: empty symbol list
+        payload.push_back(0);
+        payload.push_back(0);
+        payload.push_back(0);
+    }
+    else if (m_subscriptions.size() == 1)
+    {
+        put_symbol(payload, m_subscriptions[0].first, m_subscriptions[0].second);
+    }
+    else
+    {
+        // symbol list
+        payload.push_back(0);
+        uint16_t cnt = host_to_net_u16(static_cast<uint16_t>(m_subscriptions.size()));
+        payload.insert(payload.end(), (uint8_t*)&cnt, (uint8_t*)&cnt + 2);
 
-    //symbol name
-    payload.push_back(m_coin_symbol.length());
-    payload.insert(payload.end(), (uint8_t*)m_coin_symbol.data(), (uint8_t*)m_coin_symbol.data() + m_coin_symbol.length());
+        for (const auto& [symbol, treshold] : m_subscriptions)
+            put_symbol(payload, symbol, treshold);
+    }
 
+    // encoding (v2 only)
+    if (m_version == PROTOCOL_VERSION_2)
+        payload.push_back(static_cast<uint8_t>(m_encoding));
 
-    // treshold
-    uint64_t treshold;
-    static_assert(sizeof(m_treshold) == sizeof(m_treshold), "double size mismatch");
-    std::memcpy(&treshold, &m_treshold, sizeof(treshold));
-    treshold = host_to_net_u64(treshold);
-    payload.insert(payload.end(), (uint8_t*)&treshold, (uint8_t*)&treshold + 8);
+    // slow-consumer policy & lag budget
+    payload.push_back(static_cast<uint8_t>(m_policy));
+    uint32_t max_lag_kb = host_to_net_u32(m_max_lag_kb);
+    payload.insert(payload.end(), (uint8_t*)&max_lag_kb, (uint8_t*)&max_lag_kb + 4);
+
+    // resume list (v2): the server resends what was missed since the last whale seen per symbol
+    if (m_version == PROTOCOL_VERSION_2 && !m_mcast_enabled)
+    {
+        std::vector<std::pair<std::string, uint64_t>> points;
+        for (size_t i = 0; i < m_last_seq.size() && i < m_symbols.size(); i++)
+        {
+            if (m_last_seq[i] > 0)
+                points.emplace_back(m_symbols[i], m_last_seq[i]);
+        }
+
+        uint16_t cnt = host_to_net_u16(static_cast<uint16_t>(points.size()));
+        payload.insert(payload.end(), (uint8_t*)&cnt, (uint8_t*)&cnt + 2);
+
+        for (const auto& [symbol, last_seq] : points)
+        {
+            payload.push_back(static_cast<uint8_t>(symbol.length()));
+            payload.insert(payload.end(), (uint8_t*)symbol.data(), (uint8_t*)symbol.data() + symbol.length());
+            uint64_t seq = host_to_net_u64(last_seq);
+            payload.insert(payload.end(), (uint8_t*)&seq, (uint8_t*)&seq + 8);
+        }
+    }
+
+    send_frame(MSG_SUBSCRIBE, payload);
+    m_subscribed = true;
+
+    if (m_query_interval_ms > 0)
+        schedule_query();
+
+    start_read_header();
+}
+
+void Client::Query(const std::string& symbols)
+{
+    asio::post(m_io, [this, symbols]()
+        {
+            if (!m_socket.is_open())
+                return;
+
+            auto list = parse_symbol_list(symbols, 0);
+
+            std::vector<uint8_t> payload;
+            uint32_t request_id = host_to_net_u32(++m_query_id);
+            payload.insert(payload.end(), (uint8_t*)&request_id, (uint8_t*)&request_id + 4);
+            uint16_t cnt = host_to_net_u16(static_cast<uint16_t>(list.size()));
+            payload.insert(payload.end(), (uint8_t*)&cnt, (uint8_t*)&cnt + 2);
+
+            for (const auto& item : list)
+            {
+                payload.push_back(static_cast<uint8_t>(item.first.length()));
+                payload.insert(payload.end(), (uint8_t*)item.first.data(), (uint8_t*)item.first.data() + item.first.length());
+            }
 
+            send_frame(MSG_QUERY, payload);
+        });
+}
 
+bool Client::EnableMulticast(const std::string& group, uint16_t port, const std::string& iface)
+{
+    try
+    {
+        auto group_addr = asio::ip::make_address_v4(group);
+
+        m_mcast_socket.open(udp::v4());
+        m_mcast_socket.set_option(asio::socket_base::reuse_address(true));
+        m_mcast_socket.bind(udp::endpoint(asio::ip::address_v4::any(), port));
 
+        if (iface.empty())
+            m_mcast_socket.set_option(asio::ip::multicast::join_group(group_addr));
+        else
+            m_mcast_socket.set_option(asio::ip::multicast::join_group(group_addr, asio::ip::make_address_v4(iface)));
+    }
+    catch (std::exception& ex)
+    {
+        std::cerr << "Multicast " << group << ":" << port << " failed: " << ex.what() << "\n";
+        error_code ec;
+        m_mcast_socket.close(ec);
+        return false;
+    }
+
+    // v2 records and dictionary, gap recovery over the TCP session
+    m_mcast_enabled = true;
+    m_version = PROTOCOL_VERSION_2;
+
+    start_mcast_receive();
+    return true;
+}
+
+void Client::start_mcast_receive()
+{
+    m_mcast_socket.async_receive_from(asio::buffer(m_mcast_buf), m_mcast_sender,
+        [this](const error_code& ec, std::size_t n)
+        {
+            if (ec == asio::error::operation_aborted)
+                return;
+
+            if (!ec)
+                process_datagram(m_mcast_buf.data(), n, false);
+
+            start_mcast_receive();
+        });
+}
+
+void Client::process_datagram(const uint8_t* data, size_t size, bool recovered)
+{
+    SMcastHeader hdr;
+    if (size < sizeof(hdr))
+    {
+        std::cout << "Bad datagram size\n";
+        return;
+    }
+
+    std::memcpy(&hdr, data, sizeof(hdr));
+    if (hdr.signature != PROTOCOL_HEADER_SIGNATURE || sizeof(hdr) + hdr.count * sizeof(SWhaleRecordV2) != size)
+    {
+        std::cout << "Bad datagram\n";
+        return;
+    }
+
+    if (hdr.epoch != m_mcast_epoch)
+    {
+        // retransmitted by a publisher run other than the one we follow: its numbers mean other datagrams
+        if (recovered)
+            return;
+
+        // the publisher restarted (numbering from 1 again): what was missing is gone, the state is refreshed
+        if (m_mcast_expected != 0)
+        {
+            m_cnt_mcast_lost += m_mcast_missing.size();
+            m_mcast_missing.clear();
+            m_mcast_expected = 0;
+            std::cout << "MCAST: publisher restarted, refreshing snapshot\n";
+            Query(SUBSCRIBE_ALL_SYMBOLS);
+        }
+        m_mcast_epoch = hdr.epoch;
+    }
+
+    if (hdr.data_type == MSG_ALIVE)
+    {
+        // heartbeat: seq is the next datagram, a lost tail shows up here
+        if (m_mcast_expected == 0)
+            m_mcast_expected = hdr.seq;
+        else if (hdr.seq > m_mcast_expected)
+        {
+            request_retransmit(m_mcast_expected, hdr.seq);
+            m_mcast_expected = hdr.seq;
+        }
+        return;
+    }
+
+    if (recovered || hdr.seq < m_mcast_expected)
+    {
+        // retransmitted or late: only if still missing (no duplicates)
+        if (m_mcast_missing.erase(hdr.seq) == 0)
+            return;
+        m_cnt_mcast_recovered++;
+    }
+    else
+    {
+        if (m_mcast_expected != 0 && hdr.seq > m_mcast_expected)
+            request_retransmit(m_mcast_expected, hdr.seq);
+        m_mcast_expected = hdr.seq + 1;
+    }
+
+    m_cnt_mcast++;
+
+    for (uint16_t i = 0; i < hdr.count; i++)
+    {
+        SWhaleRecordV2 r;
+        std::memcpy(&r, data + sizeof(hdr) + i * sizeof(r), sizeof(r));
+        show_mcast_whale(r);
+    }
+}
+
+void Client::request_retransmit(uint64_t from_seq, uint64_t to_seq)
+{
+    if (!m_subscribed || !m_socket.is_open() || to_seq - from_seq > MCAST_MAX_MISSING)
+    {
+        m_cnt_mcast_lost += to_seq - from_seq;
+        std::cout << "MCAST: lost datagrams " << from_seq << ".." << to_seq - 1 << ", refreshing snapshot\n";
+        Query(SUBSCRIBE_ALL_SYMBOLS);
+        return;
+    }
+
+    for (uint64_t seq = from_seq; seq < to_seq; seq++)
+        m_mcast_missing.insert(seq);
+
+    for (uint64_t seq = from_seq; seq < to_seq; seq += MCAST_RETRANSMIT_MAX)
+    {
+        uint32_t count = static_cast<uint32_t>((std::min)(to_seq - seq, static_cast<uint64_t>(MCAST_RETRANSMIT_MAX)));
+
+        std::vector<uint8_t> payload(12);
+        uint64_t from_be = host_to_net_u64(seq);
+        uint32_t count_be = host_to_net_u32(count);
+        std::memcpy(payload.data(), &from_be, 8);
+        std::memcpy(payload.data() + 8, &count_be, 4);
+
+        send_frame(MSG_RETRANSMIT, payload);
+    }
+}
+
+void Client::process_retransmit(const std::vector<uint8_t>& body)
+{
+    if (body.size() < 8)
+    {
+        std::cout << "No first_seq\n";
+        return;
+    }
+
+    uint64_t first_available;
+    std::memcpy(&first_available, body.data(), 8);
+
+    size_t pos = 8;
+    while (pos + sizeof(SMcastHeader) <= body.size())
+    {
+        SMcastHeader hdr;
+        std::memcpy(&hdr, body.data() + pos, sizeof(hdr));
+
+        size_t size = sizeof(hdr) + hdr.count * sizeof(SWhaleRecordV2);
+        if (pos + size > body.size())
+        {
+            std::cout << "Bad retransmit data\n";
+            return;
+        }
+
+        process_datagram(body.data() + pos, size, true);
+        pos += size;
+    }
+
+    // gone from the server's ring
+    uint64_t lost = 0;
+    while (!m_mcast_missing.empty() && *m_mcast_missing.begin() < first_available)
+    {
+        m_mcast_missing.erase(m_mcast_missing.begin());
+        lost++;
+    }
+
+    if (lost > 0)
+    {
+        m_cnt_mcast_lost += lost;
+        std::cout << "MCAST: " << lost << " datagrams no longer available, refreshing snapshot\n";
+        Query(SUBSCRIBE_ALL_SYMBOLS);
+    }
+}
+
+void Client::show_mcast_whale(const SWhaleRecordV2& r)
+{
+    // local filter: the multicast group carries every whale
+    const char* symbol = (r.symbol < m_symbols.size()) ? m_symbols[r.symbol].c_str() : nullptr;
+    if (!symbol)
+        return;
+
+    // an explicit symbol overrides the "*" treshold
+    double treshold = -1;
+    for (const auto& [sub_symbol, sub_treshold] : m_subscriptions)
+    {
+        if (sub_symbol == symbol)
+        {
+            treshold = sub_treshold;
+            break;
+        }
+        if (sub_symbol == SUBSCRIBE_ALL_SYMBOLS)
+            treshold = sub_treshold;
+    }
+
+    if (treshold >= 0 && r.price * r.quantity >= treshold)
+        show_whale(symbol, r.is_sell, r.price, r.quantity, r.vwap_sess, r.vwap_roll50, r.delta_roll);
+}
+
+void Client::schedule_query()
+{
+    m_query_timer.expires_after(std::chrono::milliseconds(m_query_interval_ms));
+
+    m_query_timer.async_wait(
+        [this](const error_code& ec)
+        {
+            if (ec == asio::error::operation_aborted || !m_socket.is_open())
+                return;
+
+            Query();
+            schedule_query();
+        });
+}
+
+void Client::UpdateSubscription(const std::string& symbols, ESubscriptionAction action)
+{
+    asio::post(m_io, [this, symbols, action]()
+        {
+            auto changes = parse_symbol_list(symbols, m_treshold);
+
+            // keep the list for resubscribe after reconnect
+            for (const auto& [symbol, treshold] : changes)
+            {
+                if (symbol == SUBSCRIBE_ALL_SYMBOLS && action == ESubscriptionAction::Remove)
+                {
+                    m_subscriptions.clear();
+                    continue;
+                }
+
+                auto it = std::find_if(m_subscriptions.begin(), m_subscriptions.end(), [&symbol](const auto& s) {
+                    return s.first == symbol;
+                    });
+
+                if (action == ESubscriptionAction::Remove)
+                {
+                    if (it != m_subscriptions.end())
+                        m_subscriptions.erase(it);
+                }
+                else if (it != m_subscriptions.end())
+                {
+                    it->second = treshold;
+                }
+                else
+                {
+                    m_subscriptions.emplace_back(symbol, treshold);
+                }
+            }
+
+            if (!m_subscribed || !m_socket.is_open())
+                return;
+
+            // Build update payload
+            std::vector<uint8_t> payload;
+            uint16_t cnt = host_to_net_u16(static_cast<uint16_t>(changes.size()));
+            payload.insert(payload.end(), (uint8_t*)&cnt, (uint8_t*)&cnt + 2);
+
+            for (const auto& [symbol, treshold] : changes)
+            {
+                payload.push_back(static_cast<uint8_t>(action));
+                put_symbol(payload, symbol, treshold);
+            }
+
+            send_frame(MSG_SUBSCRIPTION_UPDATE, payload);
+        });
+}
+
+void Client::send_frame(uint8_t data_type, const std::vector<uint8_t>& payload)
+{
     // Header
     SProtocolHeader hdr;
     hdr.signature = host_to_net_u16(PROTOCOL_HEADER_SIGNATURE);
-    hdr.version = 1;
-    hdr.data_type = 0x01; // subscribe
+    hdr.version = m_version;
+    hdr.data_type = data_type;
     hdr.msg_num = 0;
     hdr.len = host_to_net_u32(static_cast<uint32_t>(payload.size()));  // data length 
 
@@ -131,10 +548,16 @@ void Client::send_subscribe()
         std::memcpy(frame.data() + sizeof(hdr), payload.data(), payload.size());
     }
 
-    auto buf = std::make_shared<std::vector<uint8_t>>(std::move(frame));
+    // one write in flight: frames must not interleave on the socket
+    m_que_send.push_back(std::move(frame));
+    if (m_que_send.size() == 1)
+        do_send();
+}
 
-    asio::async_write(m_socket, asio::buffer(*buf),
-        [this, buf](const error_code& ec, std::size_t /*bytes_transferred*/)
+void Client::do_send()
+{
+    asio::async_write(m_socket, asio::buffer(m_que_send.front()),
+        [this](const error_code& ec, std::size_t /*bytes_transferred*/)
         {
             if (ec == asio::error::operation_aborted)
             {
@@ -143,12 +566,14 @@ void Client::send_subscribe()
 
             if (ec)
             {
-                write_error("Write subscribe failed", ec);
+                write_error("Write failed", ec);
                 schedule_reconnect();
                 return;
             }
 
-            start_read_header();
+            m_que_send.pop_front();
+            if (!m_que_send.empty())
+                do_send();
         });
 }
 
@@ -177,6 +602,9 @@ void Client::start_read_header()
                 return;
             }
 
+            if (m_socket_profile.quick_ack)
+                RearmQuickAck(m_socket);
+
             // validate header
             SProtocolHeader hdr = m_header;
             if (net_to_host_u16(hdr.signature) != PROTOCOL_HEADER_SIGNATURE)
@@ -186,7 +614,7 @@ void Client::start_read_header()
                 return;
             }
 
-            if (hdr.version != 1)
+            if (hdr.version != m_version)
             {
                 std::cerr << "Bad version\n";
                 schedule_reconnect();
@@ -246,157 +674,466 @@ void Client::start_read_body(uint32_t len, uint8_t data_type)
 
 void Client::process_body(uint8_t data_type, const std::vector<uint8_t>& body)
 {
-    static int w_cnt = 0;
+    if (data_type == MSG_DATA)
+    {
+        if (m_version == PROTOCOL_VERSION_2)
+            process_whales_v2(body);
+        else
+            process_whales_v1(body);
+    }
+    else if (data_type == MSG_DATA_DELTA)
+    {
+        process_whales_delta(body);
+    }
+    else if (data_type == MSG_SYMBOL_DICT)
+    {
+        process_symbol_dict(body);
+    }
+    else if (data_type == MSG_GAP)
+    {
+        process_gap(body);
+    }
+    else if (data_type == MSG_SNAPSHOT)
+    {
+        process_snapshot(body.data(), body.size());
+    }
+    else if (data_type == MSG_QUERY_RESULT)
+    {
+        process_query_result(body);
+    }
+    else if (data_type == MSG_RETRANSMIT_DATA)
+    {
+        process_retransmit(body);
+    }
+    else if (data_type == MSG_RESUME)
+    {
+        process_resume(body);
+    }
+    else if (data_type == MSG_VWAP)
+    {
+        m_cnt_vwap++;
+        if (m_show_log_msg)
+            std::cout << "\nVWAP tick:";
+        process_snapshot(body.data(), body.size());
+    }
+    else if (data_type == MSG_ALIVE)
+    {
+        if (m_show_log_msg)
+            std::cout << "Alive msg\n";
+    }
+    else
+    {
+        std::cout << "Unknown msg_data_type=" << int(data_type)  << "\n";
+    }
+}
+
+void Client::process_whales_v1(const std::vector<uint8_t>& body)
+{
+    size_t pos = 0;
 
-    if (data_type == 0x02)
+    if (pos + 4 > body.size())
     {
-        size_t pos = 0;
+        std::cout << "No cont_whale\n";
+        return;
+    }
+
+    uint32_t cnt;
+    std::memcpy(&cnt, body.data() + pos, 4);
+    cnt = net_to_host_u32(cnt);
+    pos += 4;
 
-        if (pos + 4 > body.size())
+    for (int i = 0; i < cnt; i++)
+    {
+        uint64_t ubits;
+
+        // price
+        if (pos + 8 > body.size())
         {
-            std::cout << "No cont_whale\n";
+            std::cout << "No price\n";
             return;
         }
 
-        uint32_t cnt;
-        std::memcpy(&cnt, body.data() + pos, 4);
-        cnt = net_to_host_u32(cnt);
-        pos += 4;
+        std::memcpy(&ubits, body.data() + pos, 8);
+        ubits = net_to_host_u64(ubits);
+        pos += 8;
 
-        for (int i = 0; i < cnt; i++)
+        double price;
+        std::memcpy(&price, &ubits, sizeof(price));
+
+        //quantity
+        if (pos + 8 > body.size())
         {
-            uint64_t ubits;
+            std::cout << "No quantity\n";
+            return;
+        }
 
-            // price
-            if (pos + 8 > body.size())
-            {
-                std::cout << "No price\n";
-                return;
-            }
+        std::memcpy(&ubits, body.data() + pos, 8);
+        ubits = net_to_host_u64(ubits);
+        pos += 8;
 
-            std::memcpy(&ubits, body.data() + pos, 8);
-            ubits = net_to_host_u64(ubits);
-            pos += 8;
+        double quantity;
+        std::memcpy(&quantity, &ubits, sizeof(quantity));
 
-            double price;
-            std::memcpy(&price, &ubits, sizeof(price));
+        //is_sell
+        if (pos + 1 > body.size())
+        {
+            std::cout << "No is_sell\n";
+            return;
+        }
+        uint8_t is_sell = body[pos++];
 
-            //quantity
-            if (pos + 8 > body.size())
-            {
-                std::cout << "No quantity\n";
-                return;
-            }
+        //timestamp
+        if (pos + 8 > body.size())
+        {
+            std::cout << "No timestamp\n";
+            return;
+        }
+        uint64_t timestamp;
+        std::memcpy(&timestamp, body.data() + pos, 8); 
+        timestamp = net_to_host_u32(timestamp);
+        pos += 8;
 
-            std::memcpy(&ubits, body.data() + pos, 8);
-            ubits = net_to_host_u64(ubits);
-            pos += 8;
+        //symbol name_len
+        if (pos + 2 > body.size())
+        {
+            std::cout << "No symbol_length\n";
+            return;
+        }
+        uint16_t symb_len;
+        std::memcpy(&symb_len, body.data() + pos, 2);
+        symb_len = net_to_host_u16(symb_len);
+        pos += 2;
 
-            double quantity;
-            std::memcpy(&quantity, &ubits, sizeof(quantity));
+        //symbol
+        if (pos + symb_len > body.size())
+        {
+            std::cout << "No symbol_data\n";
+            return;
+        }
 
-            //is_sell
-            if (pos + 1 > body.size())
-            {
-                std::cout << "No is_sell\n";
-                return;
-            }
-            uint8_t is_sell = body[pos++];
+        std::string symbol((char*)body.data() + pos, symb_len);
+        pos += symb_len;
 
-            //timestamp
-            if (pos + 8 > body.size())
-            {
-                std::cout << "No timestamp\n";
-                return;
-            }
-            uint64_t timestamp;
-            std::memcpy(&timestamp, body.data() + pos, 8); 
-            timestamp = net_to_host_u32(timestamp);
-            pos += 8;
+        //vwap_sess
+        if (pos + 8 > body.size())
+        {
+            std::cout << "No vwap_sess\n";
+            return;
+        }
 
-            //symbol name_len
-            if (pos + 2 > body.size())
-            {
-                std::cout << "No symbol_length\n";
-                return;
-            }
-            uint16_t symb_len;
-            std::memcpy(&symb_len, body.data() + pos, 2);
-            symb_len = net_to_host_u16(symb_len);
-            pos += 2;
+        std::memcpy(&ubits, body.data() + pos, 8);
+        ubits = net_to_host_u64(ubits);
+        pos += 8;
 
-            //symbol
-            if (pos + symb_len > body.size())
-            {
-                std::cout << "No symbol_data\n";
-                return;
-            }
+        double vwap_sess;
+        std::memcpy(&vwap_sess, &ubits, sizeof(vwap_sess));
 
-            std::string symbol((char*)body.data() + pos, symb_len);
-            pos += symb_len;
+        //vwap_roll50
+        if (pos + 8 > body.size())
+        {
+            std::cout << "No vwap_roll50\n";
+            return;
+        }
 
-            //vwap_sess
-            if (pos + 8 > body.size())
-            {
-                std::cout << "No vwap_sess\n";
-                return;
-            }
+        std::memcpy(&ubits, body.data() + pos, 8);
+        ubits = net_to_host_u64(ubits);
+        pos += 8;
 
-            std::memcpy(&ubits, body.data() + pos, 8);
-            ubits = net_to_host_u64(ubits);
-            pos += 8;
+        double vwap_roll50;
+        std::memcpy(&vwap_roll50, &ubits, sizeof(vwap_roll50));
 
-            double vwap_sess;
-            std::memcpy(&vwap_sess, &ubits, sizeof(vwap_sess));
+        //delta_roll
+        if (pos + 8 > body.size())
+        {
+            std::cout << "No delta_roll\n";
+            return;
+        }
 
-            //vwap_roll50
-            if (pos + 8 > body.size())
-            {
-                std::cout << "No vwap_roll50\n";
-                return;
-            }
+        std::memcpy(&ubits, body.data() + pos, 8);
+        ubits = net_to_host_u64(ubits);
+        pos += 8;
 
-            std::memcpy(&ubits, body.data() + pos, 8);
-            ubits = net_to_host_u64(ubits);
-            pos += 8;
+        double delta_roll;
+        std::memcpy(&delta_roll, &ubits, sizeof(delta_roll));
 
-            double vwap_roll50;
-            std::memcpy(&vwap_roll50, &ubits, sizeof(vwap_roll50));
 
-            //delta_roll
-            if (pos + 8 > body.size())
-            {
-                std::cout << "No delta_roll\n";
-                return;
-            }
+        show_whale(symbol.data(), is_sell, price, quantity, vwap_sess, vwap_roll50, delta_roll);
+
+    }
+}
+
+void Client::process_whales_v2(const std::vector<uint8_t>& body)
+{
+    // fixed 64-byte native records: no per-field parsing, one size check per frame
+    if (body.size() % sizeof(SWhaleRecordV2) != 0)
+    {
+        std::cout << "Bad v2 payload size\n";
+        return;
+    }
+
+    const SWhaleRecordV2* records = reinterpret_cast<const SWhaleRecordV2*>(body.data());
+    size_t cnt = body.size() / sizeof(SWhaleRecordV2);
+
+    for (size_t i = 0; i < cnt; i++)
+    {
+        const SWhaleRecordV2& r = records[i];
+        note_seq(r);
+
+        const char* symbol = (r.symbol < m_symbols.size()) ? m_symbols[r.symbol].c_str() : "?";
+
+        show_whale(symbol, r.is_sell, r.price, r.quantity, r.vwap_sess, r.vwap_roll50, r.delta_roll);
+    }
+}
+
+void Client::process_whales_delta(const std::vector<uint8_t>& body)
+{
+    // every record takes at least 7 bytes, so the body size bounds the count
+    if (m_delta_records.size() < body.size() / 7)
+        m_delta_records.resize(body.size() / 7);
+
+    size_t cnt = 0;
+    if (!DecodeDeltaBatch(body.data(), body.size(), m_delta_records.data(), m_delta_records.size(), cnt))
+    {
+        std::cout << "Bad delta payload\n";
+        return;
+    }
+
+    for (size_t i = 0; i < cnt; i++)
+    {
+        const SWhaleRecordV2& r = m_delta_records[i];
+        note_seq(r);
+
+        const char* symbol = (r.symbol < m_symbols.size()) ? m_symbols[r.symbol].c_str() : "?";
+
+        show_whale(symbol, r.is_sell, r.price, r.quantity, r.vwap_sess, r.vwap_roll50, r.delta_roll);
+    }
+}
+
+void Client::note_seq(const SWhaleRecordV2& r)
+{
+    if (r.symbol >= m_last_seq.size())
+    {
+        if (r.symbol >= m_symbols.size())
+            return;
+        m_last_seq.resize(m_symbols.size(), 0);
+    }
+
+    if (r.seq > m_last_seq[r.symbol])
+        m_last_seq[r.symbol] = r.seq;
+}
+
+void Client::process_resume(const std::vector<uint8_t>& body)
+{
+    // after the resent whales, before the live ones: from here on the numbers continue from the heads
+    if (body.size() % sizeof(SResumeRecordV2) != 0)
+    {
+        std::cout << "Bad resume payload size\n";
+        return;
+    }
 
-            std::memcpy(&ubits, body.data() + pos, 8);
-            ubits = net_to_host_u64(ubits);
+    const size_t cnt = body.size() / sizeof(SResumeRecordV2);
+    for (size_t i = 0; i < cnt; i++)
+    {
+        SResumeRecordV2 r;
+        std::memcpy(&r, body.data() + i * sizeof(r), sizeof(r));
+
+        if (r.symbol >= m_last_seq.size())
+            m_last_seq.resize(r.symbol + 1, 0);
+        m_last_seq[r.symbol] = r.head_seq;
+
+        m_cnt_replayed += r.replayed;
+        m_cnt_resume_lost += r.lost;
+
+        if (m_show_log_msg && (r.replayed > 0 || r.lost > 0))
+        {
+            const char* symbol = (r.symbol < m_symbols.size()) ? m_symbols[r.symbol].c_str() : "?";
+            std::cout << "Resumed " << symbol << ": " << r.replayed << " whales resent";
+            if (r.lost > 0)
+                std::cout << ", " << r.lost << " no longer kept";
+            std::cout << "\n";
+        }
+    }
+}
+
+void Client::process_gap(const std::vector<uint8_t>& body)
+{
+    if (body.size() < 4)
+    {
+        std::cout << "No gap_count\n";
+        return;
+    }
+
+    uint32_t dropped;
+    std::memcpy(&dropped, body.data(), 4);
+    if (m_version == PROTOCOL_VERSION_1)
+        dropped = net_to_host_u32(dropped);
+
+    m_cnt_gap += dropped;
+
+    std::cout << "GAP: server dropped " << dropped << " whales (slow consumer), total " << m_cnt_gap << "\n";
+}
+
+void Client::process_query_result(const std::vector<uint8_t>& body)
+{
+    if (body.size() < 4)
+    {
+        std::cout << "No request_id\n";
+        return;
+    }
+
+    uint32_t request_id;
+    std::memcpy(&request_id, body.data(), 4);
+    if (m_version == PROTOCOL_VERSION_1)
+        request_id = net_to_host_u32(request_id);
+
+    m_cnt_query_result++;
+
+    if (m_show_log_msg)
+        std::cout << "\nQUERY #" << request_id << ":";
+
+    process_snapshot(body.data() + 4, body.size() - 4);
+}
+
+void Client::process_snapshot(const uint8_t* data, size_t size)
+{
+    if (m_version == PROTOCOL_VERSION_2)
+    {
+        if (size % sizeof(SSnapshotRecordV2) != 0)
+        {
+            std::cout << "Bad v2 snapshot size\n";
+            return;
+        }
+
+        size_t cnt = size / sizeof(SSnapshotRecordV2);
+        for (size_t i = 0; i < cnt; i++)
+        {
+            SSnapshotRecordV2 r;
+            std::memcpy(&r, data + i * sizeof(r), sizeof(r));
+
+            const char* symbol = (r.symbol < m_symbols.size()) ? m_symbols[r.symbol].c_str() : "?";
+            show_snapshot(symbol, r);
+        }
+        return;
+    }
+
+    // v1: count + { symbol, 5 doubles / 2 uint64 interleaved }, all big-endian
+    size_t pos = 0;
+
+    if (pos + 4 > size)
+    {
+        std::cout << "No snapshot_count\n";
+        return;
+    }
+
+    uint32_t cnt;
+    std::memcpy(&cnt, data + pos, 4);
+    cnt = net_to_host_u32(cnt);
+    pos += 4;
+
+    for (uint32_t i = 0; i < cnt; i++)
+    {
+        if (pos + 2 > size)
+        {
+            std::cout << "No symbol_length\n";
+            return;
+        }
+        uint16_t symb_len;
+        std::memcpy(&symb_len, data + pos, 2);
+        symb_len = net_to_host_u16(symb_len);
+        pos += 2;
+
+        if (pos + symb_len + 7 * 8 > size)
+        {
+            std::cout << "No snapshot_data\n";
+            return;
+        }
+
+        std::string symbol((char*)data + pos, symb_len);
+        pos += symb_len;
+
+        uint64_t v[7];
+        for (auto& x : v)
+        {
+            std::memcpy(&x, data + pos, 8);
+            x = net_to_host_u64(x);
             pos += 8;
+        }
 
-            double delta_roll;
-            std::memcpy(&delta_roll, &ubits, sizeof(delta_roll));
+        SSnapshotRecordV2 r{};
+        std::memcpy(&r.last_price, &v[0], 8);
+        std::memcpy(&r.last_qty, &v[1], 8);
+        r.timestamp = v[2];
+        std::memcpy(&r.vwap_sess, &v[3], 8);
+        std::memcpy(&r.vwap_roll50, &v[4], 8);
+        std::memcpy(&r.volume_sess, &v[5], 8);
+        r.trade_cnt = v[6];
 
+        show_snapshot(symbol.c_str(), r);
+    }
+}
 
-            if (m_show_log_msg)
-            {
-                if(m_ext_vwap)
-                    printf("\nWHALE ALERT! [%s] %s: total=%.2f price=%.2f qty==%.2f VWAP=%.2f VWAP_roll=%.2f delta_roll=%.2f \n", symbol.data(), is_sell ? "sell" : "buy", price * quantity, price, quantity, vwap_sess, vwap_roll50, delta_roll);
-                else
-                    printf("\nWHALE ALERT! [%s] %s: total = %.2f price = %.2f qty = %.2f VWAP = %.2f\n", symbol.data(), is_sell? "sell" : "buy",  price * quantity, price, quantity, vwap_sess);
-            }
+void Client::process_symbol_dict(const std::vector<uint8_t>& body)
+{
+    size_t pos = 0;
+
+    if (pos + 4 > body.size())
+    {
+        std::cout << "No dict_count\n";
+        return;
+    }
+
+    uint32_t cnt;
+    std::memcpy(&cnt, body.data() + pos, 4);
+    pos += 4;
 
+    m_symbols.clear();
+
+    for (uint32_t i = 0; i < cnt; i++)
+    {
+        if (pos + 5 > body.size())
+        {
+            std::cout << "No dict_entry\n";
+            return;
+        }
+
+        uint32_t index;
+        std::memcpy(&index, body.data() + pos, 4);
+        pos += 4;
+
+        uint8_t len = body[pos++];
+        if (pos + len > body.size())
+        {
+            std::cout << "No dict_symbol\n";
+            return;
         }
 
+        if (index >= m_symbols.size())
+            m_symbols.resize(index + 1);
+
+        m_symbols[index].assign((const char*)body.data() + pos, len);
+        pos += len;
     }
-    else if (data_type == 0x03)
+}
+
+void Client::show_whale(const char* symbol, bool is_sell, double price, double quantity, double vwap_sess, double vwap_roll50, double delta_roll)
+{
+    if (m_show_log_msg)
     {
-        if (m_show_log_msg)
-            std::cout << "Alive msg\n";
+        if(m_ext_vwap)
+            printf("\nWHALE ALERT! [%s] %s: total=%.2f price=%.2f qty==%.2f VWAP=%.2f VWAP_roll=%.2f delta_roll=%.2f \n", symbol, is_sell ? "sell" : "buy", price * quantity, price, quantity, vwap_sess, vwap_roll50, delta_roll);
+        else
+            printf("\nWHALE ALERT! [%s] %s: total = %.2f price = %.2f qty = %.2f VWAP = %.2f\n", symbol, is_sell? "sell" : "buy",  price * quantity, price, quantity, vwap_sess);
     }
-    else
+}
+
+void Client::show_snapshot(const char* symbol, const SSnapshotRecordV2& s)
+{
+    if (m_show_log_msg)
     {
-        std::cout << "Unknown msg_data_type=" << int(data_type)  << "\n";
+        if (m_ext_vwap)
+            printf("\nSNAPSHOT [%s]: last=%.2f qty=%.4f VWAP=%.2f VWAP_roll=%.2f volume=%.4f trades=%llu\n", symbol, s.last_price, s.last_qty, s.vwap_sess, s.vwap_roll50, s.volume_sess, (unsigned long long)s.trade_cnt);
+        else
+            printf("\nSNAPSHOT [%s]: last = %.2f qty = %.4f VWAP = %.2f volume = %.4f trades = %llu\n", symbol, s.last_price, s.last_qty, s.vwap_sess, s.volume_sess, (unsigned long long)s.trade_cnt);
     }
 }
 
@@ -425,4 +1162,10 @@ void Client::schedule_reconnect()
 void Client::clear_data()
 {
     m_cnt_packet = 0;
+    m_que_send.clear();
+    m_subscribed = false;
+
+    // retransmit requests of the previous connection are not answered
+    m_cnt_mcast_lost += m_mcast_missing.size();
+    m_mcast_missing.clear();
 }
\ No newline at end of file
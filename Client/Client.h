@@ -3,8 +3,13 @@
 #include <boost/asio.hpp>
 #include <string>
 #include <vector>
+#include <deque>
+#include <set>
+#include <array>
 #include <cstdint>
 #include "Protocol.h"
+#include "DeltaCodec.h"
+#include "SocketProfile.h"
 
 
 
@@ -25,16 +30,63 @@ public:
     bool IsShowLogMsg() { return m_show_log_msg; }
     void SetExtVwap(bool ext) { m_ext_vwap = ext; }
     void SetWhaleTreshold(double treshold) { m_treshold = treshold; }
+    void SetProtocolVersion(uint8_t version) { m_version = version; }
+    void SetEncoding(EProtocolEncoding encoding) { m_encoding = encoding; }
+    void SetSlowConsumerPolicy(ESlowConsumerPolicy policy, uint32_t max_lag_kb = 0) { m_policy = policy; m_max_lag_kb = max_lag_kb; }
+
+    // in-band change of a live subscription ("ETHUSDT:150000,SOLUSDT" / "*"), no reconnect
+    void UpdateSubscription(const std::string& symbols, ESubscriptionAction action);
+
+    // current analytics from the server ("BTCUSDT,ETHUSDT" / "*", empty - the subscribed symbols), answered by MSG_QUERY_RESULT
+    void Query(const std::string& symbols = std::string());
+    // repeat Query() for the subscribed symbols every 'ms' milliseconds, 0 - off
+    void SetQueryInterval(uint32_t ms) { m_query_interval_ms = ms; }
+
+    // applied to the socket after every (re)connect; TX timestamps are a server-side option
+    void SetSocketProfile(const SocketProfile& profile) { m_socket_profile = profile; }
+
+    // whales from the server's UDP multicast (call before Start()): the TCP session (v2, no symbols)
+    // only carries the dictionary and gap recovery; symbols and tresholds are filtered locally
+    bool EnableMulticast(const std::string& group, uint16_t port, const std::string& iface = std::string());
 
     //MapSignal GeSignals();
     uint64_t GetPacketCount() { return m_cnt_packet; }
+    uint64_t GetGapCount() { return m_cnt_gap; }
+    uint64_t GetQueryResultCount() { return m_cnt_query_result; }
+    uint64_t GetVwapTickCount() { return m_cnt_vwap; }
+    uint64_t GetMcastDatagramCount() { return m_cnt_mcast; }
+    uint64_t GetMcastRecoveredCount() { return m_cnt_mcast_recovered; }
+    uint64_t GetMcastLostCount() { return m_cnt_mcast_lost; }
+    uint64_t GetReplayedCount() { return m_cnt_replayed; }
+    uint64_t GetResumeLostCount() { return m_cnt_resume_lost; }
+    // last whale number seen of a v2 symbol index, 0 - none
+    uint64_t GetLastSeq(uint32_t symbol) { return symbol < m_last_seq.size() ? m_last_seq[symbol] : 0; }
 
 private:
     void connect();
     void send_subscribe();
+    void send_frame(uint8_t data_type, const std::vector<uint8_t>& payload);
+    void do_send();
     void start_read_header();
     void start_read_body(uint32_t len, uint8_t data_type);
     virtual void process_body(uint8_t type, const std::vector<uint8_t>& body);
+    void process_whales_v1(const std::vector<uint8_t>& body);
+    void process_whales_v2(const std::vector<uint8_t>& body);
+    void process_whales_delta(const std::vector<uint8_t>& body);
+    void process_symbol_dict(const std::vector<uint8_t>& body);
+    void process_gap(const std::vector<uint8_t>& body);
+    void process_snapshot(const uint8_t* data, size_t size);
+    void process_query_result(const std::vector<uint8_t>& body);
+    void process_resume(const std::vector<uint8_t>& body);
+    void note_seq(const SWhaleRecordV2& r);
+    void schedule_query();
+    void start_mcast_receive();
+    void process_datagram(const uint8_t* data, size_t size, bool recovered);
+    void request_retransmit(uint64_t from_seq, uint64_t to_seq);
+    void process_retransmit(const std::vector<uint8_t>& body);
+    void show_mcast_whale(const SWhaleRecordV2& r);
+    void show_snapshot(const char* symbol, const SSnapshotRecordV2& s);
+    void show_whale(const char* symbol, bool is_sell, double price, double quantity, double vwap_sess, double vwap_roll50, double delta_roll);
     void schedule_reconnect();
     void clear_data();
 
@@ -44,13 +96,48 @@ protected:
     boost::asio::ip::tcp::socket m_socket;
     boost::asio::ip::tcp::resolver m_resolver;
     boost::asio::steady_timer m_reconnect_timer;
+    boost::asio::steady_timer m_query_timer;
+    boost::asio::ip::udp::socket m_mcast_socket;
 
     std::string m_host;
     uint16_t m_port;
+    SocketProfile m_socket_profile;
     EProtocolDataType m_data_type;
     
     std::string m_coin_symbol;
     double m_treshold = 100'000;
+    std::vector<std::pair<std::string, double>> m_subscriptions;    // (symbol, treshold), current set
+    bool m_subscribed{ false };
+
+    std::deque<std::vector<uint8_t>> m_que_send;
+
+    uint8_t m_version{ PROTOCOL_VERSION_1 };
+    EProtocolEncoding m_encoding{ EProtocolEncoding::Fixed };
+    ESlowConsumerPolicy m_policy{ ESlowConsumerPolicy::DropNewest };
+    uint32_t m_max_lag_kb{ 0 };
+    uint64_t m_cnt_gap{ 0 };        // whales the server dropped for us (gap notices)
+    uint32_t m_query_interval_ms{ 0 };
+    uint32_t m_query_id{ 0 };
+    uint64_t m_cnt_query_result{ 0 };
+    uint64_t m_cnt_vwap{ 0 };       // VWAP ticker frames (req_type with EProtocolDataType::VWAP)
+
+    // multicast receiver
+    bool m_mcast_enabled{ false };
+    std::array<uint8_t, MCAST_MAX_DATAGRAM> m_mcast_buf;
+    boost::asio::ip::udp::endpoint m_mcast_sender;
+    uint64_t m_mcast_expected{ 0 };         // next datagram seq, 0 - nothing received yet
+    uint16_t m_mcast_epoch{ 0 };            // publisher run the numbers belong to, 0 - none yet
+    std::set<uint64_t> m_mcast_missing;     // requested for retransmit
+    uint64_t m_cnt_mcast{ 0 };
+    uint64_t m_cnt_mcast_recovered{ 0 };
+    uint64_t m_cnt_mcast_lost{ 0 };
+    std::vector<std::string> m_symbols;     // v2 symbol dictionary [index]
+
+    // resume (v2 TCP): last whale number per symbol, kept across reconnects and sent with the next subscribe
+    std::vector<uint64_t> m_last_seq;       // [symbol index]
+    uint64_t m_cnt_replayed{ 0 };
+    uint64_t m_cnt_resume_lost{ 0 };
+    std::vector<SWhaleRecordV2> m_delta_records;    // decoded MSG_DATA_DELTA batch
 
     // inbound buffers/state
     SProtocolHeader m_header;
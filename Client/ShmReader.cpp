@@ -0,0 +1,112 @@
+// Co-located consumer of the server's shared-memory whale channel (Server --shm_name=channel name).
+// Usage: ShmReader <name> [quiet]
+#include <ShmChannel.h>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <csignal>
+#include <atomic>
+
+
+static std::atomic<bool> g_running{ true };
+
+void signal_handler(int s)
+{
+    g_running = false;
+}
+
+static double tsc_ghz()
+{
+    auto t1 = std::chrono::steady_clock::now();
+    uint64_t r1 = __rdtsc();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto t2 = std::chrono::steady_clock::now();
+    uint64_t r2 = __rdtsc();
+
+    return (double)(r2 - r1) / (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: ShmReader <name> [quiet]\n";
+        return 1;
+    }
+
+    const bool quiet = (argc >= 3) && std::atoi(argv[2]);
+
+    signal(SIGINT, signal_handler);
+
+    try
+    {
+        ShmReader<SWhaleRecordV2> reader(std::string(argv[1]) + ".whales");
+        const double ghz = tsc_ghz();
+
+        uint64_t cnt = 0, total_ticks = 0, max_ticks = 0;
+        auto last_report = std::chrono::steady_clock::now();
+        auto last_reattach = last_report;
+        bool stale = false;
+
+        while (g_running)
+        {
+            SWhaleRecordV2 r;
+            uint64_t tick_pub;
+
+            if (!reader.Poll(r, &tick_pub))
+            {
+                _mm_pause();
+
+                auto now = std::chrono::steady_clock::now();
+
+                // the server closed or restarted the channel: wait for the new one
+                if (reader.IsStale() && now - last_reattach >= std::chrono::milliseconds(100))
+                {
+                    last_reattach = now;
+                    if (!stale)
+                        std::cout << "Channel closed, waiting for the server\n";
+                    stale = true;
+
+                    if (reader.Reattach())
+                    {
+                        std::cout << "Channel reopened (restart " << reader.GetRestartCount() << ")\n";
+                        stale = false;
+                    }
+                }
+
+                if (now - last_report >= std::chrono::seconds(1))
+                {
+                    last_report = now;
+                    if (cnt > 0)
+                    {
+                        std::cout << std::fixed << std::setprecision(0) << "Whales: " << cnt << " | Lost: " << reader.GetLostCount()
+                            << " | Latency avg " << total_ticks / ghz / cnt << " max " << max_ticks / ghz << " ns\n";
+                        cnt = total_ticks = max_ticks = 0;
+                    }
+                }
+                continue;
+            }
+
+            uint64_t ticks = __rdtsc() - tick_pub;
+            total_ticks += ticks;
+            max_ticks = (ticks > max_ticks) ? ticks : max_ticks;
+            cnt++;
+
+            if (!quiet)
+            {
+                std::cout << std::fixed << std::setprecision(2) << reader.GetSymbol(r.symbol) << (r.is_sell ? " SELL " : " BUY ")
+                    << r.quantity << " @ " << r.price << " ($" << r.price * r.quantity << ")\n";
+            }
+        }
+    }
+    catch (std::exception& ex)
+    {
+        std::cerr << "\n" << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "Client.h"
+#include <CommandLine.h>
 #include <iostream>
 
 #ifdef _WIN32
@@ -27,26 +28,44 @@ int main(int argc, char* argv[])
         std::string symbol("BTCUSDT");
         double treshold = 100'000;
         bool ext_vwap = true;
+        uint8_t version = PROTOCOL_VERSION_1;
+        EProtocolEncoding encoding = EProtocolEncoding::Fixed;
+        ESlowConsumerPolicy policy = ESlowConsumerPolicy::DropNewest;
+        uint32_t query_ms = 0;
+        std::string mcast_group;
+        uint16_t mcast_port = 0;    // 0 - no multicast
+        std::string mcast_iface;
+        std::string socket_profile; // "nodelay=1,rcvbuf=...,busypoll=50,quickack=1"
 
         EProtocolDataType reqType = EProtocolDataType::Whale | EProtocolDataType::VWAP;
 
-        if (argc >= 2)
-            host = argv[1];
-
-        if (argc >= 3)
-            port = static_cast<uint16_t>(std::atoi(argv[2]));
-
-        if (argc >= 4)
-            reqType = static_cast<EProtocolDataType>(std::atoi(argv[3]));
-
-        if (argc >= 5)
-            symbol = argv[4];
-
-        if (argc >= 6)
-            treshold = std::atof(argv[5]);
-
-        if (argc >= 7)
-            ext_vwap = static_cast<bool>(std::atoi(argv[6]));
+        const CommandLineOption options[] =
+        {
+            { "host",               "server address (127.0.0.1)",                                               TextOption(host) },
+            { "port",               "server port (6000)",                                                       NumberOption(port, uint16_t(1)) },
+            { "req_type",           "1 - whales, 2 - VWAP ticker, 3 - both (default)",                          EnumOption(reqType, EProtocolDataType::Whale, EProtocolDataType::Whale | EProtocolDataType::VWAP) },
+            { "coin_name",          "coins, e.g. BTCUSDT:500000,ETHUSDT or * (BTCUSDT)",                        TextOption(symbol) },
+            { "whale_treshold",     "USD notional of a whale (100000)",                                         NumberOption(treshold, 0.0) },
+            { "vwap_roll",          "1 - rolling VWAP from the server (default), 0 - off",                      FlagOption(ext_vwap) },
+            { "protocol_version",   "1 (default) or 2",                                                         NumberOption(version, PROTOCOL_VERSION_1, PROTOCOL_VERSION_2) },
+            { "encoding",           "v2 batches: 0 - fixed records (default), 1 - delta/varint",                EnumOption(encoding, EProtocolEncoding::Fixed, EProtocolEncoding::Delta) },
+            { "slow_policy",        "0 - drop newest (default), 1 - drop oldest, 2 - conflate, 3 - disconnect", EnumOption(policy, ESlowConsumerPolicy::DropNewest, ESlowConsumerPolicy::Disconnect) },
+            { "query_ms",           "analytics query interval, 0 - off",                                        NumberOption(query_ms) },
+            { "multicast",          "whales from UDP multicast <group>:<port>",                                 HostPortOption(mcast_group, mcast_port) },
+            { "mcast_iface",        "multicast interface address",                                              TextOption(mcast_iface) },
+            { "socket_profile",     "socket options, e.g. nodelay=1,rcvbuf=4194304,quickack=1",                 TextOption(socket_profile) },
+        };
+
+        // "Client 127.0.0.1 5000 1 ETHUSDT 150000 0" (host .. vwap_roll) as before, then "--name=value" in any order
+        switch (ParseCommandLine(argc, argv, "Client", options, 6))
+        {
+        case ECommandLine::Help:
+            return 0;
+        case ECommandLine::Error:
+            return 1;
+        default:
+            break;
+        }
 
         boost::asio::io_context io;
 
@@ -54,6 +73,14 @@ int main(int argc, char* argv[])
 
         client.SetWhaleTreshold(treshold);
         client.SetExtVwap(ext_vwap);
+        client.SetProtocolVersion(version);
+        client.SetEncoding(encoding);
+        client.SetSlowConsumerPolicy(policy);
+        client.SetQueryInterval(query_ms);
+        client.SetSocketProfile(ParseSocketProfile(socket_profile));
+
+        if (mcast_port != 0)
+            client.EnableMulticast(mcast_group, mcast_port, mcast_iface);
 
 
         client.Start();
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+
+// Command line of the executables: up to 'positional' leading bare arguments fill the first options in
+// table order (the original "Server 5000 0 1" form), then "--name=value" in any order.
+// Values are parsed strictly (whole argument, range checked); a bad one stops the program.
+
+// one option, 'set' returns false for a malformed or out-of-range value
+struct CommandLineOption
+{
+    const char* name;
+    const char* help;
+    std::function<bool(const char*)> set;
+};
+
+enum class ECommandLine
+{
+    Run,
+    Help,       // usage printed (--help)
+    Error,      // message printed
+};
+
+
+template <typename T>
+inline bool ParseNumber(const char* text, T& out)
+{
+    const char* last = text + std::strlen(text);
+    auto [ptr, ec] = std::from_chars(text, last, out);
+    return ec == std::errc() && ptr == last && ptr != text;
+}
+
+// "<host>:<port>", port 1..65535
+inline bool ParseHostPort(const std::string& text, std::string& host, uint16_t& port)
+{
+    const size_t colon = text.rfind(':');
+    if (colon == std::string::npos || colon == 0)
+        return false;
+
+    uint16_t value = 0;
+    if (!ParseNumber(text.c_str() + colon + 1, value) || value == 0)
+        return false;
+
+    host = text.substr(0, colon);
+    port = value;
+    return true;
+}
+
+
+template <typename T>
+inline std::function<bool(const char*)> NumberOption(T& var, T min = std::numeric_limits<T>::lowest(), T max = std::numeric_limits<T>::max())
+{
+    return [&var, min, max](const char* text)
+        {
+            T value{};
+            if (!ParseNumber(text, value) || value < min || value > max)
+                return false;
+            var = value;
+            return true;
+        };
+}
+
+// an enum given by its number, [min, max] are its valid values
+template <typename E>
+inline std::function<bool(const char*)> EnumOption(E& var, E min, E max)
+{
+    return [&var, min, max](const char* text)
+        {
+            using T = std::underlying_type_t<E>;
+            int value = 0;
+            if (!ParseNumber(text, value) || value < static_cast<T>(min) || value > static_cast<T>(max))
+                return false;
+            var = static_cast<E>(value);
+            return true;
+        };
+}
+
+inline std::function<bool(const char*)> FlagOption(bool& var)
+{
+    return [&var](const char* text)
+        {
+            int value = 0;
+            if (!ParseNumber(text, value) || (value != 0 && value != 1))
+                return false;
+            var = (value == 1);
+            return true;
+        };
+}
+
+inline std::function<bool(const char*)> TextOption(std::string& var)
+{
+    return [&var](const char* text) { var = text; return true; };
+}
+
+// "<host>:<port>", checked when it is given
+inline std::function<bool(const char*)> HostPortOption(std::string& host, uint16_t& port)
+{
+    return [&host, &port](const char* text) { return ParseHostPort(text, host, port); };
+}
+
+
+inline void PrintUsage(const char* program, std::span<const CommandLineOption> options, size_t positional)
+{
+    std::cerr << "Usage: " << program;
+    for (size_t i = 0; i < positional && i < options.size(); i++)
+        std::cerr << " [" << options[i].name << "]";
+    std::cerr << " [--option=value ...]\n";
+
+    for (const CommandLineOption& o : options)
+        std::cerr << "  --" << o.name << std::string(std::max<size_t>(20 - std::strlen(o.name), 2), ' ') << o.help << "\n";
+}
+
+inline ECommandLine ParseCommandLine(int argc, char* argv[], const char* program, std::span<const CommandLineOption> options, size_t positional = 0)
+{
+    size_t next_positional = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view arg(argv[i]);
+
+        if (arg == "--help" || arg == "-h")
+        {
+            PrintUsage(program, options, positional);
+            return ECommandLine::Help;
+        }
+
+        const bool named = arg.substr(0, 2) == "--";
+
+        // bare arguments only ahead of the named ones
+        if (!named && next_positional == static_cast<size_t>(i - 1) && next_positional < std::min(positional, options.size()))
+        {
+            const CommandLineOption& option = options[next_positional++];
+            if (!option.set(argv[i]))
+            {
+                std::cerr << "Bad " << option.name << ": " << arg << "\n";
+                return ECommandLine::Error;
+            }
+            continue;
+        }
+
+        const size_t eq = arg.find('=');
+        if (!named || eq == std::string_view::npos)
+        {
+            std::cerr << "Expected --option=value: " << arg << "\n";
+            PrintUsage(program, options, positional);
+            return ECommandLine::Error;
+        }
+
+        const std::string_view name = arg.substr(2, eq - 2);
+        auto option = std::find_if(options.begin(), options.end(), [&](const CommandLineOption& o) { return name == o.name; });
+        if (option == options.end())
+        {
+            std::cerr << "Unknown option: --" << name << "\n";
+            PrintUsage(program, options, positional);
+            return ECommandLine::Error;
+        }
+
+        if (!option->set(argv[i] + eq + 1))
+        {
+            std::cerr << "Bad value of --" << name << ": " << arg.substr(eq + 1) << "\n";
+            return ECommandLine::Error;
+        }
+    }
+
+    return ECommandLine::Run;
+}
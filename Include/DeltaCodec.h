@@ -0,0 +1,216 @@
+#pragma once
+
+#include "Protocol.h"
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+
+// Compressed whale batch (dataType MSG_DATA_DELTA, protocol v2, opt-in at subscribe).
+//
+// Prices, quantities and vwaps are sent as fixed-point with 8 decimals (exchange precision).
+// Layout:
+//   varint count
+//   zigzag base_price, zigzag base_qty, varint base_ts, varint base_seq     (per-batch base values)
+//   count * {
+//       varint  (symbol << 1) | is_sell
+//       zigzag  price - prev_price
+//       zigzag  qty - prev_qty
+//       zigzag  ts - prev_ts
+//       zigzag  vwap_sess - price
+//       zigzag  vwap_roll50 - price
+//       zigzag  seq - prev_seq
+//   }
+// prev_* start from the base values; delta_roll is restored as price - vwap_roll50.
+
+constexpr double DELTA_FX_SCALE = 1e8;
+constexpr size_t VARINT_MAX = 10;
+
+inline constexpr size_t DeltaBatchMaxSize(size_t count)
+{
+    return 5 * VARINT_MAX + count * 7 * VARINT_MAX;
+}
+
+
+inline int64_t to_fx(double v)
+{
+    // clamp: garbage / non-finite values must not make llround overflow
+    constexpr double LIM = 9.0e18;
+
+    double x = v * DELTA_FX_SCALE;
+    if (x != x)
+        return 0;
+    if (x > LIM)
+        x = LIM;
+    else if (x < -LIM)
+        x = -LIM;
+
+    return std::llround(x);
+}
+
+inline double from_fx(int64_t v)
+{
+    return static_cast<double>(v) / DELTA_FX_SCALE;
+}
+
+// wrap-around difference / sum (no signed overflow on extreme values)
+inline int64_t fx_sub(int64_t a, int64_t b)
+{
+    return static_cast<int64_t>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b));
+}
+
+inline int64_t fx_add(int64_t a, int64_t b)
+{
+    return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+}
+
+inline uint64_t zigzag(int64_t v)
+{
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+inline int64_t unzigzag(uint64_t v)
+{
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+inline uint8_t* put_varint(uint8_t* p, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        *p++ = static_cast<uint8_t>(v) | 0x80;
+        v >>= 7;
+    }
+    *p++ = static_cast<uint8_t>(v);
+    return p;
+}
+
+// returns nullptr on truncated / malformed input
+inline const uint8_t* get_varint(const uint8_t* p, const uint8_t* end, uint64_t& v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (p >= end)
+            return nullptr;
+
+        uint8_t b = *p++;
+        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return p;
+    }
+    return nullptr;
+}
+
+
+// 'out' must hold DeltaBatchMaxSize(count) bytes. Returns the encoded size.
+inline size_t EncodeDeltaBatch(uint8_t* out, const SWhaleRecordV2* recs, size_t count)
+{
+    uint8_t* p = out;
+
+    p = put_varint(p, count);
+    if (count == 0)
+        return p - out;
+
+    int64_t prev_price = to_fx(recs[0].price);
+    int64_t prev_qty = to_fx(recs[0].quantity);
+    uint64_t prev_ts = recs[0].timestamp;
+    uint64_t prev_seq = recs[0].seq;
+
+    p = put_varint(p, zigzag(prev_price));
+    p = put_varint(p, zigzag(prev_qty));
+    p = put_varint(p, prev_ts);
+    p = put_varint(p, prev_seq);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const SWhaleRecordV2& r = recs[i];
+
+        int64_t price = to_fx(r.price);
+        int64_t qty = to_fx(r.quantity);
+
+        p = put_varint(p, (static_cast<uint64_t>(r.symbol) << 1) | (r.is_sell ? 1 : 0));
+        p = put_varint(p, zigzag(fx_sub(price, prev_price)));
+        p = put_varint(p, zigzag(fx_sub(qty, prev_qty)));
+        p = put_varint(p, zigzag(static_cast<int64_t>(r.timestamp - prev_ts)));
+        p = put_varint(p, zigzag(fx_sub(to_fx(r.vwap_sess), price)));
+        p = put_varint(p, zigzag(fx_sub(to_fx(r.vwap_roll50), price)));
+        p = put_varint(p, zigzag(static_cast<int64_t>(r.seq - prev_seq)));
+
+        prev_price = price;
+        prev_qty = qty;
+        prev_ts = r.timestamp;
+        prev_seq = r.seq;
+    }
+
+    return p - out;
+}
+
+// Decodes into 'out' (capacity 'max_count'). Returns false on malformed input.
+inline bool DecodeDeltaBatch(const uint8_t* data, size_t size, SWhaleRecordV2* out, size_t max_count, size_t& count)
+{
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    uint64_t v;
+
+    count = 0;
+
+    if (!(p = get_varint(p, end, v)))
+        return false;
+
+    size_t cnt = static_cast<size_t>(v);
+    if (cnt > max_count)
+        return false;
+
+    if (cnt == 0)
+        return true;
+
+    int64_t prev_price, prev_qty;
+    uint64_t prev_ts, prev_seq;
+
+    if (!(p = get_varint(p, end, v))) return false;
+    prev_price = unzigzag(v);
+    if (!(p = get_varint(p, end, v))) return false;
+    prev_qty = unzigzag(v);
+    if (!(p = get_varint(p, end, prev_ts))) return false;
+    if (!(p = get_varint(p, end, prev_seq))) return false;
+
+    for (size_t i = 0; i < cnt; i++)
+    {
+        SWhaleRecordV2 r{};
+        uint64_t sym, d_price, d_qty, d_ts, d_vwap, d_roll, d_seq;
+
+        if (!(p = get_varint(p, end, sym))) return false;
+        if (!(p = get_varint(p, end, d_price))) return false;
+        if (!(p = get_varint(p, end, d_qty))) return false;
+        if (!(p = get_varint(p, end, d_ts))) return false;
+        if (!(p = get_varint(p, end, d_vwap))) return false;
+        if (!(p = get_varint(p, end, d_roll))) return false;
+        if (!(p = get_varint(p, end, d_seq))) return false;
+
+        int64_t price = fx_add(prev_price, unzigzag(d_price));
+        int64_t qty = fx_add(prev_qty, unzigzag(d_qty));
+        uint64_t ts = prev_ts + static_cast<uint64_t>(unzigzag(d_ts));
+        uint64_t seq = prev_seq + static_cast<uint64_t>(unzigzag(d_seq));
+
+        r.symbol = static_cast<uint32_t>(sym >> 1);
+        r.is_sell = static_cast<uint8_t>(sym & 1);
+        r.price = from_fx(price);
+        r.quantity = from_fx(qty);
+        r.timestamp = ts;
+        r.vwap_sess = from_fx(fx_add(price, unzigzag(d_vwap)));
+        r.vwap_roll50 = from_fx(fx_add(price, unzigzag(d_roll)));
+        r.delta_roll = static_cast<float>(r.price - r.vwap_roll50);
+        r.seq = seq;
+
+        out[i] = r;
+
+        prev_price = price;
+        prev_qty = qty;
+        prev_ts = ts;
+        prev_seq = seq;
+    }
+
+    count = cnt;
+    return p == end;
+}
@@ -4,15 +4,66 @@
 #include <type_traits>
 #include <chrono>
 #include <map>
+#include <bit>
 #include "Utils.h"
 
 
 // Header layout (9 bytes, network byte order / big-endian):
 // uint16_t signature (0xAA55)
-// uint8_t  version (1)
-// uint8_t  dataType (1=Subscribe (to server), 2=Data (to client), 3=Alive (to client))
+// uint8_t  version (1 or 2, the client chooses it in Subscribe, the server answers with the same version)
+// uint8_t  dataType (1=Subscribe (to server), 2=Data (to client), 3=Alive (to client), 4=Symbol dictionary (to client, v2),
+//                    5=Compressed data (to client, v2, see DeltaCodec.h), 6=Subscription update (to server),
+//                    7=Gap notice (to client), 8=Snapshot (to client), 9=Query (to server), 10=Query result (to client),
+//                    11=VWAP ticker (to client), 12=Multicast retransmit request (to server), 13=Retransmit data (to client),
+//                    14=Resume result (to client, v2))
 // uint8_t  msg_num (order msg number)
 // uint32_t len (payload length)
+//
+// v1 Data payload (big-endian): uint32_t count + variable-length records (symbol name in every record)
+// v2 Data payload (native little-endian): count * SWhaleRecordV2, count = len / 64
+// v2 Symbol dictionary (little-endian): uint32_t count + count * { uint32_t index, uint8_t len, char[len] }
+//
+// Subscribe payload: uint8_t req_type, uint8_t symbol_len, char[symbol_len], double treshold (big-endian)
+//                    [, uint8_t encoding (v2 only, EProtocolEncoding, optional)]
+//                    [, uint8_t slow-consumer policy (ESlowConsumerPolicy), uint32_t max_lag_kb (big-endian, 0 = server default)]
+//                    [, uint16_t resume_count (big-endian, v2 only), resume_count * { uint8_t symbol_len, char[symbol_len],
+//                       uint64_t last_seq (big-endian) }]
+//   symbol list:     uint8_t req_type, uint8_t 0, uint16_t count (big-endian),
+//                    count * { uint8_t symbol_len, char[symbol_len], double treshold } [, uint8_t encoding]
+//   symbol "*" subscribes to every coin; a later explicit symbol overrides its treshold.
+//
+// Gap notice payload: uint32_t dropped whale records (v1 big-endian, v2 little-endian)
+//
+// Snapshot (sent right after subscribe, current analytics of the subscribed symbols):
+//   v1 (big-endian): uint32_t count + count * { uint16_t symbol_len, char[symbol_len], double last_price, double last_qty,
+//                    uint64_t timestamp, double vwap_sess, double vwap_roll50, double volume_sess, uint64_t trade_cnt }
+//   v2 (little-endian): count * SSnapshotRecordV2, count = len / 64
+//
+// Query payload (to server, any time, answered from the published snapshots):
+//                    uint32_t request_id (big-endian), uint16_t count (big-endian), count * { uint8_t symbol_len, char[symbol_len] }
+//   count 0 - the session's subscribed symbols, symbol "*" - every coin, unknown symbols are skipped.
+// Query result payload: uint32_t request_id (v1 big-endian, v2 little-endian) + Snapshot payload of the query version
+//
+// VWAP ticker (req_type with EProtocolDataType::VWAP): Snapshot payload, sent every server VWAP interval with the coins
+//   (subscribed by any VWAP session) that traded since the previous one. req_type VWAP without Whale gets no whales.
+//
+// Whale sequence numbers (v2): every whale of a symbol gets the next 64-bit number (SWhaleRecordV2::seq, 1, 2, ...);
+//   a session sees a subset (its treshold), so numbers may skip. The server keeps the last whales of every symbol
+//   (Server/WhaleHistory.h). A reconnecting client sends its last seen number per symbol (resume list, may be empty); the server
+//   resends the kept whales after it (session treshold applied) ahead of the live ones and then answers
+//   Resume result payload: count * SResumeRecordV2 (one per subscribed symbol, little-endian).
+//   A last_seq above the server's head (server restarted) resumes from the first kept whale.
+//
+// UDP multicast (optional): one datagram = SMcastHeader + count * SWhaleRecordV2, native little-endian, fits a 1500-byte MTU.
+//   Data datagrams are numbered 1, 2, ...; a heartbeat (data_type Alive, count 0) carries the next seq, so a lost tail is seen too.
+//   The numbers are those of one publisher run (SMcastHeader::epoch): on a new epoch the receiver starts over and refreshes
+//   its state with a snapshot query, retransmitted datagrams of another epoch are ignored.
+//   Recovery over the TCP session (v2): Retransmit request payload: uint64_t from_seq, uint32_t count (big-endian);
+//   Retransmit data payload: uint64_t first_available_seq + the requested datagrams as sent (little-endian).
+//   Datagrams older than first_available_seq are lost: the client refreshes its state with a snapshot query.
+//
+// Subscription update payload (to server, live session): uint16_t count (big-endian),
+//                    count * { uint8_t action (ESubscriptionAction), uint8_t symbol_len, char[symbol_len], double treshold }
 
 
 #pragma pack(push,1)
@@ -29,6 +80,117 @@ static_assert(sizeof(SProtocolHeader) == 9, "Header must be 9 bytes");
 
 const uint16_t PROTOCOL_HEADER_SIGNATURE = 0xAA55;
 
+const uint8_t PROTOCOL_VERSION_1 = 1;
+const uint8_t PROTOCOL_VERSION_2 = 2;
+
+// dataType
+const uint8_t MSG_SUBSCRIBE = 0x01;
+const uint8_t MSG_DATA = 0x02;
+const uint8_t MSG_ALIVE = 0x03;
+const uint8_t MSG_SYMBOL_DICT = 0x04;
+const uint8_t MSG_DATA_DELTA = 0x05;
+const uint8_t MSG_SUBSCRIPTION_UPDATE = 0x06;
+const uint8_t MSG_GAP = 0x07;
+const uint8_t MSG_SNAPSHOT = 0x08;
+const uint8_t MSG_QUERY = 0x09;
+const uint8_t MSG_QUERY_RESULT = 0x0A;
+const uint8_t MSG_VWAP = 0x0B;
+const uint8_t MSG_RETRANSMIT = 0x0C;
+const uint8_t MSG_RETRANSMIT_DATA = 0x0D;
+const uint8_t MSG_RESUME = 0x0E;
+
+const char SUBSCRIBE_ALL_SYMBOLS[] = "*";
+
+
+// v2 data encoding requested at subscribe
+enum class EProtocolEncoding : uint8_t
+{
+    Fixed = 0,      // SWhaleRecordV2 as is
+    Delta = 1,      // delta / zig-zag varint batch (bandwidth-constrained links)
+};
+
+
+// Subscription update action
+enum class ESubscriptionAction : uint8_t
+{
+    Set = 0,        // add the symbol or change its treshold
+    Remove = 1,
+};
+
+
+// What the server does when a client falls behind by more than its lag budget
+enum class ESlowConsumerPolicy : uint8_t
+{
+    DropNewest = 0,     // new whales are dropped until the client catches up (default)
+    DropOldest = 1,     // the oldest queued whales are dropped, the client gets a gap notice
+    Conflate = 2,       // only the latest queued batch per symbol is kept, the superseded ones in a gap notice
+    Disconnect = 3,
+};
+
+
+// v2 whale record: fixed 64 bytes (one cache line), native little-endian,
+// both sides can memcpy / reinterpret it as is.
+struct SWhaleRecordV2
+{
+    double   price;
+    double   quantity;
+    uint64_t timestamp;
+    double   vwap_sess;
+    double   vwap_roll50;
+    float    delta_roll;
+    uint32_t symbol;        // index in the symbol dictionary
+    uint8_t  is_sell;
+    uint8_t  reserved[7];
+    uint64_t seq;           // per-symbol whale number, 0 - not numbered
+};
+static_assert(sizeof(SWhaleRecordV2) == 64, "SWhaleRecordV2 must be 64 bytes");
+
+// v2 resume result record: 24 bytes, native little-endian
+struct SResumeRecordV2
+{
+    uint32_t symbol;        // index in the symbol dictionary
+    uint32_t replayed;      // whales resent after the client's last_seq
+    uint64_t head_seq;      // last whale number of the symbol before the live ones
+    uint64_t lost;          // numbers after last_seq no longer kept (not all of them were above the treshold)
+};
+static_assert(sizeof(SResumeRecordV2) == 24, "SResumeRecordV2 must be 24 bytes");
+
+// v2 snapshot record: fixed 64 bytes, native little-endian
+struct SSnapshotRecordV2
+{
+    double   last_price;
+    double   last_qty;
+    uint64_t timestamp;
+    double   vwap_sess;
+    double   vwap_roll50;
+    double   volume_sess;
+    uint64_t trade_cnt;
+    uint32_t symbol;        // index in the symbol dictionary
+    uint8_t  reserved[4];
+};
+static_assert(sizeof(SSnapshotRecordV2) == 64, "SSnapshotRecordV2 must be 64 bytes");
+
+static_assert(std::endian::native == std::endian::little, "Protocol v2 records are little-endian");
+
+
+// multicast datagram header (native little-endian)
+#pragma pack(push,1)
+struct SMcastHeader
+{
+    uint16_t signature;     // PROTOCOL_HEADER_SIGNATURE
+    uint8_t  version;       // PROTOCOL_VERSION_2
+    uint8_t  data_type;     // MSG_DATA / MSG_ALIVE (heartbeat)
+    uint16_t count;         // SWhaleRecordV2 records that follow
+    uint16_t epoch;         // publisher session id (random, non-zero, per publisher start): a new one restarts the numbering
+    uint64_t seq;           // data: datagram number, heartbeat: next datagram number
+};
+#pragma pack(pop)
+static_assert(sizeof(SMcastHeader) == 16, "SMcastHeader must be 16 bytes");
+
+const size_t MCAST_MAX_DATAGRAM = 1472;     // 1500 MTU - IPv4 - UDP headers
+const size_t MCAST_MAX_RECORDS = (MCAST_MAX_DATAGRAM - sizeof(SMcastHeader)) / sizeof(SWhaleRecordV2);
+const uint32_t MCAST_RETRANSMIT_MAX = 1024;     // datagrams per retransmit request
+
 
 // Signals
 
@@ -0,0 +1,489 @@
+#pragma once
+
+#include "Protocol.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <x86intrin.h>
+#endif
+
+
+// Shared-memory broadcast channel: one writer process, any number of reader processes mapping it read-only.
+//
+// Layout: ShmChannelHeader + capacity * ShmSlot<T> (capacity is a power of 2).
+// Record n (1, 2, ...) goes to slot n & (capacity - 1). Every slot carries its record number, so a reader that
+// was lapped by the writer sees it (the records are not lost silently) and skips to the oldest record still there.
+// Readers never write to the segment: adding readers costs the writer nothing.
+//
+// Every writer start gets a new generation (random, non-zero). A restarted writer does not reuse the object under
+// the name: it sets generation 0 in the one it finds (left by a crashed writer) and creates a new one, a closing
+// writer sets 0 in its own. Readers compare the generation with the one they attached to on every Poll(), so a
+// restart is seen (IsStale()) instead of waiting forever on a ring nobody writes; Reattach() maps the new channel.
+//
+// Records: SWhaleRecordV2 (whales, symbol = index in the header's symbol table) or SMarketRecord (raw trades).
+
+constexpr uint64_t SHM_MAGIC = 0x314D485345484857ULL;  // "WHHESHM1"
+constexpr uint32_t SHM_LAYOUT_VERSION = 2;
+constexpr size_t SHM_MAX_SYMBOLS = 1024;
+constexpr size_t SHM_SYMBOL_LEN = 16;
+constexpr uint64_t SHM_DEFAULT_CAPACITY = 64 * 1024;
+constexpr uint64_t SHM_SLOT_BUSY = ~0ULL;
+
+
+// raw trade (market event) record
+struct SMarketRecord
+{
+    double   price;
+    double   quantity;
+    uint64_t timestamp;
+    uint32_t symbol;
+    uint8_t  is_sell;
+    uint8_t  reserved[3];
+};
+static_assert(sizeof(SMarketRecord) == 32, "SMarketRecord must be 32 bytes");
+
+
+struct ShmChannelHeader
+{
+    uint64_t magic;
+    uint32_t layout_version;
+    uint32_t record_size;
+    uint64_t capacity;
+    uint32_t symbol_cnt;
+    uint32_t reserved;
+    char     symbols[SHM_MAX_SYMBOLS][SHM_SYMBOL_LEN];      // not null-terminated at full length
+
+    alignas(64) std::atomic<uint64_t> write_seq;           // last published record, 0 - none yet
+    std::atomic<uint64_t> generation;                       // writer start, 0 - closed (in the cache line readers poll)
+};
+
+template<typename T>
+struct alignas(64) ShmSlot
+{
+    static constexpr size_t WORDS = (sizeof(T) + 7) / 8;
+
+    std::atomic<uint64_t> seq;          // record number, SHM_SLOT_BUSY while it is rewritten
+    std::atomic<uint64_t> tick_pub;     // writer's rdtsc at publish (same-box latency)
+    std::atomic<uint64_t> words[WORDS];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shm channel needs lock-free 64-bit atomics");
+
+
+// Named mapping (POSIX shm_open / Windows file mapping)
+class ShmMapping
+{
+public:
+    ShmMapping(const std::string& name, size_t size, bool create)
+        : m_size(size), m_create(create)
+    {
+#ifdef _WIN32
+        m_name = "Local\\" + name;
+        if (create)
+            m_handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), m_name.c_str());
+        else
+            m_handle = OpenFileMappingA(FILE_MAP_READ, FALSE, m_name.c_str());
+
+        if (!m_handle)
+            throw std::runtime_error("shm: cannot open " + m_name);
+
+        m_addr = MapViewOfFile(m_handle, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, size);
+        if (!m_addr)
+        {
+            CloseHandle(m_handle);
+            throw std::runtime_error("shm: cannot map " + m_name);
+        }
+#else
+        m_name = (!name.empty() && name[0] == '/') ? name : "/" + name;
+
+        if (create)
+        {
+            // a channel left under the name is closed for its readers and replaced, never truncated under their mappings
+            retire(m_name);
+            shm_unlink(m_name.c_str());
+        }
+
+        int fd = create ? shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644) : shm_open(m_name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+            throw std::runtime_error("shm: cannot open " + m_name);
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("shm: cannot open " + m_name);
+        }
+        m_dev = st.st_dev;
+        m_ino = st.st_ino;
+
+        if (create && ftruncate(fd, static_cast<off_t>(size)) != 0)
+        {
+            close(fd);
+            shm_unlink(m_name.c_str());
+            throw std::runtime_error("shm: cannot size " + m_name);
+        }
+
+        if (!create)
+        {
+            // the reader maps what the writer created
+            if (static_cast<size_t>(st.st_size) < sizeof(ShmChannelHeader))
+            {
+                close(fd);
+                throw std::runtime_error("shm: not a channel " + m_name);
+            }
+            m_size = static_cast<size_t>(st.st_size);
+        }
+
+        m_addr = mmap(nullptr, m_size, create ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+
+        if (m_addr == MAP_FAILED)
+        {
+            m_addr = nullptr;
+            if (create)
+                shm_unlink(m_name.c_str());
+            throw std::runtime_error("shm: cannot map " + m_name);
+        }
+#endif
+    }
+
+    ~ShmMapping()
+    {
+#ifdef _WIN32
+        if (m_addr)
+            UnmapViewOfFile(m_addr);
+        if (m_handle)
+            CloseHandle(m_handle);
+#else
+        if (m_addr)
+            munmap(m_addr, m_size);
+        if (m_create && is_current())
+            shm_unlink(m_name.c_str());
+#endif
+    }
+
+    // disable copying
+    ShmMapping(const ShmMapping&) = delete;
+    ShmMapping& operator=(const ShmMapping&) = delete;
+
+    void* Data() const { return m_addr; }
+    size_t Size() const { return m_size; }
+
+private:
+#ifndef _WIN32
+    // generation 0 in the channel under 'name', if there is one
+    static void retire(const std::string& name)
+    {
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0)
+            return;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(ShmChannelHeader))
+        {
+            void* addr = mmap(nullptr, sizeof(ShmChannelHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (addr != MAP_FAILED)
+            {
+                ShmChannelHeader* h = static_cast<ShmChannelHeader*>(addr);
+                if (reinterpret_cast<std::atomic<uint64_t>*>(&h->magic)->load(std::memory_order_acquire) == SHM_MAGIC
+                    && h->layout_version == SHM_LAYOUT_VERSION)
+                {
+                    h->generation.store(0, std::memory_order_release);
+                }
+                munmap(addr, sizeof(ShmChannelHeader));
+            }
+        }
+        close(fd);
+    }
+
+    // the name still refers to this object (a restarted writer may have replaced it)
+    bool is_current() const
+    {
+        int fd = shm_open(m_name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        const bool same = fstat(fd, &st) == 0 && st.st_dev == m_dev && st.st_ino == m_ino;
+        close(fd);
+        return same;
+    }
+#endif
+
+private:
+    std::string m_name;
+    void* m_addr = nullptr;
+    size_t m_size;
+    bool m_create;
+#ifdef _WIN32
+    HANDLE m_handle = nullptr;
+#else
+    dev_t m_dev = 0;
+    ino_t m_ino = 0;
+#endif
+};
+
+
+template<typename T>
+class ShmWriter
+{
+    static_assert(std::is_trivially_copyable_v<T>, "shm records must be trivially copyable");
+    using Slot = ShmSlot<T>;
+
+public:
+    // 'capacity' is rounded up to a power of 2. Throws std::runtime_error.
+    ShmWriter(const std::string& name, uint64_t capacity = SHM_DEFAULT_CAPACITY)
+        : m_capacity(round_pow2(capacity))
+        , m_map(name, sizeof(ShmChannelHeader) + m_capacity * sizeof(Slot), true)
+    {
+        m_header = new (m_map.Data()) ShmChannelHeader();
+        m_slots = reinterpret_cast<Slot*>(static_cast<uint8_t*>(m_map.Data()) + sizeof(ShmChannelHeader));
+
+        for (uint64_t i = 0; i < m_capacity; i++)
+        {
+            Slot* s = new (&m_slots[i]) Slot();
+            s->seq.store(0, std::memory_order_relaxed);
+        }
+
+        m_header->layout_version = SHM_LAYOUT_VERSION;
+        m_header->record_size = sizeof(T);
+        m_header->capacity = m_capacity;
+        m_header->write_seq.store(0, std::memory_order_relaxed);
+        m_header->generation.store(make_generation(), std::memory_order_relaxed);
+
+        // published last: a reader accepts the segment only with a valid magic
+        std::atomic_thread_fence(std::memory_order_release);
+        reinterpret_cast<std::atomic<uint64_t>*>(&m_header->magic)->store(SHM_MAGIC, std::memory_order_release);
+    }
+
+    // the readers see the channel closed
+    ~ShmWriter() { m_header->generation.store(0, std::memory_order_release); }
+
+    // disable copying
+    ShmWriter(const ShmWriter&) = delete;
+    ShmWriter& operator=(const ShmWriter&) = delete;
+
+    // before the first Publish()
+    void SetSymbols(const std::vector<std::string>& symbols)
+    {
+        size_t cnt = (symbols.size() < SHM_MAX_SYMBOLS) ? symbols.size() : SHM_MAX_SYMBOLS;
+        for (size_t i = 0; i < cnt; i++)
+        {
+            std::memset(m_header->symbols[i], 0, SHM_SYMBOL_LEN);
+            std::memcpy(m_header->symbols[i], symbols[i].data(), (symbols[i].size() < SHM_SYMBOL_LEN) ? symbols[i].size() : SHM_SYMBOL_LEN);
+        }
+        m_header->symbol_cnt = static_cast<uint32_t>(cnt);
+    }
+
+    // single writer thread
+    void Publish(const T& rec)
+    {
+        uint64_t buf[Slot::WORDS] = {};
+        std::memcpy(buf, &rec, sizeof(T));
+
+        const uint64_t seq = ++m_seq;
+        Slot& s = m_slots[seq & (m_capacity - 1)];
+
+        s.seq.store(SHM_SLOT_BUSY, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < Slot::WORDS; i++)
+            s.words[i].store(buf[i], std::memory_order_relaxed);
+        s.tick_pub.store(__rdtsc(), std::memory_order_relaxed);
+
+        s.seq.store(seq, std::memory_order_release);
+        m_header->write_seq.store(seq, std::memory_order_release);
+    }
+
+    // any thread
+    uint64_t GetWriteSeq() const { return m_header->write_seq.load(std::memory_order_relaxed); }
+    uint64_t GetCapacity() const { return m_capacity; }
+    uint64_t GetGeneration() const { return m_header->generation.load(std::memory_order_relaxed); }
+
+private:
+    static uint64_t round_pow2(uint64_t v)
+    {
+        uint64_t p = 1;
+        while (p < v)
+            p <<= 1;
+        return p;
+    }
+
+    static uint64_t make_generation()
+    {
+        std::random_device rd;
+        const uint64_t g = ((static_cast<uint64_t>(rd()) << 32) | rd()) ^ __rdtsc();
+        return g ? g : 1;
+    }
+
+private:
+    uint64_t m_capacity;
+    ShmMapping m_map;
+    ShmChannelHeader* m_header = nullptr;
+    Slot* m_slots = nullptr;
+    uint64_t m_seq = 0;
+};
+
+
+template<typename T>
+class ShmReader
+{
+    using Slot = ShmSlot<T>;
+
+public:
+    // maps the channel read-only and starts at its next record. Throws std::runtime_error.
+    explicit ShmReader(const std::string& name)
+        : m_name(name)
+    {
+        attach();
+        m_next = m_header->write_seq.load(std::memory_order_acquire) + 1;
+    }
+
+    // disable copying
+    ShmReader(const ShmReader&) = delete;
+    ShmReader& operator=(const ShmReader&) = delete;
+
+    // next record if there is one (never blocks). 'tick_pub' - writer's rdtsc at publish.
+    // Nothing once the writer closed or restarted (IsStale()).
+    bool Poll(T& out, uint64_t* tick_pub = nullptr)
+    {
+        while (true)
+        {
+            const uint64_t head = m_header->write_seq.load(std::memory_order_acquire);
+            if (m_next > head || m_header->generation.load(std::memory_order_relaxed) != m_generation)
+                return false;
+
+            const Slot& s = m_slots[m_next & (m_capacity - 1)];
+
+            uint64_t buf[Slot::WORDS];
+            const uint64_t seq1 = s.seq.load(std::memory_order_acquire);
+            for (size_t i = 0; i < Slot::WORDS; i++)
+                buf[i] = s.words[i].load(std::memory_order_relaxed);
+            const uint64_t tick = s.tick_pub.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t seq2 = s.seq.load(std::memory_order_relaxed);
+
+            if (seq1 == m_next && seq2 == m_next)
+            {
+                // a writer restarted in place (same mapping) may have reused the slot
+                if (m_header->generation.load(std::memory_order_relaxed) != m_generation)
+                    return false;
+
+                std::memcpy(&out, buf, sizeof(T));
+                if (tick_pub)
+                    *tick_pub = tick;
+                m_next++;
+                return true;
+            }
+
+            // lapped by the writer: skip to the oldest record that is still in the ring
+            // (or retry with a fresh head if the slot is being rewritten right now)
+            const uint64_t oldest = (head > m_capacity) ? head - m_capacity + 1 : 1;
+            if (oldest > m_next)
+            {
+                m_lost += oldest - m_next;
+                m_next = oldest;
+            }
+        }
+    }
+
+    // the writer closed or restarted: no more records from this mapping
+    bool IsStale() const { return m_header->generation.load(std::memory_order_acquire) != m_generation; }
+
+    // maps the channel now under the name and reads it from its first record; false (the old mapping is kept)
+    // if there is none or it is still the same generation
+    bool Reattach()
+    {
+        std::unique_ptr<ShmMapping> map = std::move(m_map);
+        const ShmChannelHeader* header = m_header;
+        const Slot* slots = m_slots;
+        const uint64_t capacity = m_capacity;
+        const uint64_t generation = m_generation;
+
+        try
+        {
+            attach();
+            if (m_generation != generation)
+            {
+                m_next = 1;
+                m_restarts++;
+                return true;
+            }
+        }
+        catch (const std::runtime_error&)
+        {
+        }
+
+        m_map = std::move(map);
+        m_header = header;
+        m_slots = slots;
+        m_capacity = capacity;
+        m_generation = generation;
+        return false;
+    }
+
+    uint64_t GetLostCount() const { return m_lost; }
+    uint64_t GetNextSeq() const { return m_next; }
+    uint64_t GetGeneration() const { return m_generation; }
+    uint64_t GetRestartCount() const { return m_restarts; }
+
+    // symbol name by record index ("" if unknown)
+    std::string GetSymbol(uint32_t index) const
+    {
+        if (index >= m_header->symbol_cnt || index >= SHM_MAX_SYMBOLS)
+            return std::string();
+
+        const char* s = m_header->symbols[index];
+        return std::string(s, strnlen(s, SHM_SYMBOL_LEN));
+    }
+
+private:
+    // maps m_name, checks it is an open channel of T
+    void attach()
+    {
+        m_map = std::make_unique<ShmMapping>(m_name, 0, false);
+        m_header = static_cast<const ShmChannelHeader*>(m_map->Data());
+
+        uint64_t magic = reinterpret_cast<const std::atomic<uint64_t>*>(&m_header->magic)->load(std::memory_order_acquire);
+        if (magic != SHM_MAGIC || m_header->layout_version != SHM_LAYOUT_VERSION || m_header->record_size != sizeof(T))
+            throw std::runtime_error("shm: incompatible channel " + m_name);
+
+        m_capacity = m_header->capacity;
+        if (m_map->Size() < sizeof(ShmChannelHeader) + m_capacity * sizeof(Slot))
+            throw std::runtime_error("shm: truncated channel " + m_name);
+
+        m_generation = m_header->generation.load(std::memory_order_acquire);
+        if (m_generation == 0)
+            throw std::runtime_error("shm: closed channel " + m_name);
+
+        m_slots = reinterpret_cast<const Slot*>(static_cast<const uint8_t*>(m_map->Data()) + sizeof(ShmChannelHeader));
+    }
+
+private:
+    std::string m_name;
+    std::unique_ptr<ShmMapping> m_map;
+    const ShmChannelHeader* m_header = nullptr;
+    const Slot* m_slots = nullptr;
+    uint64_t m_capacity = 0;
+    uint64_t m_generation = 0;
+    uint64_t m_next = 1;
+    uint64_t m_lost = 0;
+    uint64_t m_restarts = 0;
+};
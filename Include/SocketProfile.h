@@ -0,0 +1,120 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/net_tstamp.h>
+#include <sys/socket.h>
+#endif
+
+
+// Latency options of a TCP session socket (server sessions and the client).
+// Text form (command line): "nodelay=1,sndbuf=4194304,rcvbuf=0,busypoll=50,quickack=1,txts=1"
+struct SocketProfile
+{
+    bool no_delay = true;       // TCP_NODELAY: small whale frames are not held back by Nagle
+    int send_buffer = 0;        // SO_SNDBUF bytes, 0 - system default
+    int recv_buffer = 0;        // SO_RCVBUF bytes, 0 - system default
+    int busy_poll_us = 0;       // SO_BUSY_POLL (Linux), 0 - off
+    bool quick_ack = false;     // TCP_QUICKACK (Linux), re-armed after every read
+    bool tx_timestamps = false; // SO_TIMESTAMPING software TX timestamps (Linux, server sessions)
+};
+
+inline SocketProfile ParseSocketProfile(const std::string& text)
+{
+    SocketProfile p;
+    std::stringstream ss(text);
+    std::string item;
+
+    while (std::getline(ss, item, ','))
+    {
+        size_t eq = item.find('=');
+        if (eq == std::string::npos)
+            continue;
+
+        std::string key = item.substr(0, eq);
+        int value = std::atoi(item.c_str() + eq + 1);
+
+        if (key == "nodelay")
+            p.no_delay = value != 0;
+        else if (key == "sndbuf")
+            p.send_buffer = value;
+        else if (key == "rcvbuf")
+            p.recv_buffer = value;
+        else if (key == "busypoll")
+            p.busy_poll_us = value;
+        else if (key == "quickack")
+            p.quick_ack = value != 0;
+        else if (key == "txts")
+            p.tx_timestamps = value != 0;
+        else
+            std::cerr << "\nUnknown socket option: " << key << "\n";
+    }
+
+    return p;
+}
+
+inline std::string SocketProfileToString(const SocketProfile& p)
+{
+    std::stringstream ss;
+    ss << "nodelay=" << p.no_delay << ",sndbuf=" << p.send_buffer << ",rcvbuf=" << p.recv_buffer
+        << ",busypoll=" << p.busy_poll_us << ",quickack=" << p.quick_ack << ",txts=" << p.tx_timestamps;
+    return ss.str();
+}
+
+// TCP_QUICKACK is cleared by the kernel, so it is set again after each read
+inline void RearmQuickAck(boost::asio::ip::tcp::socket& socket)
+{
+#ifdef __linux__
+    int one = 1;
+    setsockopt(socket.native_handle(), IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+#endif
+}
+
+// Applies the profile to a connected socket. Returns false if an option was refused (the others are still set).
+inline bool ApplySocketProfile(boost::asio::ip::tcp::socket& socket, const SocketProfile& p)
+{
+    namespace asio = boost::asio;
+    boost::system::error_code ec;
+    bool ok = true;
+
+    socket.set_option(asio::ip::tcp::no_delay(p.no_delay), ec);
+    ok &= !ec;
+
+    if (p.send_buffer > 0)
+    {
+        socket.set_option(asio::socket_base::send_buffer_size(p.send_buffer), ec);
+        ok &= !ec;
+    }
+
+    if (p.recv_buffer > 0)
+    {
+        socket.set_option(asio::socket_base::receive_buffer_size(p.recv_buffer), ec);
+        ok &= !ec;
+    }
+
+#ifdef __linux__
+    const int fd = socket.native_handle();
+
+    if (p.busy_poll_us > 0)
+        ok &= setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &p.busy_poll_us, sizeof(p.busy_poll_us)) == 0;
+
+    if (p.quick_ack)
+        RearmQuickAck(socket);
+
+    if (p.tx_timestamps)
+    {
+        // software TX time, reported on the error queue keyed by the byte offset of the send
+        int flags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+        ok &= setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0;
+    }
+#endif
+
+    return ok;
+}
@@ -61,6 +61,11 @@ struct SessionVWAP {
 
 struct alignas(64) CoinAnalytics {
     SessionVWAP          session;
+    // last trade (fits the padding before roll50: no extra cache line on the hot path)
+    double               last_price = 0.0;
+    double               last_qty = 0.0;
+    uint64_t             last_ts = 0;
+    uint64_t             trade_cnt = 0;
     RollingVWAP<50>      roll50;
     //double signed_flow = 0;
 
@@ -69,4 +74,16 @@ struct alignas(64) CoinAnalytics {
         session.reset();
         roll50.reset();
     }
-};
\ No newline at end of file
+};
+
+// Published copy of a coin's analytics (see SeqLock.h), readable by any thread without stopping hot_dispatcher
+struct CoinSnapshot {
+    int32_t  index_symbol;
+    double   last_price;
+    double   last_qty;
+    uint64_t timestamp;     // last trade
+    double   vwap_sess;
+    double   vwap_roll50;   // 0 if the extended VWAP is off
+    double   volume_sess;
+    uint64_t trade_cnt;
+};
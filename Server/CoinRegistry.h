@@ -2,6 +2,7 @@
 
 #include <string>
 #include <cstring>
+#include <string_view>
 
 struct CoinNode {
     uint64_t key = 0;
@@ -48,6 +49,13 @@ public:
         return get_index_fast(symbol2u64(symbol));
     }
 
+    // symbol not null-terminated (points into a parsed message)
+    inline int get_index_coin(std::string_view symbol) const {
+        uint64_t s1 = 0;
+        std::memcpy(&s1, symbol.data(), std::min<size_t>(symbol.size(), (size_t)8));
+        return get_index_fast(s1);
+    }
+
     inline int get_index_fast(uint64_t s1) const {
         uint32_t slot = calculate_slot(s1);
 
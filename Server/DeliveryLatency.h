@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <bit>
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+
+// Whale delivery latency: market event received (rdtsc) -> frame written to a subscriber socket.
+// Updated concurrently by the session strands, read and reset by Server::speed_monitor.
+struct DeliveryLatency
+{
+    static const size_t BUCKET_SHIFT = 10;     // 2^10 ticks per bucket
+    static const size_t BUCKET_CNT = 4096;
+
+    std::atomic<uint64_t> count{ 0 };
+    std::atomic<uint64_t> total_ticks{ 0 };
+    std::atomic<uint64_t> buckets[BUCKET_CNT] = {};
+
+    void Add(uint64_t ticks)
+    {
+        size_t b_idx = static_cast<size_t>(ticks >> BUCKET_SHIFT);
+
+        count.fetch_add(1, std::memory_order_relaxed);
+        total_ticks.fetch_add(ticks, std::memory_order_relaxed);
+        buckets[(b_idx < BUCKET_CNT) ? b_idx : BUCKET_CNT - 1].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // upper bound of the bucket holding the 'p' quantile, in ticks (0 - no data)
+    uint64_t Percentile(double p) const
+    {
+        uint64_t total = 0;
+        for (size_t i = 0; i < BUCKET_CNT; i++)
+            total += buckets[i].load(std::memory_order_relaxed);
+
+        if (total == 0)
+            return 0;
+
+        uint64_t acc = 0;
+        for (size_t i = 0; i < BUCKET_CNT; i++)
+        {
+            acc += buckets[i].load(std::memory_order_relaxed);
+            if (acc >= total * p)
+                return static_cast<uint64_t>(i + 1) << BUCKET_SHIFT;
+        }
+
+        return static_cast<uint64_t>(BUCKET_CNT) << BUCKET_SHIFT;
+    }
+
+    void Reset()
+    {
+        count.store(0, std::memory_order_relaxed);
+        total_ticks.store(0, std::memory_order_relaxed);
+        for (auto& b : buckets)
+            b.store(0, std::memory_order_relaxed);
+    }
+};
+
+// Whale delivery -> kernel transmit (SO_TIMESTAMPING software TX time), power-of-two ns buckets.
+// Small enough to keep one per session; updated on the session strand, read and reset by Server::speed_monitor.
+struct TxLatency
+{
+    static const size_t BUCKET_CNT = 40;       // up to 2^40 ns
+    static const uint64_t OVERFLOW_NS = uint64_t(1) << (BUCKET_CNT - 1);    // ~9 min, the last bucket takes everything above
+
+    std::atomic<uint64_t> count{ 0 };
+    std::atomic<uint64_t> buckets[BUCKET_CNT] = {};
+
+    static size_t Bucket(uint64_t ns)
+    {
+        const size_t b = (ns > 1) ? static_cast<size_t>(std::bit_width(ns)) - 1 : 0;
+        return (b < BUCKET_CNT - 1) ? b : BUCKET_CNT - 1;
+    }
+
+    void Add(uint64_t ns)
+    {
+        count.fetch_add(1, std::memory_order_relaxed);
+        buckets[Bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Merge(const TxLatency& other)
+    {
+        count.fetch_add(other.count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        for (size_t i = 0; i < BUCKET_CNT; i++)
+            buckets[i].fetch_add(other.buckets[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    // upper bound of the bucket holding the 'p' quantile, in ns (0 - no data)
+    uint64_t Percentile(double p) const
+    {
+        uint64_t total = 0;
+        for (size_t i = 0; i < BUCKET_CNT; i++)
+            total += buckets[i].load(std::memory_order_relaxed);
+
+        if (total == 0)
+            return 0;
+
+        uint64_t acc = 0;
+        for (size_t i = 0; i < BUCKET_CNT; i++)
+        {
+            acc += buckets[i].load(std::memory_order_relaxed);
+            if (acc >= total * p)
+                return uint64_t(2) << i;
+        }
+
+        return uint64_t(2) << (BUCKET_CNT - 1);
+    }
+
+    void Reset()
+    {
+        count.store(0, std::memory_order_relaxed);
+        for (auto& b : buckets)
+            b.store(0, std::memory_order_relaxed);
+    }
+};
+
+// Live feed latency by stage: exchange event time -> receive, receive -> parsed, parsed -> analytics (hot_dispatcher).
+// Collected by hot_dispatcher in local buckets and merged here, read and reset by Server::speed_monitor.
+struct FeedLatency
+{
+    TxLatency exchange;         // "E" (exchange clock, ms) -> receive TSC on the local wall clock
+    TxLatency parse;
+    TxLatency analytics;
+    std::atomic<uint64_t> ahead{ 0 };     // received before the exchange time (clock offset), not in 'exchange'
+    std::atomic<uint64_t> late{ 0 };      // TxLatency::OVERFLOW_NS or more after it (clock step), not in 'exchange'
+
+    // local buckets of one thread: [stage][bucket]
+    struct Local
+    {
+        uint64_t buckets[3][TxLatency::BUCKET_CNT] = {};
+        uint64_t count = 0;
+        uint64_t ahead = 0;
+        uint64_t late = 0;
+
+        // exchange time -> receive of one trade
+        void AddExchange(int64_t ns)
+        {
+            if (ns < 0)
+                ahead++;
+            else if (static_cast<uint64_t>(ns) >= TxLatency::OVERFLOW_NS)
+                late++;
+            else
+                buckets[0][TxLatency::Bucket(static_cast<uint64_t>(ns))]++;
+        }
+    };
+
+    void Merge(Local& local)
+    {
+        TxLatency* stages[3] = { &exchange, &parse, &analytics };
+        for (size_t s = 0; s < 3; s++)
+        {
+            uint64_t cnt = 0;
+            for (size_t i = 0; i < TxLatency::BUCKET_CNT; i++)
+            {
+                if (local.buckets[s][i] == 0)
+                    continue;
+                stages[s]->buckets[i].fetch_add(local.buckets[s][i], std::memory_order_relaxed);
+                cnt += local.buckets[s][i];
+            }
+            stages[s]->count.fetch_add(cnt, std::memory_order_relaxed);
+        }
+        ahead.fetch_add(local.ahead, std::memory_order_relaxed);
+        late.fetch_add(local.late, std::memory_order_relaxed);
+        local = Local{};
+    }
+};
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+// Raw exchange feed capture: the WebSocket payloads as received, for offline parser benchmarks and regression tests.
+//
+// File layout (native little-endian): FeedCaptureHeader, then per message FeedFrameHeader + payload
+// (padded to 8 bytes), then FEED_CAPTURE_TAIL zero bytes. The tail keeps simdjson's padding readable after
+// the last payload, so a mapped capture is parsed in place.
+
+constexpr uint64_t FEED_CAPTURE_MAGIC = 0x3130444545464857ULL;     // "WHFEED01"
+constexpr uint32_t FEED_CAPTURE_VERSION = 1;
+constexpr size_t FEED_CAPTURE_TAIL = 64;
+
+
+struct FeedCaptureHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t reserved;
+    double   tsc_ghz;           // TSC ticks per ns of the recording box
+    uint64_t start_tsc;         // TSC and wall clock at Open(): epoch_ns = start_epoch_ns + (tsc - start_tsc) / tsc_ghz
+    uint64_t start_epoch_ns;
+    uint8_t  pad[24];
+};
+static_assert(sizeof(FeedCaptureHeader) == 64, "FeedCaptureHeader must be 64 bytes");
+
+struct FeedFrameHeader
+{
+    uint64_t tick_rcvd;         // receive TSC
+    uint32_t len;               // payload bytes
+    uint32_t reserved;
+};
+static_assert(sizeof(FeedFrameHeader) == 16, "FeedFrameHeader must be 16 bytes");
+
+
+// Appends messages to a capture file. The feed thread only copies into a block, the recorder's own thread writes
+// the full blocks, so no file I/O runs on the feed thread. Written blocks are reused; when the disk falls MAX_BLOCKS
+// behind, Add() waits for a free one (counted in GetWriterWaits()). Add() from one thread at a time.
+class FeedRecorder
+{
+public:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+    static constexpr size_t MAX_BLOCKS = 64;
+
+    FeedRecorder() = default;
+    ~FeedRecorder() { Close(); }
+
+    // disable copying
+    FeedRecorder(const FeedRecorder&) = delete;
+    FeedRecorder& operator=(const FeedRecorder&) = delete;
+
+    bool Open(const std::string& path, double tsc_ghz, uint64_t start_tsc)
+    {
+        Close();
+
+        m_file = std::fopen(path.c_str(), "wb");
+        if (!m_file)
+            return false;
+
+        m_stop = false;
+        m_buf.reserve(BUFFER_SIZE);
+        m_blocks = 1;
+        m_writer = std::thread(&FeedRecorder::writer, this);
+
+        FeedCaptureHeader h;
+        std::memset(&h, 0, sizeof(h));
+        h.magic = FEED_CAPTURE_MAGIC;
+        h.version = FEED_CAPTURE_VERSION;
+        h.tsc_ghz = tsc_ghz;
+        h.start_tsc = start_tsc;
+        h.start_epoch_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+
+        append(&h, sizeof(h));
+        return true;
+    }
+
+    void Add(uint64_t tick_rcvd, std::string_view payload)
+    {
+        if (!m_file)
+            return;
+
+        FeedFrameHeader f{ tick_rcvd, static_cast<uint32_t>(payload.size()), 0 };
+        append(&f, sizeof(f));
+        append(payload.data(), payload.size());
+
+        static const char zeros[8] = {};
+        append(zeros, (8 - payload.size() % 8) % 8);
+
+        m_frames++;
+        m_bytes += payload.size();
+    }
+
+    // writes everything added so far and closes the file
+    void Close()
+    {
+        if (!m_file)
+            return;
+
+        static const char tail[FEED_CAPTURE_TAIL] = {};
+        append(tail, sizeof(tail));
+
+        {
+            std::lock_guard<std::mutex> lk(m_mtx);
+            m_full.push_back(std::move(m_buf));
+            m_stop = true;
+        }
+        m_cv_full.notify_one();
+        m_writer.join();
+
+        std::fclose(m_file);
+        m_file = nullptr;
+        m_buf.clear();
+        m_free.clear();
+    }
+
+    bool IsOpen() const { return m_file != nullptr; }
+    uint64_t GetFrameCount() const { return m_frames; }
+    uint64_t GetPayloadBytes() const { return m_bytes; }
+    uint64_t GetWriterWaits() const { return m_waits; }
+
+private:
+    void append(const void* data, size_t size)
+    {
+        if (!m_buf.empty() && m_buf.size() + size > BUFFER_SIZE)
+            hand_off();
+
+        // a payload above BUFFER_SIZE gets a block of its own size
+        const char* p = static_cast<const char*>(data);
+        m_buf.insert(m_buf.end(), p, p + size);
+    }
+
+    // the current block to the writer thread, a written (or a new) one in its place
+    void hand_off()
+    {
+        bool reuse = false;
+        {
+            std::unique_lock<std::mutex> lk(m_mtx);
+            m_full.push_back(std::move(m_buf));
+            m_cv_full.notify_one();
+
+            if (m_free.empty() && m_blocks >= MAX_BLOCKS)
+            {
+                m_waits++;
+                m_cv_free.wait(lk, [this]() { return !m_free.empty(); });
+            }
+
+            if (!m_free.empty())
+            {
+                m_buf = std::move(m_free.back());
+                m_free.pop_back();
+                reuse = true;
+            }
+            else
+                m_blocks++;
+        }
+
+        if (!reuse)
+            m_buf = std::vector<char>();
+        m_buf.clear();
+        m_buf.reserve(BUFFER_SIZE);
+    }
+
+    void writer()
+    {
+        std::unique_lock<std::mutex> lk(m_mtx);
+        while (true)
+        {
+            m_cv_full.wait(lk, [this]() { return !m_full.empty() || m_stop; });
+            if (m_full.empty())
+                break;      // stopped and everything written
+
+            std::vector<char> block = std::move(m_full.front());
+            m_full.pop_front();
+            lk.unlock();
+
+            if (!block.empty())
+                std::fwrite(block.data(), 1, block.size(), m_file);
+            block.clear();
+
+            lk.lock();
+            m_free.push_back(std::move(block));
+            m_cv_free.notify_one();
+        }
+    }
+
+private:
+    std::FILE* m_file{ nullptr };
+    std::vector<char> m_buf;                    // block being filled by Add()
+    uint64_t m_frames{ 0 };
+    uint64_t m_bytes{ 0 };
+    uint64_t m_waits{ 0 };
+    size_t m_blocks{ 0 };
+
+    std::thread m_writer;
+    std::mutex m_mtx;
+    std::condition_variable m_cv_full;
+    std::condition_variable m_cv_free;
+    std::deque<std::vector<char>> m_full;       // to be written, in file order
+    std::vector<std::vector<char>> m_free;      // written, for reuse
+    bool m_stop{ false };
+};
+
+
+// Read-only mapping of a capture file. Frames are visited in place; a capture cut short (the recorder was killed)
+// ends at its last complete frame.
+class FeedCaptureReader
+{
+public:
+    struct Frame
+    {
+        uint64_t tick_rcvd;
+        std::string_view payload;
+        size_t capacity;        // readable bytes at payload.data() (for in-place parsing)
+    };
+
+    explicit FeedCaptureReader(const std::string& path)
+    {
+#ifdef _WIN32
+        m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("capture: cannot open " + path);
+
+        LARGE_INTEGER size;
+        GetFileSizeEx(m_file, &size);
+        m_size = static_cast<size_t>(size.QuadPart);
+        if (m_size < sizeof(FeedCaptureHeader))
+        {
+            close();
+            throw std::runtime_error("capture: truncated " + path);
+        }
+
+        m_handle = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        m_addr = m_handle ? MapViewOfFile(m_handle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!m_addr)
+        {
+            close();
+            throw std::runtime_error("capture: cannot map " + path);
+        }
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("capture: cannot open " + path);
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FeedCaptureHeader))
+        {
+            ::close(fd);
+            throw std::runtime_error("capture: truncated " + path);
+        }
+        m_size = static_cast<size_t>(st.st_size);
+
+        m_addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (m_addr == MAP_FAILED)
+        {
+            m_addr = nullptr;
+            throw std::runtime_error("capture: cannot map " + path);
+        }
+        madvise(m_addr, m_size, MADV_SEQUENTIAL);
+#endif
+
+        std::memcpy(&m_header, m_addr, sizeof(m_header));
+        if (m_header.magic != FEED_CAPTURE_MAGIC || m_header.version != FEED_CAPTURE_VERSION)
+        {
+            close();
+            throw std::runtime_error("capture: not a feed capture " + path);
+        }
+
+        Rewind();
+    }
+
+    ~FeedCaptureReader() { close(); }
+
+    // disable copying
+    FeedCaptureReader(const FeedCaptureReader&) = delete;
+    FeedCaptureReader& operator=(const FeedCaptureReader&) = delete;
+
+    const FeedCaptureHeader& GetHeader() const { return m_header; }
+
+    void Rewind() { m_pos = sizeof(FeedCaptureHeader); }
+
+    // false at the end of the capture
+    bool Next(Frame& out)
+    {
+        const char* base = static_cast<const char*>(m_addr);
+
+        if (m_pos + sizeof(FeedFrameHeader) > m_size)
+            return false;
+
+        FeedFrameHeader f;
+        std::memcpy(&f, base + m_pos, sizeof(f));
+
+        const size_t data = m_pos + sizeof(f);
+        if (f.len == 0 && f.tick_rcvd == 0)
+            return false;       // the zero tail
+        if (data + f.len > m_size)
+            return false;
+
+        out.tick_rcvd = f.tick_rcvd;
+        out.payload = std::string_view(base + data, f.len);
+        out.capacity = m_size - data;
+
+        m_pos = data + ((f.len + 7) & ~size_t(7));
+        return true;
+    }
+
+private:
+    void close()
+    {
+#ifdef _WIN32
+        if (m_addr)
+            UnmapViewOfFile(m_addr);
+        if (m_handle)
+            CloseHandle(m_handle);
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+        m_handle = nullptr;
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        if (m_addr)
+            munmap(m_addr, m_size);
+#endif
+        m_addr = nullptr;
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE m_file{ INVALID_HANDLE_VALUE };
+    HANDLE m_handle{ nullptr };
+#endif
+    void* m_addr{ nullptr };
+    size_t m_size{ 0 };
+    size_t m_pos{ 0 };
+    FeedCaptureHeader m_header;
+};
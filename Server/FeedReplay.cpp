@@ -0,0 +1,77 @@
+// Offline ingest benchmark: replays a feed capture (Server --feed_record) through Server::ProcessMarketMsg at full speed.
+// Usage: FeedReplay <capture> [rounds]
+// The pipeline is not started, so this measures the ingest alone: parse, symbol lookup and the hot buffer push.
+#include "Server.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: FeedReplay <capture> [rounds]\n";
+        return 1;
+    }
+
+    const int rounds = (argc >= 3) ? std::max(1, std::atoi(argv[2])) : 10;
+
+    try
+    {
+        FeedCaptureReader reader(argv[1]);
+
+        boost::asio::io_context io;
+        Server server(io, 0);
+        server.EnableShowLogMsg(false);
+
+        // the capture itself
+        uint64_t frames = 0, bytes = 0, first_tick = 0, last_tick = 0;
+        FeedCaptureReader::Frame f;
+        while (reader.Next(f))
+        {
+            if (frames == 0)
+                first_tick = f.tick_rcvd;
+            last_tick = f.tick_rcvd;
+            frames++;
+            bytes += f.payload.size();
+        }
+
+        if (frames == 0)
+        {
+            std::cerr << "Empty capture\n";
+            return 1;
+        }
+
+        const double recorded_sec = static_cast<double>(last_tick - first_tick) / reader.GetHeader().tsc_ghz / 1e9;
+        std::cout << "Capture: " << frames << " messages, " << bytes << " bytes, " << std::fixed << std::setprecision(1)
+            << recorded_sec << " s recorded\n";
+
+        uint64_t trades = 0;
+        auto t1 = std::chrono::steady_clock::now();
+
+        for (int r = 0; r < rounds; r++)
+        {
+            reader.Rewind();
+            while (reader.Next(f))
+                trades += server.ProcessMarketMsg(f.payload, f.capacity, f.tick_rcvd);
+        }
+
+        auto t2 = std::chrono::steady_clock::now();
+        const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+        const double msgs = static_cast<double>(frames) * rounds;
+
+        std::cout << "Replay x" << rounds << ": " << trades / rounds << " trades per round | "
+            << std::setprecision(1) << ns / msgs << " ns/msg | "
+            << (trades ? ns / static_cast<double>(trades) : 0.0) << " ns/trade | "
+            << std::setprecision(2) << static_cast<double>(bytes) * rounds / ns * 1e3 << " MB/s | "
+            << msgs / ns * 1e3 << " M msg/s\n";
+    }
+    catch (std::exception& ex)
+    {
+        std::cerr << "\n" << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
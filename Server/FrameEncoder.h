@@ -0,0 +1,291 @@
+#pragma once
+
+#include "WhaleEvent.h"
+#include "FramePool.h"
+#include "Analytics.h"
+#include <Protocol.h>
+#include <DeltaCodec.h>
+#include <Utils.h>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <string_view>
+
+
+// Symbol name in v1 wire form: uint16_t len (big-endian) + chars.
+// Built once at startup, so encoding a whale is a single memcpy instead of a std::string per event.
+struct SymbolWire
+{
+    uint8_t bytes[2 + 16];
+    uint8_t size;
+
+    void Set(std::string_view symbol)
+    {
+        size_t len = (symbol.size() > 16) ? 16 : symbol.size();
+        uint16_t len_be = host_to_net_u16(static_cast<uint16_t>(len));
+        std::memcpy(bytes, &len_be, 2);
+        std::memcpy(bytes + 2, symbol.data(), len);
+        size = static_cast<uint8_t>(2 + len);
+    }
+};
+
+
+// v1 record: price(8) qty(8) is_sell(1) timestamp(8) symbol(2+len) vwap_sess(8) vwap_roll50(8) delta_roll(8)
+constexpr size_t WHALE_RECORD_V1_MAX = 8 + 8 + 1 + 8 + sizeof(SymbolWire::bytes) + 8 + 8 + 8;
+
+inline constexpr size_t WhaleRecordsV1MaxSize(size_t count)
+{
+    return count * WHALE_RECORD_V1_MAX;
+}
+
+
+inline uint8_t* put_u32_be(uint8_t* p, uint32_t v)
+{
+    v = host_to_net_u32(v);
+    std::memcpy(p, &v, 4);
+    return p + 4;
+}
+
+inline uint8_t* put_u64_be(uint8_t* p, uint64_t v)
+{
+    v = host_to_net_u64(v);
+    std::memcpy(p, &v, 8);
+    return p + 8;
+}
+
+inline uint8_t* put_f64_be(uint8_t* p, double d)
+{
+    uint64_t v;
+    static_assert(sizeof(v) == sizeof(d), "double size mismatch");
+    std::memcpy(&v, &d, sizeof(v));
+    return put_u64_be(p, v);
+}
+
+
+inline void WriteFrameHeader(uint8_t* out, uint8_t version, uint8_t data_type, uint32_t payload_len)
+{
+    SProtocolHeader hdr;
+    hdr.signature = host_to_net_u16(PROTOCOL_HEADER_SIGNATURE);
+    hdr.version = version;
+    hdr.data_type = data_type;
+    hdr.msg_num = 0;    // stamped on the session strand, see StampMsgNum()
+    hdr.len = host_to_net_u32(payload_len);
+    std::memcpy(out, &hdr, sizeof(hdr));
+}
+
+inline void StampMsgNum(uint8_t* frame, uint8_t msg_num)
+{
+    frame[offsetof(SProtocolHeader, msg_num)] = msg_num;
+}
+
+
+// Single-pass encoding of whale records (no header / count).
+// Used for shared segments: encoded once, sent by every session with its own header.
+// 'out' must hold at least WhaleRecordsV1MaxSize(count) bytes. Returns the encoded size.
+inline size_t EncodeWhaleRecordsV1(uint8_t* out, const WhaleEvent* events, size_t count, const SymbolWire* symbols, size_t symbol_cnt)
+{
+    uint8_t* p = out;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const WhaleEvent& we = events[i];
+
+        p = put_f64_be(p, we.price);
+        p = put_f64_be(p, we.quantity);
+
+        *p++ = static_cast<uint8_t>(we.is_sell);
+
+        p = put_u64_be(p, we.timestamp);
+
+        // symbol name (unknown index -> empty name)
+        if (we.index_symbol >= 0 && static_cast<size_t>(we.index_symbol) < symbol_cnt) [[likely]]
+        {
+            const SymbolWire& sw = symbols[we.index_symbol];
+            std::memcpy(p, sw.bytes, sw.size);
+            p += sw.size;
+        }
+        else
+        {
+            *p++ = 0;
+            *p++ = 0;
+        }
+
+        p = put_f64_be(p, we.vwap_sess);
+        p = put_f64_be(p, we.vwap_roll50);
+        p = put_f64_be(p, static_cast<double>(we.delta_roll));
+    }
+
+    return p - out;
+}
+
+// Per-session part of a whale frame: header + count, followed on the wire by a shared record segment.
+// (the largest head: v2 frames and control frames carry the header only)
+constexpr size_t WHALE_FRAME_HEAD_SIZE = sizeof(SProtocolHeader) + 4;
+constexpr size_t FRAME_HEAD_MAX_SIZE = WHALE_FRAME_HEAD_SIZE;
+
+inline void EncodeWhaleFrameHeadV1(uint8_t* out, uint32_t count, size_t records_size, uint8_t msg_num)
+{
+    WriteFrameHeader(out, PROTOCOL_VERSION_1, MSG_DATA, static_cast<uint32_t>(4 + records_size));
+    StampMsgNum(out, msg_num);
+    put_u32_be(out + sizeof(SProtocolHeader), count);
+}
+
+
+// v2: records are SWhaleRecordV2 as is, no count (count = len / 64).
+inline constexpr size_t WhaleRecordsV2Size(size_t count)
+{
+    return count * sizeof(SWhaleRecordV2);
+}
+
+inline size_t EncodeWhaleRecordsV2(uint8_t* out, const WhaleEvent* events, size_t count)
+{
+    SWhaleRecordV2* rec = reinterpret_cast<SWhaleRecordV2*>(out);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const WhaleEvent& we = events[i];
+        SWhaleRecordV2 r{};
+
+        r.price = we.price;
+        r.quantity = we.quantity;
+        r.timestamp = we.timestamp;
+        r.vwap_sess = we.vwap_sess;
+        r.vwap_roll50 = we.vwap_roll50;
+        r.delta_roll = we.delta_roll;
+        r.symbol = static_cast<uint32_t>(we.index_symbol);
+        r.is_sell = static_cast<uint8_t>(we.is_sell);
+        r.seq = we.seq;
+
+        std::memcpy(&rec[i], &r, sizeof(r));
+    }
+
+    return WhaleRecordsV2Size(count);
+}
+
+// v2 symbol dictionary payload, sent once after subscribe
+inline constexpr size_t SymbolDictV2MaxSize(size_t symbol_cnt)
+{
+    return 4 + symbol_cnt * (4 + 1 + 16);
+}
+
+inline size_t EncodeSymbolDictV2(uint8_t* out, const SymbolWire* symbols, size_t symbol_cnt)
+{
+    uint8_t* p = out;
+
+    uint32_t cnt = static_cast<uint32_t>(symbol_cnt);
+    std::memcpy(p, &cnt, 4);
+    p += 4;
+
+    for (uint32_t i = 0; i < cnt; i++)
+    {
+        std::memcpy(p, &i, 4);
+        p += 4;
+
+        uint8_t len = symbols[i].size - 2;
+        *p++ = len;
+        std::memcpy(p, symbols[i].bytes + 2, len);
+        p += len;
+    }
+
+    return p - out;
+}
+
+
+// Gap notice: header + dropped record count, small enough to be sent as a head without body
+constexpr size_t GAP_FRAME_SIZE = sizeof(SProtocolHeader) + 4;
+static_assert(GAP_FRAME_SIZE <= FRAME_HEAD_MAX_SIZE, "gap notice must fit a frame head");
+
+inline size_t EncodeGapFrame(uint8_t* out, uint8_t version, uint32_t dropped)
+{
+    WriteFrameHeader(out, version, MSG_GAP, 4);
+
+    if (version == PROTOCOL_VERSION_1)
+        put_u32_be(out + sizeof(SProtocolHeader), dropped);
+    else
+        std::memcpy(out + sizeof(SProtocolHeader), &dropped, 4);
+
+    return GAP_FRAME_SIZE;
+}
+
+// Snapshot payload of the given coins (v1: count + records with symbol names, v2: SSnapshotRecordV2 array)
+// (+4: room for the request id of a query result)
+constexpr size_t SNAPSHOT_RECORD_V1_MAX = sizeof(SymbolWire::bytes) + 7 * 8;
+
+inline constexpr size_t SnapshotMaxSize(size_t count)
+{
+    return 4 + 4 + count * (SNAPSHOT_RECORD_V1_MAX > sizeof(SSnapshotRecordV2) ? SNAPSHOT_RECORD_V1_MAX : sizeof(SSnapshotRecordV2));
+}
+
+inline size_t EncodeSnapshotV1(uint8_t* out, const CoinSnapshot* snaps, size_t count, const SymbolWire* symbols, size_t symbol_cnt)
+{
+    uint8_t* p = put_u32_be(out, static_cast<uint32_t>(count));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const CoinSnapshot& s = snaps[i];
+
+        if (s.index_symbol >= 0 && static_cast<size_t>(s.index_symbol) < symbol_cnt)
+        {
+            const SymbolWire& sw = symbols[s.index_symbol];
+            std::memcpy(p, sw.bytes, sw.size);
+            p += sw.size;
+        }
+        else
+        {
+            *p++ = 0;
+            *p++ = 0;
+        }
+
+        p = put_f64_be(p, s.last_price);
+        p = put_f64_be(p, s.last_qty);
+        p = put_u64_be(p, s.timestamp);
+        p = put_f64_be(p, s.vwap_sess);
+        p = put_f64_be(p, s.vwap_roll50);
+        p = put_f64_be(p, s.volume_sess);
+        p = put_u64_be(p, s.trade_cnt);
+    }
+
+    return p - out;
+}
+
+inline size_t EncodeSnapshotV2(uint8_t* out, const CoinSnapshot* snaps, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const CoinSnapshot& s = snaps[i];
+        SSnapshotRecordV2 r{};
+
+        r.last_price = s.last_price;
+        r.last_qty = s.last_qty;
+        r.timestamp = s.timestamp;
+        r.vwap_sess = s.vwap_sess;
+        r.vwap_roll50 = s.vwap_roll50;
+        r.volume_sess = s.volume_sess;
+        r.trade_cnt = s.trade_cnt;
+        r.symbol = static_cast<uint32_t>(s.index_symbol);
+
+        std::memcpy(out + i * sizeof(r), &r, sizeof(r));
+    }
+
+    return count * sizeof(SSnapshotRecordV2);
+}
+
+inline bool IsWhaleSegment(const Frame* f)
+{
+    return f && (f->data_type == MSG_DATA || f->data_type == MSG_DATA_DELTA);
+}
+
+
+// Per-session head for a queued segment (msg_num is per session). Returns the head size.
+inline size_t EncodeSegmentHead(uint8_t* out, const Frame& segment, uint8_t msg_num)
+{
+    if (segment.version == PROTOCOL_VERSION_1 && segment.data_type == MSG_DATA)
+    {
+        EncodeWhaleFrameHeadV1(out, segment.count, segment.size, msg_num);
+        return WHALE_FRAME_HEAD_SIZE;
+    }
+
+    WriteFrameHeader(out, segment.version, segment.data_type, static_cast<uint32_t>(segment.size));
+    StampMsgNum(out, msg_num);
+    return sizeof(SProtocolHeader);
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+
+class FramePool;
+
+// Reusable outbound frame (or shared record segment).
+// The buffer grows to the largest frame ever encoded into it and never shrinks,
+// so after warm-up the encode path does not touch the heap.
+// Refcounted: one encoded segment can be queued by many sessions at once.
+struct Frame
+{
+    std::vector<uint8_t> buf;
+    size_t size = 0;
+    uint32_t count = 0;     // records in the segment
+    uint8_t version = 1;    // wire format of the content
+    uint8_t data_type = 0x02;
+    int ind_symbol = -1;    // coin of a whale segment (-1 = control frame)
+    bool express = false;   // mega-whale, sent ahead of the queued frames
+    uint64_t tick_rcvd = 0; // oldest record's receive time (rdtsc), 0 - not measured
+    uint64_t tick_deliver = 0;  // handed to the sessions (rdtsc), start of the TX timestamp latency
+
+    FramePool* owner = nullptr;
+    std::atomic<uint32_t> refs{ 0 };
+
+    inline uint8_t* data() { return buf.data(); }
+    inline const uint8_t* data() const { return buf.data(); }
+};
+
+
+// Free-list of frames.
+// Acquire() is called by the encoding thread, Release() by the write completions (strands),
+// so the list is guarded by a mutex (no allocation inside the lock in steady state).
+class FramePool
+{
+public:
+    FramePool(size_t prealloc_cnt = 0, size_t frame_capacity = 0)
+    {
+        std::lock_guard<std::mutex> lk(m_mtx);
+
+        m_frames.reserve(prealloc_cnt);
+        m_free.reserve(prealloc_cnt);
+
+        for (size_t i = 0; i < prealloc_cnt; i++)
+        {
+            m_frames.push_back(std::make_unique<Frame>());
+            m_frames.back()->buf.resize(frame_capacity);
+            m_frames.back()->owner = this;
+            m_free.push_back(m_frames.back().get());
+        }
+    }
+
+    // disable copying
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    Frame* Acquire(size_t capacity)
+    {
+        Frame* f = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lk(m_mtx);
+
+            if (!m_free.empty())
+            {
+                f = m_free.back();
+                m_free.pop_back();
+            }
+            else
+            {
+                // warm-up: pool grows until it covers the max number of frames in flight
+                m_frames.push_back(std::make_unique<Frame>());
+                f = m_frames.back().get();
+                f->owner = this;
+
+                // keep Release() allocation-free
+                m_free.reserve(m_frames.size());
+            }
+        }
+
+        if (f->buf.size() < capacity) [[unlikely]]
+        {
+            f->buf.resize(capacity);
+        }
+
+        f->size = 0;
+        f->count = 0;
+        f->version = 1;
+        f->data_type = 0x02;
+        f->ind_symbol = -1;
+        f->express = false;
+        f->tick_rcvd = 0;
+        f->tick_deliver = 0;
+        f->refs.store(1, std::memory_order_relaxed);
+
+        return f;
+    }
+
+    static void AddRef(Frame* f, uint32_t cnt = 1)
+    {
+        f->refs.fetch_add(cnt, std::memory_order_relaxed);
+    }
+
+    // drop one reference, the last one returns the frame to its pool
+    static void Release(Frame* f)
+    {
+        if (!f)
+            return;
+
+        if (f->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            f->owner->put_free(f);
+        }
+    }
+
+    size_t GetFrameCount()
+    {
+        std::lock_guard<std::mutex> lk(m_mtx);
+        return m_frames.size();
+    }
+
+    size_t GetFreeCount()
+    {
+        std::lock_guard<std::mutex> lk(m_mtx);
+        return m_free.size();
+    }
+
+private:
+    void put_free(Frame* f)
+    {
+        std::lock_guard<std::mutex> lk(m_mtx);
+        m_free.push_back(f);
+    }
+
+private:
+    std::mutex m_mtx;
+    std::vector<std::unique_ptr<Frame>> m_frames;
+    std::vector<Frame*> m_free;
+};
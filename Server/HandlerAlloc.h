@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+// Fixed storage for asio handler ops (see asio "allocation" example).
+// A post from a non-io thread (Session::event_reader) can't use asio's thread-local
+// recycling allocator, so without this every post() would hit the heap.
+// A post to a strand allocates two ops (strand op + strand invoker), hence several slots.
+// 'slot_size' - larger for ops that carry their buffers (a gather write: ~1.2 KB with 64 buffers).
+class HandlerMemory
+{
+public:
+    static constexpr size_t SLOT_CNT = 4;
+    static constexpr size_t SLOT_SIZE = 256;
+
+    explicit HandlerMemory(size_t slot_size = SLOT_SIZE)
+        : m_slot_size((slot_size + sizeof(Slot) - 1) / sizeof(Slot) * sizeof(Slot))
+        , m_storage(std::make_unique<Slot[]>(SLOT_CNT * m_slot_size / sizeof(Slot)))
+    {
+    }
+
+    // disable copying
+    HandlerMemory(const HandlerMemory&) = delete;
+    HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+    void* allocate(size_t size)
+    {
+        if (size <= m_slot_size)
+        {
+            for (size_t i = 0; i < SLOT_CNT; i++)
+            {
+                if (!m_in_use[i].exchange(true, std::memory_order_acquire))
+                {
+                    return slot(i);
+                }
+            }
+        }
+
+        return ::operator new(size);
+    }
+
+    void deallocate(void* p)
+    {
+        for (size_t i = 0; i < SLOT_CNT; i++)
+        {
+            if (p == slot(i))
+            {
+                m_in_use[i].store(false, std::memory_order_release);
+                return;
+            }
+        }
+
+        ::operator delete(p);
+    }
+
+private:
+    struct alignas(std::max_align_t) Slot
+    {
+        unsigned char data[alignof(std::max_align_t)];
+    };
+
+    void* slot(size_t i) const { return m_storage[i * m_slot_size / sizeof(Slot)].data; }
+
+    const size_t m_slot_size;
+    std::unique_ptr<Slot[]> m_storage;
+    std::atomic<bool> m_in_use[SLOT_CNT] = {};
+};
+
+
+template <typename T>
+class HandlerAllocator
+{
+public:
+    using value_type = T;
+
+    explicit HandlerAllocator(HandlerMemory& mem) : m_memory(mem) {}
+
+    template <typename U>
+    HandlerAllocator(const HandlerAllocator<U>& other) noexcept : m_memory(other.m_memory) {}
+
+    bool operator==(const HandlerAllocator& other) const noexcept { return &m_memory == &other.m_memory; }
+    bool operator!=(const HandlerAllocator& other) const noexcept { return &m_memory != &other.m_memory; }
+
+    T* allocate(size_t n) const { return static_cast<T*>(m_memory.allocate(sizeof(T) * n)); }
+    void deallocate(T* p, size_t /*n*/) const { return m_memory.deallocate(p); }
+
+private:
+    template <typename> friend class HandlerAllocator;
+
+    HandlerMemory& m_memory;
+};
+
+
+template <typename Handler>
+class CustomAllocHandler
+{
+public:
+    using allocator_type = HandlerAllocator<Handler>;
+
+    CustomAllocHandler(HandlerMemory& mem, Handler h) : m_memory(mem), m_handler(std::move(h)) {}
+
+    allocator_type get_allocator() const noexcept { return allocator_type(m_memory); }
+
+    template <typename ...Args>
+    void operator()(Args&&... args)
+    {
+        m_handler(std::forward<Args>(args)...);
+    }
+
+private:
+    HandlerMemory& m_memory;
+    Handler m_handler;
+};
+
+
+template <typename Handler>
+inline CustomAllocHandler<std::decay_t<Handler>> MakeCustomAllocHandler(HandlerMemory& mem, Handler&& h)
+{
+    return CustomAllocHandler<std::decay_t<Handler>>(mem, std::forward<Handler>(h));
+}
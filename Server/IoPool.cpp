@@ -0,0 +1,161 @@
+// IoPool.cpp
+
+#include "IoPool.h"
+#include <Utils.h>
+#include <future>
+
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+using error_code = boost::system::error_code;
+
+// Server.cpp
+#ifdef _WIN32
+void set_affinity(std::thread& t, int logical_core_id);
+#else
+void set_affinity(pthread_t t, int logical_core_id);
+#endif
+
+#ifdef SO_REUSEPORT
+using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+
+IoPool::IoPool(uint32_t threads, int first_core)
+    : m_first_core(first_core)
+{
+    m_workers.reserve(threads);
+    for (uint32_t i = 0; i < threads; i++)
+        m_workers.push_back(std::make_unique<Worker>());
+}
+
+IoPool::~IoPool()
+{
+    Stop();
+}
+
+bool IoPool::HasReusePort()
+{
+#ifdef SO_REUSEPORT
+    return true;
+#else
+    return false;
+#endif
+}
+
+void IoPool::OpenAcceptor(tcp::acceptor& acceptor, uint16_t port, bool reuse)
+{
+    tcp::endpoint ep(tcp::v4(), port);
+
+    acceptor.open(ep.protocol());
+    acceptor.set_option(tcp::acceptor::reuse_address(true));
+#ifdef SO_REUSEPORT
+    if (reuse)
+        acceptor.set_option(reuse_port(true));
+#endif
+    acceptor.bind(ep);
+    acceptor.listen();
+}
+
+void IoPool::Start(uint16_t port, AcceptHandler handler)
+{
+    m_handler = std::move(handler);
+
+    for (size_t i = 0; i < m_workers.size(); i++)
+    {
+        Worker& w = *m_workers[i];
+
+        if (HasReusePort())
+        {
+            w.acceptor = std::make_unique<tcp::acceptor>(w.io);
+            OpenAcceptor(*w.acceptor, port, true);
+            do_accept(w);
+        }
+
+        w.thread = std::thread([&w]() { w.io.run(); });
+
+        if (m_first_core >= 0)
+        {
+#ifdef _WIN32
+            set_affinity(w.thread, m_first_core + static_cast<int>(i));
+#else
+            set_affinity(w.thread.native_handle(), m_first_core + static_cast<int>(i));
+#endif
+        }
+    }
+}
+
+void IoPool::CloseListeners()
+{
+    for (auto& w : m_workers)
+    {
+        if (!w->acceptor || !w->thread.joinable())
+            continue;
+
+        // on the worker's thread: the acceptor is not thread-safe
+        std::promise<void> done;
+        asio::post(w->io, [&w, &done]()
+            {
+                error_code ec;
+                w->acceptor->close(ec);
+                done.set_value();
+            });
+        done.get_future().wait();
+    }
+}
+
+void IoPool::Stop()
+{
+    for (auto& w : m_workers)
+    {
+        w->work.reset();
+        w->io.stop();
+    }
+
+    for (auto& w : m_workers)
+    {
+        if (w->thread.joinable())
+            w->thread.join();
+    }
+
+    m_workers.clear();
+}
+
+asio::io_context& IoPool::Next()
+{
+    return m_workers[m_next.fetch_add(1, std::memory_order_relaxed) % m_workers.size()]->io;
+}
+
+void IoPool::CountAccepted(const asio::io_context& io)
+{
+    for (auto& w : m_workers)
+    {
+        if (&w->io == &io)
+            w->accepted.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void IoPool::do_accept(Worker& w)
+{
+    w.acceptor->async_accept([this, &w](error_code ec, tcp::socket socket)
+        {
+            if (!ec)
+            {
+                w.accepted.fetch_add(1, std::memory_order_relaxed);
+                m_handler(std::move(socket));
+                do_accept(w);
+            }
+            else if (ec == asio::error::operation_aborted)
+            {
+                // closed by CloseListeners()
+            }
+            else if (ec == asio::error::would_block || ec == asio::error::interrupted)
+            {
+                write_error("Accept error", ec);
+                do_accept(w);
+            }
+            else
+            {
+                write_error("Accept error, STOP ACCEPT!", ec);
+            }
+        });
+}
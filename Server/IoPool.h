@@ -0,0 +1,65 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+
+// I/O threads with an io_context each (optionally pinned one per core).
+// With SO_REUSEPORT every thread listens on the server port itself: the kernel spreads the connections
+// and a session stays on the thread that accepted it (its socket and strand use that io_context).
+// Without it (Windows) the server's acceptor hands the connections out round-robin via Next().
+class IoPool
+{
+public:
+    using AcceptHandler = std::function<void(boost::asio::ip::tcp::socket)>;
+
+    // 'first_core' - core of the first thread, -1 - not pinned
+    IoPool(uint32_t threads, int first_core = -1);
+    ~IoPool();
+
+    // disable copying
+    IoPool(const IoPool&) = delete;
+    IoPool& operator=(const IoPool&) = delete;
+
+    // starts the threads (and their listeners on 'port' if SO_REUSEPORT is available)
+    void Start(uint16_t port, AcceptHandler handler);
+    // no new connections after it returns
+    void CloseListeners();
+    // closes the listeners, stops and joins the threads; pending handlers (sessions) are destroyed here
+    void Stop();
+
+    boost::asio::io_context& Next();
+    // a connection accepted elsewhere was handed to the thread of 'io'
+    void CountAccepted(const boost::asio::io_context& io);
+
+    size_t Size() const { return m_workers.size(); }
+    // connections accepted by / handed to the thread
+    uint64_t GetAccepted(size_t i) const { return m_workers[i]->accepted.load(std::memory_order_relaxed); }
+
+    static bool HasReusePort();
+    // open + bind + listen, SO_REUSEPORT if 'reuse_port' (and available)
+    static void OpenAcceptor(boost::asio::ip::tcp::acceptor& acceptor, uint16_t port, bool reuse_port);
+
+private:
+    struct Worker
+    {
+        boost::asio::io_context io{ 1 };   // one thread: no locking inside asio
+        boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work{ io.get_executor() };
+        std::unique_ptr<boost::asio::ip::tcp::acceptor> acceptor;
+        std::thread thread;
+        std::atomic<uint64_t> accepted{ 0 };
+    };
+
+    void do_accept(Worker& w);
+
+private:
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    int m_first_core;
+    AcceptHandler m_handler;
+    std::atomic<uint32_t> m_next{ 0 };
+};
@@ -0,0 +1,396 @@
+// Local mock of the Binance trade stream for offline end-to-end runs of Server::binance_stream (Server --feed_url=its URL).
+// Usage: MockExchange <port> [scenario] [capture]
+//   scenario: "rate=20000,burst=10:50000,disconnect=30,stall=45:7"
+//     rate        messages per second (0 with a capture - its recorded pace), default 1000
+//     burst       every N s: M messages back to back
+//     disconnect  every N s: all connections are closed (the server reconnects)
+//     stall       every N s: nothing is sent for M s, connections stay open (the server's 5 s stall detector)
+//   capture: a feed capture (Server --feed_record) replayed in a loop instead of synthetic trades
+// Synthetic trades carry the send time in "E", so the exchange -> server latency is the real one.
+// A combined-stream URL (".../stream?streams=btcusdt@trade/ethusdt@trade") gets only its coins' synthetic trades.
+// "delay=<us>" and "jitter=<us>" in a connection's URL hold its messages back (a slower feed line for the A/B arbitration):
+// every connection gets the same trades, this one delay + random(jitter) later, in order.
+#include "FeedCapture.h"
+#include <ixwebsocket/IXNetSystem.h>
+#include <ixwebsocket/IXWebSocket.h>
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <memory>
+#include <set>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cctype>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using steady_clock = std::chrono::steady_clock;
+
+
+static std::atomic<bool> g_running{ true };
+
+void signal_handler(int s)
+{
+    g_running = false;
+}
+
+struct MockScenario
+{
+    uint32_t rate = 1000;
+    uint32_t burst_every_sec = 0;
+    uint32_t burst_count = 0;
+    uint32_t disconnect_every_sec = 0;
+    uint32_t stall_every_sec = 0;
+    uint32_t stall_sec = 0;
+};
+
+static MockScenario parse_scenario(const std::string& text)
+{
+    MockScenario sc;
+    std::stringstream ss(text);
+    std::string item;
+
+    while (std::getline(ss, item, ','))
+    {
+        size_t eq = item.find('=');
+        if (eq == std::string::npos)
+            continue;
+
+        std::string key = item.substr(0, eq);
+        const char* value = item.c_str() + eq + 1;
+        const char* colon = std::strchr(value, ':');
+        uint32_t first = static_cast<uint32_t>(std::atoi(value));
+        uint32_t second = colon ? static_cast<uint32_t>(std::atoi(colon + 1)) : 0;
+
+        if (key == "rate")
+            sc.rate = first;
+        else if (key == "burst")
+            sc.burst_every_sec = first, sc.burst_count = second;
+        else if (key == "disconnect")
+            sc.disconnect_every_sec = first;
+        else if (key == "stall")
+            sc.stall_every_sec = first, sc.stall_sec = second;
+        else
+            std::cerr << "\nUnknown scenario option: " << key << "\n";
+    }
+
+    return sc;
+}
+
+
+static const char* g_coins[] = { "BTCUSDT", "ETHUSDT", "SOLUSDT", "BNBUSDT" };
+constexpr uint32_t ALL_COINS = (1u << std::size(g_coins)) - 1;
+
+// coins of a combined-stream URL, all of them for a plain one
+static uint32_t stream_mask(const std::string& uri)
+{
+    size_t pos = uri.find("streams=");
+    if (pos == std::string::npos)
+        return ALL_COINS;
+
+    std::string streams = uri.substr(pos + 8);
+    std::transform(streams.begin(), streams.end(), streams.begin(), [](unsigned char ch) { return static_cast<char>(std::toupper(ch)); });
+
+    uint32_t mask = 0;
+    for (size_t i = 0; i < std::size(g_coins); i++)
+    {
+        if (streams.find(std::string(g_coins[i]) + "@TRADE") != std::string::npos)
+            mask |= 1u << i;
+    }
+    return mask;
+}
+
+// "?key=N" / "&key=N" of a URL, 0 if absent
+static uint32_t uri_param(const std::string& uri, const std::string& key)
+{
+    for (const char* sep : { "?", "&" })
+    {
+        size_t pos = uri.find(sep + key + "=");
+        if (pos != std::string::npos)
+            return static_cast<uint32_t>(std::atoi(uri.c_str() + pos + key.size() + 2));
+    }
+    return 0;
+}
+
+struct MockClient
+{
+    uint32_t mask = ALL_COINS;
+    uint32_t delay_us = 0;
+    uint32_t jitter_us = 0;
+};
+
+
+// Binance futures trade messages of the server's coins, prices in a random walk
+class SyntheticTrades
+{
+public:
+    // returns the coin index
+    size_t Next(std::string& out)
+    {
+        const size_t c = m_cnt % std::size(g_coins);
+        m_price[c] *= 1.0 + (static_cast<int>(m_rng() % 2001) - 1000) * 1e-6;
+        const double qty = static_cast<double>(m_rng() % 100'000) / 1000.0 + 0.001;
+        const uint64_t now_ms = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+
+        char text[256];
+        int len = std::snprintf(text, sizeof(text),
+            R"({"e":"trade","E":%llu,"T":%llu,"s":"%s","t":%llu,"p":"%.2f","q":"%.3f","X":"MARKET","m":%s})",
+            static_cast<unsigned long long>(now_ms), static_cast<unsigned long long>(now_ms), g_coins[c],
+            static_cast<unsigned long long>(++m_cnt), m_price[c], qty, (m_rng() & 1) ? "true" : "false");
+
+        out.assign(text, len);
+        return c;
+    }
+
+private:
+    std::mt19937_64 m_rng{ 42 };
+    double m_price[4] = { 96000.0, 2700.0, 180.0, 600.0 };
+    uint64_t m_cnt{ 0 };
+};
+
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: MockExchange <port> [scenario] [capture]\n";
+        return 1;
+    }
+
+    const int port = std::atoi(argv[1]);
+    MockScenario sc = parse_scenario(argc >= 3 ? argv[2] : "");
+    if (sc.rate == 0 && argc < 4)
+        sc.rate = 1000;     // the recorded pace needs a capture
+
+    try
+    {
+        std::unique_ptr<FeedCaptureReader> capture;
+        if (argc >= 4)
+            capture = std::make_unique<FeedCaptureReader>(argv[3]);
+
+        ix::initNetSystem();
+
+        std::mutex mtx_masks;
+        std::map<ix::WebSocket*, MockClient> masks;     // coins and delay of every connection
+
+        ix::WebSocketServer server(port, "127.0.0.1");
+        server.disablePerMessageDeflate();
+        server.setOnClientMessageCallback(
+            [&](std::shared_ptr<ix::ConnectionState> state, ix::WebSocket& ws, const ix::WebSocketMessagePtr& msg)
+            {
+                if (msg->type == ix::WebSocketMessageType::Open)
+                {
+                    std::cout << "\n[Mock] Connected " << state->getRemoteIp() << " " << msg->openInfo.uri << "\n";
+                    std::lock_guard<std::mutex> lk(mtx_masks);
+                    masks[&ws] = MockClient{ stream_mask(msg->openInfo.uri), uri_param(msg->openInfo.uri, "delay"), uri_param(msg->openInfo.uri, "jitter") };
+                }
+                else if (msg->type == ix::WebSocketMessageType::Close)
+                {
+                    std::lock_guard<std::mutex> lk(mtx_masks);
+                    masks.erase(&ws);
+                }
+                else if (msg->type == ix::WebSocketMessageType::Message)
+                {
+                    ws.send(R"({"result":null,"id":1})");      // subscribe answer
+                }
+            });
+
+        auto res = server.listen();
+        if (!res.first)
+        {
+            std::cerr << "\n[Mock] " << res.second << "\n";
+            return 1;
+        }
+        server.start();
+
+        signal(SIGINT, signal_handler);
+
+        std::cout << "[Mock] ws://127.0.0.1:" << port << "/ws | rate " << sc.rate << " msg/s"
+            << (capture ? " | capture" : " | synthetic") << "\n";
+
+        SyntheticTrades synthetic;
+        FeedCaptureReader::Frame frame;
+        uint64_t capture_prev_tick = 0;
+
+        // returns the coin index of a synthetic trade, -1 for a capture message (sent to everyone)
+        auto next_msg = [&](std::string& out, double& gap_ns) -> int
+        {
+            gap_ns = 0.0;
+            if (!capture)
+                return static_cast<int>(synthetic.Next(out));
+
+            if (!capture->Next(frame))
+            {
+                capture->Rewind();
+                capture_prev_tick = 0;
+                if (!capture->Next(frame))
+                    throw std::runtime_error("empty capture");
+            }
+
+            if (capture_prev_tick != 0 && frame.tick_rcvd > capture_prev_tick)
+                gap_ns = static_cast<double>(frame.tick_rcvd - capture_prev_tick) / capture->GetHeader().tsc_ghz;
+            capture_prev_tick = frame.tick_rcvd;
+            out.assign(frame.payload);
+            return -1;
+        };
+
+        std::set<std::shared_ptr<ix::WebSocket>> clients;
+        std::vector<std::pair<ix::WebSocket*, MockClient>> targets;
+        std::map<ix::WebSocket*, std::deque<std::pair<steady_clock::time_point, std::string>>> delayed;
+        std::mt19937 jitter_rng{ 7 };
+
+        auto broadcast = [&](const std::string& msg, int coin)
+        {
+            const uint32_t bit = (coin < 0) ? ALL_COINS : (1u << coin);
+            for (auto& [ws, client] : targets)
+            {
+                if (!(client.mask & bit))
+                    continue;
+
+                if (client.delay_us == 0 && client.jitter_us == 0)
+                {
+                    ws->send(msg);
+                    continue;
+                }
+
+                auto& q = delayed[ws];
+                auto due = steady_clock::now() + std::chrono::microseconds(client.delay_us + (client.jitter_us ? jitter_rng() % client.jitter_us : 0));
+                if (!q.empty() && due < q.back().first)
+                    due = q.back().first;       // a connection stays in order
+                q.emplace_back(due, msg);
+            }
+        };
+
+        // the held-back messages that are due, queues of closed connections are dropped
+        auto flush_delayed = [&](steady_clock::time_point now)
+        {
+            for (auto it = delayed.begin(); it != delayed.end(); )
+            {
+                auto target = std::find_if(targets.begin(), targets.end(), [&](const auto& t) { return t.first == it->first; });
+                if (target == targets.end())
+                {
+                    it = delayed.erase(it);
+                    continue;
+                }
+
+                auto& q = it->second;
+                while (!q.empty() && q.front().first <= now)
+                {
+                    it->first->send(q.front().second);
+                    q.pop_front();
+                }
+                ++it;
+            }
+        };
+
+        const auto start = steady_clock::now();
+        auto next_send = start;
+        auto last_report = start;
+        uint32_t last_burst = 0, last_disconnect = 0, last_stall = 0;
+        uint64_t sent = 0, sent_report = 0;
+        steady_clock::time_point stall_until{};
+        std::string msg;
+        double gap_ns = 0.0;
+
+        while (g_running)
+        {
+            const auto now = steady_clock::now();
+            clients = server.getClients();
+            targets.clear();
+            {
+                std::lock_guard<std::mutex> lk(mtx_masks);
+                for (auto& client : clients)
+                {
+                    auto it = masks.find(client.get());
+                    targets.emplace_back(client.get(), (it != masks.end()) ? it->second : MockClient{});
+                }
+            }
+            const uint32_t sec = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(now - start).count());
+
+            if (sc.disconnect_every_sec && sec / sc.disconnect_every_sec > last_disconnect)
+            {
+                last_disconnect = sec / sc.disconnect_every_sec;
+                std::cout << "\n[Mock] Disconnect\n";
+                for (auto& client : clients)
+                    client->close();
+            }
+
+            if (sc.stall_every_sec && sec / sc.stall_every_sec > last_stall)
+            {
+                last_stall = sec / sc.stall_every_sec;
+                stall_until = now + std::chrono::seconds(sc.stall_sec);
+                std::cout << "\n[Mock] Stall " << sc.stall_sec << " s\n";
+            }
+
+            flush_delayed(now);
+
+            if (now < stall_until)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                next_send = steady_clock::now();
+                continue;
+            }
+
+            if (sc.burst_every_sec && sec / sc.burst_every_sec > last_burst)
+            {
+                last_burst = sec / sc.burst_every_sec;
+                for (uint32_t i = 0; i < sc.burst_count; i++)
+                {
+                    int coin = next_msg(msg, gap_ns);
+                    broadcast(msg, coin);
+                }
+                sent += sc.burst_count;
+            }
+
+            // steady stream: everything due by now (the capture's own pace with rate 0)
+            while (next_send <= now)
+            {
+                int coin = next_msg(msg, gap_ns);
+                broadcast(msg, coin);
+                sent++;
+
+                if (sc.rate > 0)
+                    next_send += std::chrono::nanoseconds(1'000'000'000 / sc.rate);
+                else
+                    next_send += std::chrono::nanoseconds(static_cast<int64_t>(gap_ns));
+            }
+
+            if (now - last_report >= std::chrono::seconds(5))
+            {
+                const double secs = std::chrono::duration<double>(now - last_report).count();
+                std::cout << "[Mock] " << clients.size() << " clients | " << static_cast<uint64_t>((sent - sent_report) / secs) << " msg/s\n";
+                last_report = now;
+                sent_report = sent;
+            }
+
+            auto wake = std::min(next_send, now + std::chrono::milliseconds(1));
+            for (auto& [ws, q] : delayed)
+            {
+                if (!q.empty())
+                    wake = std::min(wake, q.front().first);
+            }
+            std::this_thread::sleep_until(wake);
+        }
+
+        server.stop();
+    }
+    catch (std::exception& ex)
+    {
+        std::cerr << "\n" << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
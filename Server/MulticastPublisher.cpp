@@ -0,0 +1,156 @@
+// MulticastPublisher.cpp
+
+#include "MulticastPublisher.h"
+#include <cstring>
+#include <algorithm>
+#include <random>
+
+namespace asio = boost::asio;
+using udp = asio::ip::udp;
+using error_code = boost::system::error_code;
+using steady_clock = std::chrono::steady_clock;
+
+
+MulticastPublisher::MulticastPublisher(asio::io_context& io, const std::string& group, uint16_t port, const std::string& iface)
+    : m_socket(io)
+    , m_endpoint(asio::ip::make_address(group), port)
+{
+    m_socket.open(m_endpoint.protocol());
+    m_socket.set_option(asio::ip::multicast::enable_loopback(true));     // co-located listeners
+    m_socket.set_option(asio::ip::multicast::hops(1));
+
+    if (!iface.empty())
+        m_socket.set_option(asio::ip::multicast::outbound_interface(asio::ip::make_address_v4(iface)));
+
+    // event_dispatcher must never block on the socket: a dropped datagram is recovered by retransmit
+    m_socket.non_blocking(true);
+
+    m_ring = std::make_unique<RingSlot[]>(MCAST_RETRANSMIT_DATAGRAMS);
+
+    // receivers tell a restarted publisher (numbering from 1 again) by its epoch
+    std::random_device rd;
+    while (m_epoch == 0)
+        m_epoch = static_cast<uint16_t>(rd());
+
+    m_time_last_send = steady_clock::now();
+}
+
+void MulticastPublisher::Add(const WhaleEvent& we)
+{
+    SWhaleRecordV2 r{};
+    r.price = we.price;
+    r.quantity = we.quantity;
+    r.timestamp = we.timestamp;
+    r.vwap_sess = we.vwap_sess;
+    r.vwap_roll50 = we.vwap_roll50;
+    r.delta_roll = we.delta_roll;
+    r.symbol = static_cast<uint32_t>(we.index_symbol);
+    r.is_sell = static_cast<uint8_t>(we.is_sell);
+    r.seq = we.seq;
+
+    std::memcpy(m_pending.data() + sizeof(SMcastHeader) + m_pending_cnt * sizeof(r), &r, sizeof(r));
+
+    if (++m_pending_cnt == MCAST_MAX_RECORDS)
+        Flush();
+}
+
+void MulticastPublisher::Flush()
+{
+    if (m_pending_cnt == 0)
+        return;
+
+    const uint64_t seq = m_next_seq.load(std::memory_order_relaxed);
+
+    SMcastHeader hdr{};
+    hdr.signature = PROTOCOL_HEADER_SIGNATURE;
+    hdr.version = PROTOCOL_VERSION_2;
+    hdr.data_type = MSG_DATA;
+    hdr.count = m_pending_cnt;
+    hdr.epoch = m_epoch;
+    hdr.seq = seq;
+    std::memcpy(m_pending.data(), &hdr, sizeof(hdr));
+
+    const size_t size = sizeof(hdr) + m_pending_cnt * sizeof(SWhaleRecordV2);
+    m_pending_cnt = 0;
+
+    // kept for retransmit before it is sent: a receiver may ask for it as soon as it sees the next one
+    RingSlot& slot = m_ring[seq % MCAST_RETRANSMIT_DATAGRAMS];
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (size_t i = 0; i < (size + 7) / 8; i++)
+    {
+        uint64_t w;
+        std::memcpy(&w, m_pending.data() + i * 8, 8);
+        slot.words[i].store(w, std::memory_order_relaxed);
+    }
+    slot.size.store(static_cast<uint32_t>(size), std::memory_order_relaxed);
+    slot.seq.store(seq, std::memory_order_release);
+    m_next_seq.store(seq + 1, std::memory_order_release);
+
+    send(m_pending.data(), size);
+}
+
+void MulticastPublisher::Heartbeat()
+{
+    auto now = steady_clock::now();
+    if (now - m_time_last_send < std::chrono::milliseconds(MCAST_HEARTBEAT_MS))
+        return;
+
+    SMcastHeader hdr{};
+    hdr.signature = PROTOCOL_HEADER_SIGNATURE;
+    hdr.version = PROTOCOL_VERSION_2;
+    hdr.data_type = MSG_ALIVE;
+    hdr.count = 0;
+    hdr.epoch = m_epoch;
+    hdr.seq = m_next_seq.load(std::memory_order_relaxed);
+
+    send(reinterpret_cast<const uint8_t*>(&hdr), sizeof(hdr));
+}
+
+uint64_t MulticastPublisher::Retransmit(uint64_t from_seq, uint32_t count, std::vector<uint8_t>& out)
+{
+    const uint64_t next = m_next_seq.load(std::memory_order_acquire);
+    uint64_t first = (next > MCAST_RETRANSMIT_DATAGRAMS) ? next - MCAST_RETRANSMIT_DATAGRAMS : 1;
+
+    count = (std::min)(count, MCAST_RETRANSMIT_MAX);
+    const uint64_t end = (std::min)(from_seq + count, next);
+
+    for (uint64_t seq = (std::max)(from_seq, first); seq < end; seq++)
+    {
+        const RingSlot& slot = m_ring[seq % MCAST_RETRANSMIT_DATAGRAMS];
+        const size_t pos = out.size();
+
+        if (slot.seq.load(std::memory_order_acquire) == seq)
+        {
+            const size_t size = slot.size.load(std::memory_order_relaxed);
+            out.resize(pos + (size + 7) / 8 * 8);
+            for (size_t i = 0; i < (size + 7) / 8; i++)
+            {
+                const uint64_t w = slot.words[i].load(std::memory_order_relaxed);
+                std::memcpy(out.data() + pos + i * 8, &w, 8);
+            }
+            out.resize(pos + size);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == seq)
+                continue;
+        }
+
+        // lapped by Flush() (before or during the copy): lost, like everything older
+        out.resize(pos);
+        first = seq + 1;
+    }
+
+    return first;
+}
+
+void MulticastPublisher::send(const uint8_t* data, size_t size)
+{
+    error_code ec;
+    m_socket.send_to(asio::buffer(data, size), m_endpoint, 0, ec);
+    if (ec)
+        m_cnt_send_error.fetch_add(1, std::memory_order_relaxed);
+
+    m_time_last_send = steady_clock::now();
+}
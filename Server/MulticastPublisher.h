@@ -0,0 +1,71 @@
+#pragma once
+
+#include "WhaleEvent.h"
+#include <Protocol.h>
+#include <boost/asio.hpp>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+
+constexpr size_t MCAST_RETRANSMIT_DATAGRAMS = 4096;     // sent datagrams kept for TCP recovery (~6 MB)
+constexpr uint32_t MCAST_HEARTBEAT_MS = 100;
+
+
+// Whale events over UDP multicast: sequence-numbered, MTU-sized v2 datagrams, one send per datagram
+// whatever the number of listeners. Add/Flush/Heartbeat are called by Server::event_dispatcher only;
+// Retransmit() by the session strands: the ring slots are seqlocks, Flush() never waits for a copy.
+class MulticastPublisher
+{
+public:
+    // 'iface' - local address of the outbound interface (empty - system default)
+    MulticastPublisher(boost::asio::io_context& io, const std::string& group, uint16_t port, const std::string& iface);
+
+    // disable copying
+    MulticastPublisher(const MulticastPublisher&) = delete;
+    MulticastPublisher& operator=(const MulticastPublisher&) = delete;
+
+    void Add(const WhaleEvent& we);
+    void Flush();
+    // sends a heartbeat if nothing was sent for MCAST_HEARTBEAT_MS
+    void Heartbeat();
+
+    // appends the datagrams [from_seq, from_seq + count) still in the ring to 'out', returns the oldest seq available
+    uint64_t Retransmit(uint64_t from_seq, uint32_t count, std::vector<uint8_t>& out);
+
+    uint64_t GetNextSeq() const { return m_next_seq.load(std::memory_order_acquire); }
+    uint16_t GetEpoch() const { return m_epoch; }
+    uint64_t GetSendErrors() const { return m_cnt_send_error.load(std::memory_order_relaxed); }
+
+private:
+    void send(const uint8_t* data, size_t size);
+
+private:
+    boost::asio::ip::udp::socket m_socket;
+    boost::asio::ip::udp::endpoint m_endpoint;
+
+    // datagram being filled
+    std::array<uint8_t, MCAST_MAX_DATAGRAM> m_pending;
+    uint16_t m_pending_cnt{ 0 };
+
+    // a sent datagram in relaxed atomic words: a copy torn by the writer is detected by the seq check
+    struct RingSlot
+    {
+        std::atomic<uint64_t> seq{ 0 };     // datagram held, 0 - being written
+        std::atomic<uint32_t> size{ 0 };
+        std::atomic<uint64_t> words[MCAST_MAX_DATAGRAM / 8];
+    };
+    static_assert(MCAST_MAX_DATAGRAM % 8 == 0, "datagram must be whole words");
+
+    // sent datagrams [seq % MCAST_RETRANSMIT_DATAGRAMS]
+    std::unique_ptr<RingSlot[]> m_ring;
+    std::atomic<uint64_t> m_next_seq{ 1 };
+    uint16_t m_epoch{ 0 };
+
+    std::chrono::steady_clock::time_point m_time_last_send;
+    std::atomic<uint64_t> m_cnt_send_error{ 0 };
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+
+// Single-writer seqlock: Store() never waits, readers retry while a store is in progress.
+// The value is kept in relaxed atomic words, so a torn read is detected by the sequence check
+// and is never a data race.
+template<typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable_v<T>, "SeqLock value must be trivially copyable");
+
+    static constexpr size_t WORDS = (sizeof(T) + 7) / 8;
+
+public:
+    SeqLock()
+    {
+        for (auto& w : m_words)
+            w.store(0, std::memory_order_relaxed);
+    }
+
+    // disable copying
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    // writer (one thread)
+    void Store(const T& value)
+    {
+        uint64_t buf[WORDS] = {};
+        std::memcpy(buf, &value, sizeof(T));
+
+        const uint64_t seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1, std::memory_order_relaxed);        // odd: store in progress
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < WORDS; i++)
+            m_words[i].store(buf[i], std::memory_order_relaxed);
+
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // any thread; false if a store was in progress (the caller may retry)
+    bool TryLoad(T& out) const
+    {
+        const uint64_t seq1 = m_seq.load(std::memory_order_acquire);
+        if (seq1 & 1)
+            return false;
+
+        uint64_t buf[WORDS];
+        for (size_t i = 0; i < WORDS; i++)
+            buf[i] = m_words[i].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_seq.load(std::memory_order_relaxed) != seq1)
+            return false;
+
+        std::memcpy(&out, buf, sizeof(T));
+        return true;
+    }
+
+    T Load() const
+    {
+        T value;
+        while (!TryLoad(value))
+        {
+        }
+        return value;
+    }
+
+    // number of completed stores
+    uint64_t Version() const { return m_seq.load(std::memory_order_acquire) / 2; }
+
+private:
+    alignas(64) std::atomic<uint64_t> m_seq{ 0 };
+    std::atomic<uint64_t> m_words[WORDS];
+};
@@ -4,6 +4,8 @@
 #include "Session.h"
 #include <iostream>
 #include <chrono>
+#include <algorithm>
+#include <cctype>
 #include <Utils.h>
 
 #ifndef _WIN32
@@ -113,12 +115,19 @@ void Server::set_cpu_ghz()
     m_cpu_ghz = (double)(r2 - r1) / (double)duration_ns;
 }
 
-Server::Server(asio::io_context& io, uint16_t port)
-    : m_io(io), m_acceptor(io, tcp::endpoint(tcp::v4(), port), true/*false*/)
+Server::Server(asio::io_context& io, uint16_t port, uint32_t io_threads, int io_first_core)
+    : m_io(io), m_acceptor(io), m_whale_history(COIN_CNT), m_trade_ids(COIN_CNT)
 {
+    if (io_threads > 0)
+        m_io_pool = std::make_unique<IoPool>(io_threads, io_first_core);
+
+    // in the SO_REUSEPORT group of the I/O threads' listeners
+    IoPool::OpenAcceptor(m_acceptor, port, m_io_pool != nullptr);
+
     init_coin_data();
     register_coins();
     set_cpu_ghz();
+    m_tsc_clock.Start(m_cpu_ghz);
 }
 
 Server::~Server() 
@@ -134,30 +143,58 @@ void Server::Start()
 #endif
 
 
+    if (!m_data_emulation.load(std::memory_order_acquire))
+        InitFeedShards();
+
+    if (m_backfill)
+    {
+        m_hot_push_shared = true;       // the backfill worker is one more producer
+        m_backfill->Start();
+    }
+
     m_session_dispatcher = std::thread(&Server::session_dispatcher, this);
     m_hot_dispatcher = std::thread(&Server::hot_dispatcher, this);
     m_event_dispatcher = std::thread(&Server::event_dispatcher, this);
     m_monitor = std::thread(&Server::speed_monitor, this);
     m_producer = std::thread(&Server::producer, this);
 
-   
+
+    if (m_io_pool)
+    {
+        m_io_pool->Start(m_acceptor.local_endpoint().port(), [this](tcp::socket socket) { start_session(std::move(socket)); });
+
+        if (m_show_log_msg)
+            std::cout << "I/O threads: " << m_io_pool->Size() << (IoPool::HasReusePort() ? " (SO_REUSEPORT)" : "") << "\n";
+    }
+
     do_accept();
 
     if (m_show_log_msg)
         std::cout << "Server started\n";
 }
 
+void Server::start_session(tcp::socket socket)
+{
+    if (m_show_log_msg)
+        std::cout << "\nAccepted connection\n";
+
+    auto s = std::make_shared<Session>(std::move(socket), *this);
+    s->Start();
+}
+
 void Server::do_accept() 
 {
-    m_acceptor.async_accept([this](error_code ec, tcp::socket socket) 
+    // with I/O threads the connections of this acceptor are handed out round-robin
+    asio::io_context& io = m_io_pool ? m_io_pool->Next() : m_io;
+
+    m_acceptor.async_accept(io, [this, &io](error_code ec, tcp::socket socket) 
         {
             if (!ec) 
             {
-                if (m_show_log_msg)
-                    std::cout << "\nAccepted connection\n";
+                if (m_io_pool)
+                    m_io_pool->CountAccepted(io);
 
-                auto s = std::make_shared<Session>(std::move(socket), *this);
-                s->Start();
+                start_session(std::move(socket));
 
                 do_accept();
             }
@@ -200,11 +237,21 @@ void Server::Stop()
         m_acceptor.close(ec);
     }
 
+    if (m_io_pool)
+    {
+        m_io_pool->CloseListeners();
+    }
+
     if (m_producer.joinable())
     {
         m_producer.join();
     }
 
+    if (m_backfill)
+    {
+        m_backfill->Stop();
+    }
+
     if (m_session_dispatcher.joinable())
     {
         m_session_dispatcher.join();
@@ -228,6 +275,12 @@ void Server::Stop()
     clear_sessions(); 
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
+    // sessions left on the I/O threads are destroyed here, while the frame pools are alive
+    if (m_io_pool)
+    {
+        m_io_pool->Stop();
+    }
+
 }
 
 
@@ -236,33 +289,140 @@ void Server::RegisterSession(std::shared_ptr<Session> s)
     {
         std::lock_guard<std::mutex> lk(m_mtx_subscribers);
 
+        // stopping: clear_sessions() has run or is about to
+        if (!m_running)
+            return;
+
         m_subscribers.push_back(s);
+
+        // set under the lock: event_dispatcher relies on it before patching routes incrementally
+        m_need_update_clients.store(true, std::memory_order_release);
     }
+}
 
-    m_need_update_clients.store(true, std::memory_order_release);
+void Server::UnregisterExpired() 
+{
+    std::lock_guard<std::mutex> lk(m_mtx_subscribers);
 
+    size_t removed_count = std::erase_if(m_subscribers, [](const auto& s) {
+        return s->Expired();
+        });
+
+    if (removed_count > 0) 
+    {
+        m_need_update_clients.store(true, std::memory_order_release);
+    }
 }
 
-void Server::UnregisterExpired() 
+bool Server::UpdateSubscriptions(Session* session, const std::vector<RouteUpdate>& updates)
 {
-    bool is_changed = false;
+    std::lock_guard<std::mutex> lk(m_mtx_subscribers);
+
+    // only registered sessions are routed (event_dispatcher keeps them alive)
+    auto it = std::find_if(m_subscribers.begin(), m_subscribers.end(), [session](const auto& s) {
+        return s.get() == session;
+        });
 
+    if (it == m_subscribers.end())
+        return false;
+
+    for (const auto& u : updates)
     {
-        std::lock_guard<std::mutex> lk(m_mtx_subscribers);
+        if (u.remove)
+            session->RemoveSubscription(u.ind_symbol);
+        else
+            session->SetSubscription(u.ind_symbol, u.treshold);
 
-        size_t removed_count = std::erase_if(m_subscribers, [](const auto& s) {
-            return s->Expired();
-            });
+        m_route_updates.push_back(u);
+    }
+
+    m_need_apply_routes.store(true, std::memory_order_release);
+
+    return true;
+}
 
-        if (removed_count > 0) {
-            is_changed = true;
+void RouteTable::Rebuild(const std::vector<std::shared_ptr<Session>>& sessions)
+{
+    const size_t rsrv_cnt = sessions.size() + 10;
+
+    for (auto& clients : m_rows)
+    {
+        clients.clear();
+        if (clients.capacity() < rsrv_cnt)
+            clients.reserve(rsrv_cnt);
+    }
+    m_vwap.clear();
+
+    for (const auto& sp : sessions)
+    {
+        // one route per subscribed coin: a single session can carry a whole portfolio
+        Session* pSession = sp.get();
+        VwapRoute* vwap = nullptr;
+        if (pSession->WantsVwap())
+            vwap = &m_vwap.emplace_back(VwapRoute{ pSession, {} });
+
+        for (const auto& sub : pSession->GetSubscriptions())
+        {
+            if (sub.ind_symbol < 0 || static_cast<size_t>(sub.ind_symbol) >= m_rows.size())
+                continue;
+
+            if (pSession->WantsWhales())
+                m_rows[sub.ind_symbol].push_back({ pSession, sub.treshold, pSession->GetProtocolVersion(), pSession->GetEncoding() });
+
+            if (vwap)
+                vwap->coins.push_back(sub.ind_symbol);
         }
+
+        if (vwap)
+            std::sort(vwap->coins.begin(), vwap->coins.end());
     }
 
-    if (is_changed)
+    // sessions with equal protocol version, encoding & treshold get the same encoded segment
+    for (auto& clients : m_rows)
+        std::sort(clients.begin(), clients.end(), route_less);
+}
+
+void RouteTable::Apply(const RouteUpdate& u)
+{
+    if (u.ind_symbol < 0 || static_cast<size_t>(u.ind_symbol) >= m_rows.size())
+        return;
+
+    if (u.session->WantsVwap())
     {
-        m_need_update_clients.store(true, std::memory_order_release);
+        auto vwap = std::find_if(m_vwap.begin(), m_vwap.end(), [&u](const VwapRoute& r) {
+            return r.session == u.session;
+            });
+        if (vwap == m_vwap.end())
+            vwap = m_vwap.insert(m_vwap.end(), VwapRoute{ u.session, {} });
+
+        auto& coins = vwap->coins;
+        auto pos = std::lower_bound(coins.begin(), coins.end(), u.ind_symbol);
+        const bool found = (pos != coins.end() && *pos == u.ind_symbol);
+
+        if (u.remove && found)
+            coins.erase(pos);
+        else if (!u.remove && !found)
+            coins.insert(pos, u.ind_symbol);
     }
+
+    if (!u.session->WantsWhales())
+        return;
+
+    auto& clients = m_rows[u.ind_symbol];
+
+    auto it = std::find_if(clients.begin(), clients.end(), [&u](const SessionRoute& r) {
+        return r.session == u.session;
+        });
+
+    if (it != clients.end())
+        clients.erase(it);
+
+    if (u.remove)
+        return;
+
+    // keep the row sorted, groups stay contiguous
+    SessionRoute route{ u.session, u.treshold, u.session->GetProtocolVersion(), u.session->GetEncoding() };
+    clients.insert(std::upper_bound(clients.begin(), clients.end(), route, route_less), route);
 }
 
 
@@ -323,11 +483,28 @@ void Server::init_coin_data()
 
 void Server::register_coins()
 {
+    m_symbol_wire.resize(COIN_CNT);
+
     for (int i = 0; i < COIN_CNT; i++)
     {
         m_reg_coin.register_coin(coins[i].symbol, i);
+        m_symbol_wire[i].Set(coins[i].symbol);
     }
 
+    // v2 dictionary is immutable: encoded once, the server keeps one reference for its lifetime
+    m_symbol_dict_v2 = m_segment_pool.Acquire(SymbolDictV2MaxSize(COIN_CNT));
+    m_symbol_dict_v2->size = EncodeSymbolDictV2(m_symbol_dict_v2->data(), m_symbol_wire.data(), m_symbol_wire.size());
+    m_symbol_dict_v2->count = static_cast<uint32_t>(COIN_CNT);
+    m_symbol_dict_v2->version = PROTOCOL_VERSION_2;
+    m_symbol_dict_v2->data_type = MSG_SYMBOL_DICT;
+
+    m_coin_snapshot = std::make_unique<SeqLock<CoinSnapshot>[]>(COIN_CNT);
+    for (size_t i = 0; i < COIN_CNT; i++)
+    {
+        CoinSnapshot snap{};
+        snap.index_symbol = static_cast<int32_t>(i);
+        m_coin_snapshot[i].Store(snap);
+    }
 }
 
 std::string Server::GetCoinSymbol(int index) const
@@ -343,6 +520,153 @@ int Server::GetCoinIndex(std::string& symbol) const
     return m_reg_coin.get_index_coin(symbol.data());
 }
 
+size_t Server::GetCoinCount() const
+{
+    return COIN_CNT;
+}
+
+bool Server::EnableMulticast(const std::string& group, uint16_t port, const std::string& iface)
+{
+    try
+    {
+        m_mcast = std::make_unique<MulticastPublisher>(m_io, group, port, iface);
+    }
+    catch (std::exception& ex)
+    {
+        std::cerr << "\nMulticast " << group << ":" << port << " disabled: " << ex.what() << "\n";
+        m_mcast.reset();
+        return false;
+    }
+
+    if (m_show_log_msg)
+        std::cout << "Multicast whales to " << group << ":" << port << "\n";
+
+    return true;
+}
+
+bool Server::EnableFeedRecord(const std::string& path)
+{
+    m_feed_recorder = std::make_unique<FeedRecorder>();
+
+    if (!m_feed_recorder->Open(path, m_cpu_ghz, rdtsc()))
+    {
+        std::cerr << "\nFeed capture " << path << " disabled: cannot create the file\n";
+        m_feed_recorder.reset();
+        return false;
+    }
+
+    if (m_show_log_msg)
+        std::cout << "Feed capture " << path << "\n";
+
+    return true;
+}
+
+bool Server::EnableShm(const std::string& name, bool market_events)
+{
+    std::vector<std::string> symbols;
+    symbols.reserve(COIN_CNT);
+    for (size_t i = 0; i < COIN_CNT; i++)
+        symbols.emplace_back(coins[i].symbol);
+
+    try
+    {
+        m_shm_whales = std::make_unique<ShmWriter<SWhaleRecordV2>>(name + ".whales");
+        m_shm_whales->SetSymbols(symbols);
+
+        if (market_events)
+        {
+            m_shm_market = std::make_unique<ShmWriter<SMarketRecord>>(name + ".market", SHM_DEFAULT_CAPACITY * 16);
+            m_shm_market->SetSymbols(symbols);
+        }
+    }
+    catch (std::exception& ex)
+    {
+        std::cerr << "\nShared memory " << name << " disabled: " << ex.what() << "\n";
+        m_shm_whales.reset();
+        m_shm_market.reset();
+        return false;
+    }
+
+    if (m_show_log_msg)
+        std::cout << "Shared memory channel " << name << (market_events ? " (whales + market)" : " (whales)") << "\n";
+
+    return true;
+}
+
+Frame* Server::MakeRetransmitFrame(uint64_t from_seq, uint32_t count)
+{
+    if (!m_mcast)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lk(m_mtx_retransmit);
+
+    m_retransmit_buf.clear();
+    uint64_t first = m_mcast->Retransmit(from_seq, count, m_retransmit_buf);
+
+    Frame* frame = m_segment_pool.Acquire(8 + m_retransmit_buf.size());
+    frame->version = PROTOCOL_VERSION_2;
+    frame->data_type = MSG_RETRANSMIT_DATA;
+
+    std::memcpy(frame->data(), &first, 8);
+    if (!m_retransmit_buf.empty())
+        std::memcpy(frame->data() + 8, m_retransmit_buf.data(), m_retransmit_buf.size());
+    frame->size = 8 + m_retransmit_buf.size();
+
+    return frame;
+}
+
+bool Server::GetCoinSnapshot(int index, CoinSnapshot& out) const
+{
+    if (index < 0 || static_cast<size_t>(index) >= COIN_CNT || !m_coin_snapshot)
+        return false;
+
+    out = m_coin_snapshot[index].Load();
+    return true;
+}
+
+Frame* Server::MakeSnapshotFrame(const std::vector<int>& coins, uint8_t version, uint8_t data_type, uint32_t request_id)
+{
+    std::vector<CoinSnapshot> snaps;
+    snaps.reserve(coins.size());
+
+    return MakeSnapshotFrame(coins, snaps, version, data_type, request_id);
+}
+
+Frame* Server::MakeSnapshotFrame(const std::vector<int>& coins, std::vector<CoinSnapshot>& snaps, uint8_t version, uint8_t data_type, uint32_t request_id)
+{
+    snaps.clear();
+    for (int ind : coins)
+    {
+        CoinSnapshot snap;
+        if (GetCoinSnapshot(ind, snap))
+            snaps.push_back(snap);
+    }
+
+    Frame* frame = m_segment_pool.Acquire(SnapshotMaxSize(snaps.size()));
+    frame->version = version;
+    frame->data_type = data_type;
+    frame->count = static_cast<uint32_t>(snaps.size());
+
+    uint8_t* p = frame->data();
+    if (data_type == MSG_QUERY_RESULT)
+    {
+        if (version == PROTOCOL_VERSION_1)
+            put_u32_be(p, request_id);
+        else
+            std::memcpy(p, &request_id, 4);
+        p += 4;
+    }
+
+    if (version == PROTOCOL_VERSION_1)
+        p += EncodeSnapshotV1(p, snaps.data(), snaps.size(), m_symbol_wire.data(), m_symbol_wire.size());
+    else
+        p += EncodeSnapshotV2(p, snaps.data(), snaps.size());
+
+    frame->size = p - frame->data();
+
+    return frame;
+}
+
 void Server::producer()
 {
 
@@ -444,6 +768,7 @@ void Server::emulator_loop()
 
 
                     ev.index_symbol = ind;
+                    ev.trade_id = 0;
 
                     ev.timestamp = batch_ts;
 
@@ -463,6 +788,7 @@ void Server::emulator_loop()
                     ev.is_sell = ((i & 1) == 0); //(i % 2 == 0)
 
                     ev.tick_rcvd = tick_batch;
+                    ev.tick_parsed = tick_batch;
 
                     cnt++;
 
@@ -492,6 +818,76 @@ void Server::emulator_loop()
     }
 }
 
+void Server::append_session_stats(std::stringstream& ss)
+{
+    // slow consumers: whales dropped by the sessions' policies and the largest send backlog
+    uint64_t dropped = 0;
+    size_t max_lag = 0;
+    TxLatency tx_all;               // delivery -> kernel transmit, all sessions
+    uint64_t tx_worst_p99 = 0;      // slowest session
+
+    {
+        std::lock_guard<std::mutex> lk(m_mtx_subscribers);
+
+        for (const auto& s : m_subscribers)
+        {
+            dropped += s->GetDroppedCount();
+            max_lag = (std::max)(max_lag, s->GetLagBytes());
+
+            TxLatency& tx = s->GetTxLatency();
+            if (tx.count.load(std::memory_order_relaxed) > 0)
+            {
+                tx_worst_p99 = (std::max)(tx_worst_p99, tx.Percentile(0.99));
+                tx_all.Merge(tx);
+                tx.Reset();
+            }
+        }
+    }
+
+    if (dropped > 0 || max_lag > 0)
+        ss << " | Dropped: " << dropped << " Lag: " << max_lag / 1024 << " KB";
+
+    // delivery latency (received -> written to the socket) per path, since the last report
+    auto append_latency = [this, &ss](const char* name, DeliveryLatency& lat)
+        {
+            uint64_t c = lat.count.load(std::memory_order_relaxed);
+            if (c == 0)
+                return;
+
+            double tsc_to_us = 1.0 / (m_cpu_ghz * 1000.0);
+            double avg_us = lat.total_ticks.load(std::memory_order_relaxed) / static_cast<double>(c) * tsc_to_us;
+
+            ss << std::fixed << std::setprecision(1) << " | " << name << ": avg " << avg_us << " P99 " << lat.Percentile(0.99) * tsc_to_us << " us";
+            lat.Reset();
+        };
+
+    append_latency("Deliver", m_latency_normal);
+    append_latency("Express", m_latency_express);
+
+    if (tx_all.count.load(std::memory_order_relaxed) > 0)
+    {
+        ss << std::fixed << std::setprecision(1) << " | TX: P50 " << tx_all.Percentile(0.5) / 1000.0 << " P99 " << tx_all.Percentile(0.99) / 1000.0
+            << " worst P99 " << tx_worst_p99 / 1000.0 << " us";
+    }
+
+    if (m_mcast)
+    {
+        ss << " | Mcast seq: " << m_mcast->GetNextSeq() - 1;
+        if (m_mcast->GetSendErrors() > 0)
+            ss << " send errors: " << m_mcast->GetSendErrors();
+    }
+
+    if (m_shm_whales)
+        ss << " | Shm seq: " << m_shm_whales->GetWriteSeq();
+
+    if (m_io_pool && m_io_pool->Size() > 1)
+    {
+        ss << " | IO:";
+        for (size_t i = 0; i < m_io_pool->Size(); i++)
+            ss << (i ? "/" : " ") << m_io_pool->GetAccepted(i);
+    }
+}
+
 void Server::speed_monitor()
 {
 
@@ -512,6 +908,8 @@ void Server::speed_monitor()
         std::this_thread::sleep_for(std::chrono::seconds(1));
         cnt++;
 
+        m_tsc_clock.Update();
+
         uint64_t current_head = m_hot_buffer.get_head();
         auto current_time = std::chrono::steady_clock::now();
 
@@ -531,6 +929,10 @@ void Server::speed_monitor()
             std::stringstream ss;
             ss << std::fixed << std::setprecision(2) << eps << mul << " event/sec | " << "Total: " << current_head << " events";
 
+            append_feed_stats(ss);
+            append_feed_latency(ss);
+            append_session_stats(ss);
+
             std::cout << "\r" << "Throughput: " << std::left << std::setw(100) << ss.view() << std::flush;
         }
         else
@@ -618,6 +1020,8 @@ void Server::speed_monitor()
                 }
             }
 
+            append_session_stats(ss);
+
             std::cout << "\r" << "Throughput: " << std::left << std::setw(140) << ss.view() << std::flush;
         }
 
@@ -642,198 +1046,494 @@ void Server::clear_sessions()
         }
 
         m_subscribers.clear();
-    }
 
-    m_need_update_clients.store(true, std::memory_order_release);
+        m_need_update_clients.store(true, std::memory_order_release);
+    }
 
 }
 
-inline void Server::parse_single_event(simdjson::dom::element item) 
+inline void Server::push_trade(const TradeFields& trade, uint64_t tick_rcvd, std::vector<MarketEvent>& batch)
 {
     MarketEvent event;
+    event.tick_rcvd = tick_rcvd;
+    event.timestamp = trade.timestamp;
+    event.trade_id = trade.trade_id;
 
-   
-    std::string_view s;
-    if (item["s"].get(s) == simdjson::error_code::SUCCESS) // 's' - it's deal
-    {
-        // Timestamp
-        event.timestamp = item["E"].get_uint64();
+    event.index_symbol = m_reg_coin.get_index_coin(trade.symbol);
 
-        event.index_symbol = m_reg_coin.get_index_coin(s.data());
+    if (event.index_symbol != -1)
+    {
+        event.price = trade.price;
+        event.quantity = trade.quantity;
+        event.is_sell = trade.is_sell;
 
-        if (event.index_symbol != -1)
+        if (event.timestamp > 0)
         {
-            // Price & Quantity
-            std::string_view p_str = item["p"].get_string();
-            std::from_chars(p_str.data(), p_str.data() + p_str.size(), event.price);
+            batch.push_back(event);
+        }
+    }
+    else
+    {
+        ////  ooops.. unregistered coin..
+    }
+}
 
-            std::string_view q_str = item["q"].get_string();
-            std::from_chars(q_str.data(), q_str.data() + q_str.size(), event.quantity);
+size_t Server::ProcessMarketMsg(std::string_view payload, size_t capacity, uint64_t tick_rcvd, FeedShard* shard)
+{
+    static thread_local TradeParser parser;
+    static thread_local std::vector<MarketEvent> batch;
 
-            // Side
-            event.is_sell = item["m"].get_bool();
+    batch.clear();
+    size_t cnt = parser.Parse(payload, capacity, [&](const TradeFields& trade) { push_trade(trade, tick_rcvd, batch); });
 
-            uint64_t trade_id = item["t"].get_uint64();
+    const uint64_t tick_parsed = rdtsc();
+    for (auto& ev : batch)
+        ev.tick_parsed = tick_parsed;
 
+    if (shard && m_feed_lines > 1)
+        arbitrate(*shard, batch);
 
-            if (event.timestamp > 0)
-            {
-                m_hot_buffer.push_batch(&event, 1);
-            }
+    if (!batch.empty())
+        push_hot(batch);
+
+    return cnt;
+}
+
+void Server::arbitrate(FeedShard& shard, std::vector<MarketEvent>& batch)
+{
+    // the lines race: a trade another line delivered first is dropped here, before the hot buffer
+    uint64_t behind_ticks = 0, copies = 0;
+    size_t kept = 0;
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        const MarketEvent& ev = batch[i];
+        uint64_t behind = 0;
+        if (m_feed_arbiter.Arbitrate(ev.index_symbol, ev.trade_id, ev.tick_rcvd, behind))
+        {
+            batch[kept++] = ev;
         }
         else
         {
-            ////  ooops.. unregistered coin..
+            behind_ticks += behind;
+            copies++;
         }
+    }
 
+    if (kept > 0)
+        shard.wins.fetch_add(kept, std::memory_order_relaxed);
+    if (copies > 0)
+    {
+        shard.copies.fetch_add(copies, std::memory_order_relaxed);
+        shard.behind_ticks.fetch_add(behind_ticks, std::memory_order_relaxed);
     }
-}
 
-void Server::process_market_msg(const ix::WebSocketMessagePtr& msg) {
-    static thread_local simdjson::dom::parser dom_parser;
-    try {
-        simdjson::dom::element root = dom_parser.parse(msg->str);
+    batch.resize(kept);
+}
 
-        if (root.is_array()) {
-            for (auto item : root.get_array()) parse_single_event(item);
-        }
-        else if (root.is_object()) {
-            simdjson::dom::element data_field;
-            auto error = root["data"].get(data_field);
+void Server::push_hot(const std::vector<MarketEvent>& batch)
+{
+    // the hot buffer has a single producer: with several feed connections (or the backfill) their parsed batches
+    // are handed over one at a time (the parsing itself runs in parallel)
+    if (m_hot_push_shared)
+    {
+        while (m_hot_push_lock.test_and_set(std::memory_order_acquire))
+            _mm_pause();
 
-            if (!error) {
-                if (data_field.is_array()) {
-                    for (auto item : data_field.get_array()) parse_single_event(item);
-                }
-                else {
-                    parse_single_event(data_field);
-                }
-            }
-            else {
-                parse_single_event(root);
-            }
-        }
+        m_hot_buffer.push_batch(batch.data(), batch.size());
+        m_hot_push_lock.clear(std::memory_order_release);
     }
-    catch (...) {
-        int ddd = 0;
+    else
+    {
+        m_hot_buffer.push_batch(batch.data(), batch.size());
     }
 }
 
-void Server::binance_stream()
+void Server::EnableTradeBackfill(std::unique_ptr<TradeSnapshotSource> source)
 {
-    ix::initNetSystem();
+    std::vector<std::string> symbols;
+    for (size_t i = 0; i < COIN_CNT; i++)
+        symbols.emplace_back(coins[i].symbol);
 
-    std::string url = "wss://fstream.binance.com/ws";
+    m_backfill = std::make_unique<TradeBackfill>(std::move(source), std::move(symbols),
+        [this](int ind_symbol, const std::vector<BackfillTrade>& trades) { push_backfill(ind_symbol, trades); });
+}
 
-    m_need_reset_vwap.store(true, std::memory_order_release);
+void Server::push_backfill(int ind_symbol, const std::vector<BackfillTrade>& trades)
+{
+    std::vector<MarketEvent> batch;
+    batch.reserve(trades.size());
 
-    while (m_running)
+    const uint64_t tick_rcvd = rdtsc();
+    for (const auto& t : trades)
+    {
+        MarketEvent event;
+        event.price = t.price;
+        event.quantity = t.quantity;
+        event.is_sell = t.is_sell;
+        event.timestamp = t.timestamp;
+        event.index_symbol = ind_symbol;
+        event.trade_id = t.trade_id;
+        event.tick_rcvd = tick_rcvd;
+        event.tick_parsed = 0;
+        batch.push_back(event);
+    }
+
+    if (!batch.empty())
+        push_hot(batch);
+}
+
+static void pin_current_thread(int core)
+{
+#ifdef _WIN32
+    SetThreadAffinityMask(GetCurrentThread(), (1ULL << core));
+#else
+    set_affinity(pthread_self(), core);
+#endif
+}
+
+void Server::SetFeedLines(uint32_t lines)
+{
+    m_feed_lines = std::clamp<uint32_t>(lines, 1, FEED_MAX_LINES);
+
+    if (m_feed_lines > 1)
+        m_feed_arbiter.Reset(COIN_CNT);
+}
+
+void Server::InitFeedShards()
+{
+    m_feed_shards.clear();
+
+    // coin i -> connection i % K: a burst on one coin delays only the coins of its connection;
+    // every connection once per feed line, the lines of a connection next to each other
+    const size_t cnt = std::clamp<size_t>(m_feed_shard_cnt, 1, COIN_CNT);
+    const size_t lines = m_feed_lines;
+    for (size_t i = 0; i < cnt; i++)
     {
-        ix::WebSocket ws;
-        ws.setUrl(url);
+        for (size_t l = 0; l < lines; l++)
+        {
+            auto shard = std::make_unique<FeedShard>();
+            shard->id = static_cast<int>(m_feed_shards.size());
+            shard->line = static_cast<int>(l);
+            if (cnt > 1)
+                shard->name = "#" + std::to_string(i);
+            if (lines > 1)
+                shard->name += (cnt > 1 ? "" : "#") + std::string(1, static_cast<char>('A' + l));
+            shard->core = (m_feed_first_core >= 0) ? m_feed_first_core + shard->id : -1;
+            m_feed_shards.push_back(std::move(shard));
+        }
+    }
+
+    for (size_t i = 0; i < COIN_CNT; i++)
+    {
+        for (size_t l = 0; l < lines; l++)
+            m_feed_shards[(i % cnt) * lines + l]->coins.push_back(static_cast<int>(i));
+    }
 
-        std::atomic<uint64_t> ws_in_cnt{ 0 };
+    // one URL per line (comma-separated), the last one repeats
+    std::vector<std::string> urls;
+    std::stringstream ss(m_feed_url);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (!item.empty())
+            urls.push_back(item);
+    }
+    if (urls.empty())
+        urls.push_back(BINANCE_FEED_URL);
 
-        ws.setOnMessageCallback(
-            [&](const ix::WebSocketMessagePtr& msg)
+    // combined stream per connection: ".../ws" -> ".../stream?streams=btcusdt@trade/ethusdt@trade"
+    // (a query of the URL, e.g. a MockExchange delay, is kept)
+    for (auto& shard : m_feed_shards)
+    {
+        std::string base = urls[(std::min)(static_cast<size_t>(shard->line), urls.size() - 1)];
+        std::string query;
+        size_t q = base.find('?');
+        if (q != std::string::npos)
+        {
+            query = "&" + base.substr(q + 1);
+            base.erase(q);
+        }
+        if (base.size() >= 3 && base.compare(base.size() - 3, 3, "/ws") == 0)
+            base.replace(base.size() - 3, 3, "/stream");
+
+        std::string streams;
+        for (int ind : shard->coins)
+        {
+            std::string name = coins[ind].symbol;
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+            streams += (streams.empty() ? "" : "/") + name + "@trade";
+        }
+        shard->url = base + "?streams=" + streams + query;
+    }
+
+    m_hot_push_shared = m_feed_shards.size() > 1;
+}
+
+void Server::start_feed_shard(FeedShard& shard)
+{
+    auto now_ns = []() { return std::chrono::duration_cast<std::chrono::nanoseconds>(steady_clock::now().time_since_epoch()).count(); };
+
+    shard.status.store(EFeedStatus::Connecting, std::memory_order_release);
+    shard.ws = std::make_unique<ix::WebSocket>();
+    ix::WebSocket& ws = *shard.ws;
+    ws.setUrl(shard.url);
+    ws.disableAutomaticReconnection();      // reconnects are staggered by binance_stream
+
+    ws.setOnMessageCallback(
+        [this, &shard, now_ns](const ix::WebSocketMessagePtr& msg)
+        {
+            switch (msg->type)
             {
-                switch (msg->type)
-                {
-                case ix::WebSocketMessageType::Open:
-                {
-                    std::cout << "\n[Binance] Connected\n";
-
-                    std::string sub = R"({
-                        "method": "SUBSCRIBE",
-                        "params": [
-                            "btcusdt@trade",
-                            "ethusdt@trade",
-                            "solusdt@trade",
-                            "bnbusdt@trade"
-                        ],
-                        "id": 1
-                    })";
-
-                    ws.send(sub);
-                    break;
-                }
+            case ix::WebSocketMessageType::Open:
+            {
+                shard.status.store(EFeedStatus::Up, std::memory_order_release);
 
-                case ix::WebSocketMessageType::Message:
-                {
-                    ws_in_cnt.fetch_add(1, std::memory_order_relaxed);
+                std::cout << "\n[Binance] Connected";
+                if (!shard.name.empty())
+                    std::cout << " " << shard.name;
 
-                    process_market_msg(msg);
+                int64_t lost = shard.lost_ns.exchange(0);
+                if (lost != 0)
+                    std::cout << " (reconnect " << (now_ns() - lost) / 1'000'000 << " ms)";
+                std::cout << "\n";
+                break;
+            }
 
-                    break;
-                }
+            case ix::WebSocketMessageType::Message:
+            {
+                // stamped first: everything after it is ours
+                const uint64_t tick_rcvd = rdtsc();
 
-                case ix::WebSocketMessageType::Ping:
+                // the parser runs on the connection's own thread
+                thread_local int pinned_core = -1;
+                if (shard.core >= 0 && pinned_core != shard.core) [[unlikely]]
                 {
-                    //ws.pong(msg->str);
-                    break;
+                    pin_current_thread(shard.core);
+                    pinned_core = shard.core;
                 }
 
-                case ix::WebSocketMessageType::Pong:
-                    break;
+                shard.msg_cnt.fetch_add(1, std::memory_order_relaxed);
 
-                case ix::WebSocketMessageType::Close:
+                if (m_feed_recorder)
                 {
-                    //std::cerr << "\n[Binance] Closed by server\n";
-                    return;
+                    std::lock_guard<std::mutex> lk(m_mtx_feed_record);
+                    m_feed_recorder->Add(tick_rcvd, msg->str);
                 }
 
-                case ix::WebSocketMessageType::Error:
-                {
-                    std::cerr << "\n[Binance] Error: "
-                        << msg->errorInfo.reason << "\n";
-                    return;
-                }
+                ProcessMarketMsg(msg->str, msg->str.capacity(), tick_rcvd, &shard);
 
-                default:
-                    break;
-                }
-            });
+                break;
+            }
 
+            case ix::WebSocketMessageType::Ping:
+            {
+                //ws.pong(msg->str);
+                break;
+            }
 
-        ws.setPingInterval(15);
+            case ix::WebSocketMessageType::Pong:
+                break;
 
-        ws.start();
+            case ix::WebSocketMessageType::Close:
+            {
+                //std::cerr << "\n[Binance] Closed by server\n";
+                int64_t expected = 0;
+                shard.lost_ns.compare_exchange_strong(expected, now_ns());
+                shard.status.store(EFeedStatus::Down, std::memory_order_release);
+                return;
+            }
 
+            case ix::WebSocketMessageType::Error:
+            {
+                std::cerr << "\n[Binance] Error: "
+                    << msg->errorInfo.reason << "\n";
+                int64_t expected = 0;
+                shard.lost_ns.compare_exchange_strong(expected, now_ns());
+                shard.status.store(EFeedStatus::Down, std::memory_order_release);
+                return;
+            }
 
-        uint64_t last_cnt = 0;
-        while (m_running)
-        {
-            // pause without blocking shutdown 
-            uint64_t sleep_dur = 5000; //5s
-            uint64_t ts1 = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            default:
+                break;
+            }
+        });
 
-            while (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count() - ts1 < sleep_dur) {
-                if (!m_running) {
-                    break;
-                }
 
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            }
+    ws.setPingInterval(15);
 
+    ws.start();
+}
+
+void Server::append_feed_stats(std::stringstream& ss)
+{
+    size_t up = 0;
+    uint64_t reconnects = 0, stalls = 0;
+    for (auto& shard : m_feed_shards)
+    {
+        up += shard->status.load(std::memory_order_relaxed) == EFeedStatus::Up;
+        reconnects += shard->reconnects.load(std::memory_order_relaxed);
+        stalls += shard->stalls.load(std::memory_order_relaxed);
+    }
+
+    ss << " | Feed: " << up << "/" << m_feed_shards.size() << " up";
+    if (reconnects > 0)
+        ss << ", reconnects " << reconnects << " (stalls " << stalls << ")";
 
+    // per line since the last report: its share of the first copies and how late its other copies came
+    if (m_feed_lines > 1)
+    {
+        uint64_t wins[FEED_MAX_LINES] = {}, copies[FEED_MAX_LINES] = {}, behind[FEED_MAX_LINES] = {};
+        uint64_t total = 0;
+        for (auto& shard : m_feed_shards)
+        {
+            wins[shard->line] += shard->wins.exchange(0, std::memory_order_relaxed);
+            copies[shard->line] += shard->copies.exchange(0, std::memory_order_relaxed);
+            behind[shard->line] += shard->behind_ticks.exchange(0, std::memory_order_relaxed);
+        }
+        for (uint32_t l = 0; l < m_feed_lines; l++)
+            total += wins[l];
 
-            uint64_t cur_cnt = ws_in_cnt.load();
-            if (cur_cnt == last_cnt)
+        if (total > 0)
+        {
+            ss << " | Lines:";
+            for (uint32_t l = 0; l < m_feed_lines; l++)
             {
-                //std::cerr << "\n[Binance] No data,  reconnect\n";
-                  break;
+                ss << " " << static_cast<char>('A' + l) << " " << std::fixed << std::setprecision(0) << 100.0 * wins[l] / total << "%";
+                if (copies[l] > 0)
+                    ss << " +" << std::setprecision(1) << Tick2Ts(behind[l] / copies[l]) / 1000.0 << " us";
             }
-            last_cnt = cur_cnt;
         }
+    }
+
+    // trade ids: copies dropped, ids jumped over and how many of them came later (backfill, another connection)
+    const uint64_t dups = m_trade_ids.GetDuplicates() + m_trade_ids.GetLate();
+    const uint64_t missing = m_trade_ids.GetMissing();
+    if (dups > 0)
+        ss << " | Dup trades: " << dups;
+    if (missing > 0)
+    {
+        ss << " | Missed trades: " << missing - (std::min)(missing, m_trade_ids.GetRecovered());
+        ss << " (recovered " << m_trade_ids.GetRecovered();
+        if (m_backfill)
+            ss << ", backfill " << m_backfill->GetFetched() << " failed " << m_backfill->GetFailed();
+        ss << ")";
+    }
+}
+
+void Server::append_feed_latency(std::stringstream& ss)
+{
+    // since the last report: exchange -> receive (the exchange clock against ours), receive -> parsed -> analytics
+    FeedLatency& lat = m_feed_latency;
+    if (lat.parse.count.load(std::memory_order_relaxed) == 0)
+        return;
+
+    ss << std::fixed << std::setprecision(1);
+    if (lat.exchange.count.load(std::memory_order_relaxed) > 0)
+        ss << " | Exch->recv: P50 " << lat.exchange.Percentile(0.5) / 1e6 << " P99 " << lat.exchange.Percentile(0.99) / 1e6 << " ms";
+
+    const uint64_t ahead = lat.ahead.exchange(0, std::memory_order_relaxed);
+    if (ahead > 0)
+        ss << " (ahead " << ahead << ")";
+
+    const uint64_t late = lat.late.exchange(0, std::memory_order_relaxed);
+    if (late > 0)
+        ss << " (over " << TxLatency::OVERFLOW_NS / 60'000'000'000 << " min " << late << ")";
+
+    ss << " | Recv->parsed: P50 " << lat.parse.Percentile(0.5) / 1000.0 << " P99 " << lat.parse.Percentile(0.99) / 1000.0 << " us";
+    ss << " | Parsed->engine: P50 " << lat.analytics.Percentile(0.5) / 1000.0 << " P99 " << lat.analytics.Percentile(0.99) / 1000.0 << " us";
+
+    lat.exchange.Reset();
+    lat.parse.Reset();
+    lat.analytics.Reset();
+}
+
+void Server::binance_stream()
+{
+    ix::initNetSystem();
+
+    m_need_reset_vwap.store(true, std::memory_order_release);
+
+    for (auto& shard : m_feed_shards)
+        start_feed_shard(*shard);
+
+    auto now_ns = []() { return std::chrono::duration_cast<std::chrono::nanoseconds>(steady_clock::now().time_since_epoch()).count(); };
 
-        if (m_running)
+    struct ShardState
+    {
+        uint64_t last_cnt = 0;
+        int64_t progress_ns = 0;    // last time messages came (or the connection was started)
+    };
+    std::vector<ShardState> state(m_feed_shards.size(), ShardState{ 0, now_ns() });
+    int64_t last_restart_ns = 0;
+
+    // health of every connection: a closed or silent one is restarted, at most one per FEED_RECONNECT_STAGGER_MS,
+    // so the connections never go down together and the other coins keep flowing
+    while (m_running)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        const int64_t now = now_ns();
+
+        for (size_t i = 0; i < m_feed_shards.size() && m_running; i++)
         {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+            FeedShard& shard = *m_feed_shards[i];
+            ShardState& st = state[i];
+
+            uint64_t cnt = shard.msg_cnt.load(std::memory_order_relaxed);
+            if (cnt != st.last_cnt)
+            {
+                st.last_cnt = cnt;
+                st.progress_ns = now;
+                continue;
+            }
+
+            // a closed connection is restarted after FEED_RECONNECT_STAGGER_MS, a silent (or still connecting) one after FEED_STALL_MS
+            const EFeedStatus status = shard.status.load(std::memory_order_acquire);
+            const int64_t quiet_ms = (now - st.progress_ns) / 1'000'000;
+
+            if (quiet_ms < ((status == EFeedStatus::Down) ? FEED_RECONNECT_STAGGER_MS : FEED_STALL_MS))
+                continue;
+            if ((now - last_restart_ns) / 1'000'000 < FEED_RECONNECT_STAGGER_MS)
+                continue;
+
+            if (status == EFeedStatus::Up)
+            {
+                // silent stall: the connection is up but nothing arrives
+                std::cerr << "\n[Binance] No data for " << FEED_STALL_MS / 1000 << " s";
+                if (!shard.name.empty())
+                    std::cerr << " " << shard.name;
+                std::cerr << "\n";
+
+                shard.stalls.fetch_add(1, std::memory_order_relaxed);
+                int64_t expected = 0;
+                shard.lost_ns.compare_exchange_strong(expected, now);
+            }
+
             std::cerr << "\n[Binance] Reconnecting...\n";
 
+            shard.ws->stop();
+            shard.reconnects.fetch_add(1, std::memory_order_relaxed);
             m_need_reset_vwap.store(true, std::memory_order_release);
+
+            start_feed_shard(shard);
+
+            st.progress_ns = now;
+            last_restart_ns = now;
         }
+    }
 
+    for (auto& shard : m_feed_shards)
+    {
+        shard->ws->stop();
+        shard->status.store(EFeedStatus::Down, std::memory_order_release);
+    }
+
+    if (m_feed_recorder)
+    {
+        m_feed_recorder->Close();
+
+        if (m_show_log_msg)
+            std::cout << "\nFeed capture: " << m_feed_recorder->GetFrameCount() << " messages, " << m_feed_recorder->GetPayloadBytes() << " bytes\n";
     }
 }
 
@@ -848,6 +1548,7 @@ void Server::hot_dispatcher()
     #endif
 
     bool ext_vwap = m_ext_vwap.load(std::memory_order_acquire);
+    ShmWriter<SMarketRecord>* shm_market = m_shm_market.get();
 
     uint64_t reader_idx = m_hot_buffer.get_tail();
     uint64_t last_tail_update = reader_idx;
@@ -857,6 +1558,17 @@ void Server::hot_dispatcher()
     uint64_t local_count = 0;
     uint64_t local_buckets[4096] = { 0 };
 
+    // live stream: the stages of every trade, merged into m_feed_latency now and then
+    const bool live = !m_data_emulation.load(std::memory_order_acquire);
+    TscCalibration tsc_cal = m_tsc_clock.Get();
+    FeedLatency::Local feed_lat;
+
+    // coins touched by the current batch, their snapshots are published after it
+    std::vector<uint64_t> coin_batch(COIN_CNT, 0);
+    std::vector<int> touched;
+    touched.reserve(COIN_CNT);
+    uint64_t batch_num = 0;
+
     while (m_running) 
     {
         // we only read Head when we have actually processed all the old stuff
@@ -882,11 +1594,40 @@ void Server::hot_dispatcher()
 
         uint64_t batch_now = __rdtsc();
         WhaleEvent* write_ptr = m_event_buffer.get_write_ptr();
+        const double express_notional = m_express_notional.load(std::memory_order_relaxed);
         size_t whales_found = 0;
+        batch_num++;
+
+        if (live)
+            tsc_cal = m_tsc_clock.Get();
 
         for (size_t i = 0; i < to_process; ++i) {
             const auto& ev = m_hot_buffer.read(reader_idx++);
 
+            // a trade seen before (redundant connections, reconnect overlap) is not counted twice
+            TradeIdGap gap;
+            const ETradeIdState id_state = m_trade_ids.Accept(ev.index_symbol, ev.trade_id, gap);
+            if (id_state == TRADE_ID_DROPPED) [[unlikely]]
+                continue;
+
+            if (gap.count > 0 && m_backfill) [[unlikely]]
+            {
+                // only the ids still inside the tracker window can be taken later
+                const uint64_t from_id = (std::max)(gap.from_id, ev.trade_id + 1 - (std::min)(ev.trade_id, TRADE_ID_WINDOW));
+                m_backfill->Request(ev.index_symbol, from_id, ev.trade_id - from_id);
+            }
+
+            if (live && ev.tick_parsed != 0)
+            {
+                // exchange event time (ms) -> receive on the local wall clock (a trade without "E" has none), then our own stages
+                if (ev.timestamp != 0)
+                    feed_lat.AddExchange(tsc_cal.ToEpochNs(ev.tick_rcvd) - static_cast<int64_t>(ev.timestamp) * 1'000'000);
+
+                feed_lat.buckets[1][TxLatency::Bucket(static_cast<uint64_t>(Tick2Ts(ev.tick_parsed - ev.tick_rcvd)))]++;
+                feed_lat.buckets[2][TxLatency::Bucket(static_cast<uint64_t>(Tick2Ts(batch_now - ev.tick_parsed)))]++;
+                feed_lat.count++;
+            }
+
 //            // PREFETCH coin_VWAP for 16 steps
 //            if (i + 16 < to_process) 
 //            {
@@ -901,8 +1642,35 @@ void Server::hot_dispatcher()
 
             auto& c = coin_VWAP[ev.index_symbol];
             c.session.add(ev.price, ev.quantity);
+            c.trade_cnt++;
+
+            if (coin_batch[ev.index_symbol] != batch_num)
+            {
+                coin_batch[ev.index_symbol] = batch_num;
+                touched.push_back(ev.index_symbol);
+            }
+
+            // a missing trade filled in late (backfill, a lagging connection) is older than the last one: it counts
+            // in the session totals only, the last trade, the rolling VWAP and whale detection move forward only
+            if (id_state == TRADE_ID_RECOVERED) [[unlikely]]
+                continue;
+
             if (ext_vwap) 
                 c.roll50.add(ev.price, ev.quantity);
+            c.last_price = ev.price;
+            c.last_qty = ev.quantity;
+            c.last_ts = ev.timestamp;
+
+            if (shm_market)
+            {
+                SMarketRecord mr{};
+                mr.price = ev.price;
+                mr.quantity = ev.quantity;
+                mr.timestamp = ev.timestamp;
+                mr.symbol = static_cast<uint32_t>(ev.index_symbol);
+                mr.is_sell = static_cast<uint8_t>(ev.is_sell);
+                shm_market->Publish(mr);
+            }
 
             uint64_t lat_ticks = batch_now - ev.tick_rcvd;
             local_total_ticks += lat_ticks;
@@ -913,16 +1681,30 @@ void Server::hot_dispatcher()
             // Whale 
             if (ev.price * ev.quantity >= whale_global_treshold[ev.index_symbol]) [[unlikely]] 
             {
-                WhaleEvent& we = write_ptr[whales_found++];
+                WhaleEvent& we = write_ptr[whales_found];
                 we.index_symbol = ev.index_symbol;
                 we.price = ev.price;
                 we.quantity = ev.quantity;
+                we.is_sell = ev.is_sell;
+                we.timestamp = ev.timestamp;
                 we.vwap_sess = c.session.value();
                 if (ext_vwap)
                 {
                     we.vwap_roll50 = c.roll50.value();
                     we.delta_roll = ev.price - we.vwap_roll50;
                 }
+                else
+                {
+                    we.vwap_roll50 = 0;
+                    we.delta_roll = 0;
+                }
+                we.tick_rcvd = ev.tick_rcvd;
+
+                // mega-whale: published at once to the express lane, does not wait for the batch commit
+                if (express_notional > 0 && ev.price * ev.quantity >= express_notional && m_express_buffer.can_write(1))
+                    m_express_buffer.push_batch(&we, 1);
+                else
+                    whales_found++;
             }
         }
 
@@ -932,6 +1714,29 @@ void Server::hot_dispatcher()
             m_event_buffer.commit_write(whales_found);
         }
 
+        // caught up (or enough collected): the monitor sees the stages of the last report
+        if (feed_lat.count >= 4096 || (feed_lat.count > 0 && to_process < 64))
+            m_feed_latency.Merge(feed_lat);
+
+        // publish once per batch: readers (snapshot on subscribe) never stop this thread
+        for (int ind : touched)
+        {
+            const auto& c = coin_VWAP[ind];
+
+            CoinSnapshot snap;
+            snap.index_symbol = ind;
+            snap.last_price = c.last_price;
+            snap.last_qty = c.last_qty;
+            snap.timestamp = c.last_ts;
+            snap.vwap_sess = c.session.value();
+            snap.vwap_roll50 = ext_vwap ? c.roll50.value() : 0;
+            snap.volume_sess = c.session.v;
+            snap.trade_cnt = c.trade_cnt;
+
+            m_coin_snapshot[ind].Store(snap);
+        }
+        touched.clear();
+
         if (reader_idx - last_tail_update >= 1024 /*65536*/) 
         {
             m_hot_buffer.update_tail(reader_idx);
@@ -987,6 +1792,233 @@ void Server::hot_dispatcher()
 }
 
 
+void Server::deliver_coin_batch(const std::vector<SessionRoute>& clients, const std::vector<WhaleEvent>& events, std::vector<WhaleEvent>& group_events, bool express)
+{
+    // 'clients' is sorted by (version, encoding, treshold): every run of equal keys is one group,
+    // its records are encoded once into a shared segment and queued by each session of the group
+
+    size_t g = 0;
+    while (g < clients.size())
+    {
+        const uint8_t version = clients[g].version;
+        const EProtocolEncoding encoding = clients[g].encoding;
+        const double treshold = clients[g].treshold;
+
+        size_t g_end = g + 1;
+        while (g_end < clients.size() && 
+            clients[g_end].version == version && 
+            clients[g_end].encoding == encoding &&
+            clients[g_end].treshold == treshold)
+        {
+            g_end++;
+        }
+
+        group_events.clear();
+        for (const auto& ev : events)
+        {
+            if (ev.total_usd() >= treshold)
+                group_events.push_back(ev);
+        }
+
+        if (!group_events.empty())
+        {
+            Frame* segment = nullptr;
+
+            if (version == PROTOCOL_VERSION_2 && encoding == EProtocolEncoding::Delta)
+            {
+                m_delta_records.resize(group_events.size());
+                EncodeWhaleRecordsV2(reinterpret_cast<uint8_t*>(m_delta_records.data()), group_events.data(), group_events.size());
+
+                segment = m_segment_pool.Acquire(DeltaBatchMaxSize(group_events.size()));
+                segment->size = EncodeDeltaBatch(segment->data(), m_delta_records.data(), m_delta_records.size());
+                segment->data_type = MSG_DATA_DELTA;
+            }
+            else if (version == PROTOCOL_VERSION_2)
+            {
+                segment = m_segment_pool.Acquire(WhaleRecordsV2Size(group_events.size()));
+                segment->size = EncodeWhaleRecordsV2(segment->data(), group_events.data(), group_events.size());
+            }
+            else
+            {
+                segment = m_segment_pool.Acquire(WhaleRecordsV1MaxSize(group_events.size()));
+                segment->size = EncodeWhaleRecordsV1(segment->data(), group_events.data(), group_events.size(), m_symbol_wire.data(), m_symbol_wire.size());
+            }
+
+            segment->count = static_cast<uint32_t>(group_events.size());
+            segment->version = version;
+            segment->ind_symbol = group_events[0].index_symbol;
+            segment->express = express;
+            segment->tick_rcvd = group_events[0].tick_rcvd;
+            segment->tick_deliver = rdtsc();
+
+            FramePool::AddRef(segment, static_cast<uint32_t>(g_end - g));
+            for (size_t i = g; i < g_end; i++)
+            {
+                clients[i].session->DeliverSegment(segment);
+            }
+
+            FramePool::Release(segment);  // encoder's reference
+        }
+
+        g = g_end;
+    }
+}
+
+void Server::publish_vwap(const RouteTable& routes, VwapTicker& ticker)
+{
+    // conflated: only coins whose snapshot was republished since the previous tick
+    bool any = false;
+    for (size_t ind = 0; ind < COIN_CNT; ind++)
+    {
+        uint64_t version = m_coin_snapshot[ind].Version();
+        ticker.changed[ind] = (version != ticker.published[ind]);
+        if (ticker.changed[ind])
+        {
+            ticker.published[ind] = version;
+            any = true;
+        }
+    }
+
+    if (!any)
+        return;
+
+    // each session gets the changed coins of its own subscription; one frame per (protocol version, coin set),
+    // shared by every session with that set ("*" subscribers typically)
+    std::vector<int>& coins = ticker.coins;
+    ticker.frame_cnt = 0;
+
+    for (const auto& route : routes.Vwap())
+    {
+        coins.clear();
+        for (int ind : route.coins)
+        {
+            if (ticker.changed[ind])
+                coins.push_back(ind);
+        }
+
+        if (coins.empty())
+            continue;
+
+        const uint8_t version = route.session->GetProtocolVersion();
+        auto last = ticker.frames.begin() + ticker.frame_cnt;
+        auto it = std::find_if(ticker.frames.begin(), last, [&](const VwapTicker::TickFrame& f) {
+            return f.version == version && f.coins == coins;
+            });
+        if (it == last)
+        {
+            // a slot of an earlier tick is refilled in place (its coin vector keeps its capacity)
+            if (ticker.frame_cnt == ticker.frames.size())
+                ticker.frames.emplace_back().coins.reserve(COIN_CNT);
+
+            it = ticker.frames.begin() + ticker.frame_cnt++;
+            it->version = version;
+            it->coins.assign(coins.begin(), coins.end());
+            it->frame = MakeSnapshotFrame(coins, ticker.snaps, version, MSG_VWAP);
+        }
+
+        FramePool::AddRef(it->frame);
+        route.session->DeliverSegment(it->frame);
+    }
+
+    // drop the encoder's references
+    for (size_t i = 0; i < ticker.frame_cnt; i++)
+        FramePool::Release(ticker.frames[i].frame);
+}
+
+bool Server::deliver_express(const RouteTable& routes, std::vector<WhaleEvent>& express_events, std::vector<WhaleEvent>& group_events)
+{
+    // mega-whales one by one: no batching, the sessions put them ahead of their queued frames
+    WhaleEvent ev;
+    bool delivered = false;
+
+    while (m_express_buffer.pop_batch(&ev, 1) > 0)
+    {
+        m_whale_history.Add(ev);
+
+        if (m_mcast)
+        {
+            m_mcast->Add(ev);
+            m_mcast->Flush();
+        }
+
+        if (m_shm_whales)
+        {
+            SWhaleRecordV2 rec;
+            EncodeWhaleRecordsV2(reinterpret_cast<uint8_t*>(&rec), &ev, 1);
+            m_shm_whales->Publish(rec);
+        }
+
+        if (ev.index_symbol >= 0 && static_cast<size_t>(ev.index_symbol) < COIN_CNT && !routes.Row(ev.index_symbol).empty())
+        {
+            express_events.clear();
+            express_events.push_back(ev);
+            deliver_coin_batch(routes.Row(ev.index_symbol), express_events, group_events, true);
+        }
+        delivered = true;
+    }
+
+    return delivered;
+}
+
+void Server::resume_session(Session* session, const std::vector<ResumePoint>& points, std::vector<WhaleEvent>& group_events)
+{
+    // event_dispatcher, right after the session's routes were built (subscribers lock held):
+    // every whale numbered up to the heads is resent here, every later one is routed live
+    std::vector<SResumeRecordV2> result;
+    std::vector<WhaleEvent> events;
+    std::vector<SessionRoute> route(1);
+
+    for (const auto& sub : session->GetSubscriptions())
+    {
+        if (sub.ind_symbol < 0 || static_cast<size_t>(sub.ind_symbol) >= COIN_CNT)
+            continue;
+
+        const uint64_t head = m_whale_history.GetHead(sub.ind_symbol);
+
+        // no resume point - live only; above the head - numbers of a previous server run
+        uint64_t last_seq = head;
+        for (const auto& pt : points)
+        {
+            if (pt.ind_symbol == sub.ind_symbol)
+                last_seq = (pt.last_seq > head) ? 0 : pt.last_seq;
+        }
+
+        SResumeRecordV2 rec{};
+        rec.symbol = static_cast<uint32_t>(sub.ind_symbol);
+        rec.head_seq = head;
+
+        events.clear();
+        rec.lost = m_whale_history.CollectAfter(sub.ind_symbol, last_seq, events);
+
+        if (session->WantsWhales() && !events.empty())
+        {
+            for (auto& ev : events)
+            {
+                ev.tick_rcvd = 0;   // not a delivery latency sample
+                if (ev.total_usd() >= sub.treshold)
+                    rec.replayed++;
+            }
+
+            route[0] = { session, sub.treshold, session->GetProtocolVersion(), session->GetEncoding() };
+            deliver_coin_batch(route, events, group_events);
+        }
+
+        result.push_back(rec);
+    }
+
+    const size_t size = result.size() * sizeof(SResumeRecordV2);
+
+    Frame* frame = m_segment_pool.Acquire(size);
+    frame->version = PROTOCOL_VERSION_2;
+    frame->data_type = MSG_RESUME;
+    frame->count = static_cast<uint32_t>(result.size());
+    if (size > 0)
+        std::memcpy(frame->data(), result.data(), size);
+    frame->size = size;
+
+    session->DeliverSegment(frame);
+}
+
 void Server::event_dispatcher()
 {
 
@@ -1002,8 +2034,26 @@ void Server::event_dispatcher()
     std::vector<std::shared_ptr<Session>> clients_shared; 
 
     // for fast send by session_index_symbol
-    std::vector<std::vector<Session*>> clients_row;    // [ind_coin][Session*]
-    clients_row.resize(COIN_CNT);
+    RouteTable routes(COIN_CNT);
+
+    // events of the current batch grouped by coin (encoded once per coin & treshold)
+    std::vector<std::vector<WhaleEvent>> coin_events(COIN_CNT);
+    for (auto& v : coin_events)
+        v.reserve(1024);
+
+    std::vector<WhaleEvent> group_events;
+    group_events.reserve(1024);
+
+    std::vector<WhaleEvent> express_events;
+    express_events.reserve(1);
+
+    std::vector<ResumePoint> resume_points;
+
+    // VWAP ticker: last published snapshot versions and the per-tick scratch
+    VwapTicker vwap_ticker(COIN_CNT);
+    for (size_t i = 0; i < COIN_CNT; i++)
+        vwap_ticker.published[i] = m_coin_snapshot[i].Version();
+    auto next_vwap = std::chrono::steady_clock::now();
 
     uint64_t upd_tick = 0;
     int empty_cycles = 0;
@@ -1027,7 +2077,23 @@ void Server::event_dispatcher()
 
         size_t to_process = (avail_read < 1024) ? avail_read : 1024;
 
-        if (h > reader_idx)
+        bool express_delivered = false;
+
+        // timer-driven, one encoded frame per interval (not per event)
+        const uint32_t vwap_interval_ms = m_vwap_interval_ms.load(std::memory_order_relaxed);
+        bool vwap_due = false;
+        if (vwap_interval_ms > 0)
+        {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= next_vwap)
+            {
+                vwap_due = true;
+                next_vwap = now + std::chrono::milliseconds(vwap_interval_ms);
+            }
+        }
+
+        // a new session is routed (and resumed) without waiting for the next whale
+        if (h > reader_idx || m_express_buffer.get_used_size() > 0 || vwap_due || m_need_update_clients.load(std::memory_order_relaxed))
         {
 
             //////////////////////////////////////////////////////////////
@@ -1039,56 +2105,94 @@ void Server::event_dispatcher()
                 std::lock_guard<std::mutex> lock(m_mtx_subscribers);
                 m_need_update_clients.store(false, std::memory_order_relaxed);
 
+                // the rebuild reads the current subscriptions, pending in-band changes are included
+                m_route_updates.clear();
+                m_need_apply_routes.store(false, std::memory_order_relaxed);
+
                 const size_t rsrv_cnt = m_subscribers.size() + 10;
 
                 clients_shared.clear();
                 if (clients_shared.capacity() < rsrv_cnt)
                     clients_shared.reserve(rsrv_cnt);
 
-                for (int i = 0; i < COIN_CNT; i++)
+                for (auto& sp : m_subscribers)
+                    clients_shared.push_back(sp);
+
+                routes.Rebuild(m_subscribers);
+
+                // reconnected sessions: the whales they missed go out ahead of the first live one
+                for (auto& sp : m_subscribers)
                 {
-                    clients_row[i].clear();
-                    if (clients_row[i].capacity() < rsrv_cnt) {
-                        clients_row[i].reserve(rsrv_cnt);
-                    }
+                    if (sp->TakeResumeRequest(resume_points))
+                        resume_session(sp.get(), resume_points, group_events);
                 }
+            }
+            else if (m_need_apply_routes.load(std::memory_order_acquire))
+            {
+                // in-band subscription changes: patch the affected rows only
+                std::lock_guard<std::mutex> lock(m_mtx_subscribers);
 
-                for (auto& sp : m_subscribers)
+                if (!m_need_update_clients.load(std::memory_order_relaxed))
                 {
-                    clients_shared.push_back(sp);
+                    for (const auto& u : m_route_updates)
+                        routes.Apply(u);
 
-                    Session* pSession = sp.get();
-                    int ind = pSession->GetSymbolIndex();
-                    if (ind >= 0 && ind < COIN_CNT)
-                        clients_row[ind].push_back(pSession);
+                    m_route_updates.clear();
+                    m_need_apply_routes.store(false, std::memory_order_relaxed);
                 }
             }
             //
             //////////////////////////////////////////////////////////////
 
 
-            // send events
+            // express lane first and once per pass: a mega-whale waits at most for one batch
+            express_delivered = deliver_express(routes, express_events, group_events);
+
+            // group events by coin
             for (size_t i = 0; i < to_process; ++i)
             {
-                const auto& ev = m_event_buffer.read(reader_idx++);
+                WhaleEvent ev = m_event_buffer.read(reader_idx++);
+                m_whale_history.Add(ev);
+
+                // multicast carries every whale, receivers filter by symbol & treshold
+                if (m_mcast)
+                    m_mcast->Add(ev);
 
-                if (ev.index_symbol >= 0 && ev.index_symbol < COIN_CNT)
+                // shared memory too: co-located readers see a whale before it is encoded for TCP
+                if (m_shm_whales)
                 {
-                    auto& clients = clients_row[ev.index_symbol];
-                    for (auto pSession : clients)
-                    {
-                        if (ev.total_usd() >= pSession->GetWhaleTreshold())
-                        {
-                            pSession->PushEvent(ev);
-                        }
-                    }
+                    SWhaleRecordV2 rec;
+                    EncodeWhaleRecordsV2(reinterpret_cast<uint8_t*>(&rec), &ev, 1);
+                    m_shm_whales->Publish(rec);
                 }
 
+                if (ev.index_symbol >= 0 && static_cast<size_t>(ev.index_symbol) < COIN_CNT && !routes.Row(ev.index_symbol).empty())
+                {
+                    coin_events[ev.index_symbol].push_back(ev);
+                }
             }
 
+            if (m_mcast)
+                m_mcast->Flush();
+
+            // send events
+            for (size_t i = 0; i < COIN_CNT; i++)
+            {
+                if (!coin_events[i].empty())
+                {
+                    deliver_coin_batch(routes.Row(i), coin_events[i], group_events);
+                    coin_events[i].clear();
+                }
+            }
+
+            if (vwap_due && !routes.Vwap().empty())
+                publish_vwap(routes, vwap_ticker);
         }
 
-        if (to_process > 0) {
+        if (m_mcast)
+            m_mcast->Heartbeat();
+
+        if (to_process > 0 || express_delivered) {
             empty_cycles = 0;
             //_mm_pause();
 
@@ -1116,6 +2220,10 @@ void Server::event_dispatcher()
             else if (empty_cycles < 100000) {
                 std::this_thread::yield();
             }
+            else if (m_express_notional.load(std::memory_order_relaxed) > 0) {
+                // express lane on: a short sleep bounds the wait of a mega-whale on an idle feed, the core is still released
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
             else {
                 std::this_thread::sleep_for(std::chrono::milliseconds(1));
             }
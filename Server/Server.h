@@ -4,6 +4,19 @@
 #include "CoinRegistry.h"
 #include "Analytics.h"
 #include "Session.h"
+#include "DeliveryLatency.h"
+#include "TscClock.h"
+#include "SeqLock.h"
+#include "MulticastPublisher.h"
+#include "IoPool.h"
+#include "WhaleHistory.h"
+#include "TradeParser.h"
+#include "FeedCapture.h"
+#include "TradeIdTracker.h"
+#include "FeedArbiter.h"
+#include "TradeBackfill.h"
+#include <ShmChannel.h>
+#include <SocketProfile.h>
 #include <boost/asio.hpp>
 #include <vector>
 #include <unordered_map>
@@ -14,14 +27,19 @@
 #include <deque>
 #include <atomic>
 #include <random>
+#include <sstream>
 
-#include <simdjson.h>
 #include <ixwebsocket/IXNetSystem.h>
 #include <ixwebsocket/IXWebSocket.h>
 
 
 constexpr size_t BUFFER_SIZE = 8 * 1024 * 1024;
 constexpr size_t COLD_BUFFER_SIZE = 2 * 1024 * 1024;
+constexpr size_t EXPRESS_BUFFER_SIZE = 4096;
+constexpr uint32_t VWAP_INTERVAL_MS = 100;      // default VWAP ticker period
+const char BINANCE_FEED_URL[] = "wss://fstream.binance.com/ws";
+constexpr int64_t FEED_STALL_MS = 5000;             // a feed connection without messages this long is restarted
+constexpr int64_t FEED_RECONNECT_STAGGER_MS = 1000; // at most one feed connection is restarted per period
 
 
 #pragma pack(push,1)
@@ -30,9 +48,10 @@ struct MarketEvent {
     double quantity;
     bool is_sell;
     uint64_t timestamp;
-    char reserved[16]; //char symbol[16]; // not used
+    uint64_t tick_parsed;   // TSC after its message was parsed, 0 - not from the live stream (backfill)
+    char reserved[8];
     int index_symbol;
-    uint64_t symbol_hash;
+    uint64_t trade_id;      // exchange trade id, 0 - not numbered (emulator)
     uint64_t tick_rcvd;
 
     char pad[3];
@@ -43,12 +62,126 @@ struct MarketEvent {
 static_assert(sizeof(MarketEvent) == 64, "MarketEvent must be 64 bytes");
 
 
+enum class EFeedStatus : uint8_t
+{
+    Connecting = 0,
+    Up = 1,
+    Down = 2,       // closed or failed, restarted by binance_stream
+};
+
+// one exchange connection of the ingest (combined stream of some coins), restarted by binance_stream on its own
+struct FeedShard
+{
+    int id = 0;
+    int line = 0;                           // redundant copy of the connection (A/B feed line)
+    std::string name;                       // in the log: "#1", "#1B", empty with a single connection
+    int core = -1;                          // parsing (callback) thread core, -1 - not pinned
+    std::vector<int> coins;
+    std::string url;
+    std::unique_ptr<ix::WebSocket> ws;
+
+    std::atomic<EFeedStatus> status{ EFeedStatus::Down };
+    std::atomic<uint64_t> msg_cnt{ 0 };
+    std::atomic<uint64_t> reconnects{ 0 };
+    std::atomic<uint64_t> stalls{ 0 };
+    std::atomic<int64_t> lost_ns{ 0 };      // when the connection was lost (reconnect time), 0 - up
+
+    // arbitration of the lines (since the last report): trades that came here first, later copies and their delay
+    std::atomic<uint64_t> wins{ 0 };
+    std::atomic<uint64_t> copies{ 0 };
+    std::atomic<uint64_t> behind_ticks{ 0 };
+};
+
+
+// event_dispatcher routing entry: one per (coin, subscribed session), the group keys are cached
+struct SessionRoute
+{
+    Session* session;
+    double treshold;
+    uint8_t version;
+    EProtocolEncoding encoding;
+};
+
+inline bool route_less(const SessionRoute& a, const SessionRoute& b)
+{
+    if (a.version != b.version)
+        return a.version < b.version;
+    if (a.encoding != b.encoding)
+        return a.encoding < b.encoding;
+    return a.treshold < b.treshold;
+}
+
+// in-band subscription change of a live session, applied to the routing by event_dispatcher
+struct RouteUpdate
+{
+    Session* session;
+    int ind_symbol;
+    double treshold;
+    bool remove;
+};
+
+// VWAP ticker routing entry: one per session with EProtocolDataType::VWAP, its coins in ascending order
+struct VwapRoute
+{
+    Session* session;
+    std::vector<int> coins;
+};
+
+// event_dispatcher routing: per coin the sessions that get its whales, sorted by (version, encoding, treshold) so the
+// sessions of one encoded segment are contiguous, and the VWAP ticker sessions with their coins.
+// Rebuilt from the registered sessions, patched by in-band updates.
+class RouteTable
+{
+public:
+    explicit RouteTable(size_t coin_cnt) : m_rows(coin_cnt) {}
+
+    // subscribers lock held
+    void Rebuild(const std::vector<std::shared_ptr<Session>>& sessions);
+    // the session's route in the coin's row (and its ticker coin) replaced (Set) or removed
+    void Apply(const RouteUpdate& u);
+
+    const std::vector<SessionRoute>& Row(size_t ind_symbol) const { return m_rows[ind_symbol]; }
+    size_t Size() const { return m_rows.size(); }
+    const std::vector<VwapRoute>& Vwap() const { return m_vwap; }
+
+private:
+    std::vector<std::vector<SessionRoute>> m_rows;     // [ind_coin][route]
+    std::vector<VwapRoute> m_vwap;
+};
+
+// event_dispatcher's VWAP ticker state: sized once, reused by every tick (no allocation once warm)
+struct VwapTicker
+{
+    // one frame per (protocol version, coin set) of a tick
+    struct TickFrame
+    {
+        uint8_t version;
+        std::vector<int> coins;
+        Frame* frame;
+    };
+
+    std::vector<uint64_t> published;    // [ind_coin] snapshot version at the last tick
+    std::vector<uint8_t> changed;       // [ind_coin] republished since the last tick
+    std::vector<TickFrame> frames;      // [0, frame_cnt) used by the current tick, the rest keep their capacity
+    size_t frame_cnt = 0;
+    std::vector<int> coins;             // changed coins of one route
+    std::vector<CoinSnapshot> snaps;    // encoder input of one frame
+
+    explicit VwapTicker(size_t coin_cnt) : published(coin_cnt, 0), changed(coin_cnt, 0)
+    {
+        coins.reserve(coin_cnt);
+        snaps.reserve(coin_cnt);
+    }
+};
+
 
 class Server 
 {
 public:
 
-    Server(boost::asio::io_context& io, uint16_t port);
+    // 'io_threads' > 0: sessions run on that many I/O threads with an io_context each (pinned from 'io_first_core' on,
+    // -1 - not pinned), 0 - on 'io'
+    Server(boost::asio::io_context& io, uint16_t port, uint32_t io_threads = 0, int io_first_core = -1);
     virtual ~Server();
 
     // disable copying
@@ -61,6 +194,7 @@ public:
      // subscription
     void RegisterSession(std::shared_ptr<Session> s);
     void UnregisterExpired();
+    bool UpdateSubscriptions(Session* session, const std::vector<RouteUpdate>& updates);
 
     void EnableDataEmulation(bool is_enable) { m_data_emulation.store(is_enable, std::memory_order_release); };
     bool IsEnableDataEmulation() { return m_data_emulation.load(std::memory_order_acquire); }
@@ -71,13 +205,79 @@ public:
     void SetExtCalcVWAP(bool is_ext) { m_ext_vwap.store(is_ext, std::memory_order_release); };
     bool IsExtCalcVWAP() { return m_ext_vwap.load(std::memory_order_acquire); }
 
+    // whales at or above this notional (USD) take the express lane, 0 - disabled
+    void SetExpressNotional(double notional) { m_express_notional.store(notional, std::memory_order_relaxed); }
+    double GetExpressNotional() { return m_express_notional.load(std::memory_order_relaxed); }
+
+    // UDP multicast of all whales (call before Start()), false if the socket cannot be set up
+    bool EnableMulticast(const std::string& group, uint16_t port, const std::string& iface = std::string());
+    // MSG_RETRANSMIT_DATA frame for a multicast receiver (caller owns the reference), nullptr if multicast is off
+    Frame* MakeRetransmitFrame(uint64_t from_seq, uint32_t count);
+
+    // shared-memory channel "<name>.whales" for co-located readers, "<name>.market" with every trade too (call before Start())
+    bool EnableShm(const std::string& name, bool market_events = false);
+
+    // trade stream WebSocket URL (emulation off, call before Start()), e.g. the local MockExchange "ws://127.0.0.1:9443/ws"
+    void SetFeedUrl(const std::string& url) { m_feed_url = url; }
+    const std::string& GetFeedUrl() const { return m_feed_url; }
+
+    // the coins split over 'count' exchange connections (coin i -> connection i % count), each parsed on its own thread,
+    // pinned to consecutive cores from 'first_core' (-1 - not pinned); call before Start()
+    void SetFeedShards(uint32_t count, int first_core = -1) { m_feed_shard_cnt = count; m_feed_first_core = first_core; }
+
+    // every connection opened 'lines' times (redundant A/B feed lines, at most FEED_MAX_LINES), the first copy of each
+    // trade is taken; line i uses the i-th of the comma-separated feed URLs (the last one if fewer). Call before Start()
+    void SetFeedLines(uint32_t lines);
+    uint32_t GetFeedLines() const { return m_feed_lines; }
+
+    // the exchange connections of the settings above (coins, names, combined stream URLs), not opened; called by Start()
+    void InitFeedShards();
+    const std::vector<std::unique_ptr<FeedShard>>& GetFeedShards() const { return m_feed_shards; }
+
+    // raw exchange messages to a capture file (Server/FeedCapture.h, call before Start()), false if it cannot be created
+    bool EnableFeedRecord(const std::string& path);
+
+    // missed trades (trade id gaps) fetched from 'source' and fed back into the ingest (call before Start())
+    void EnableTradeBackfill(std::unique_ptr<TradeSnapshotSource> source);
+
+    // one raw exchange message (WebSocket payload) -> trades into the hot buffer, returns the trade count.
+    // 'capacity' - readable bytes at payload.data(), parsed in place when it covers the simdjson padding.
+    // 'shard' - the connection it came on: with several feed lines only the first copy of a trade is taken
+    size_t ProcessMarketMsg(std::string_view payload, size_t capacity, uint64_t tick_rcvd, FeedShard* shard = nullptr);
+
+    // VWAP ticker period for EProtocolDataType::VWAP subscribers, 0 - off
+    void SetVwapInterval(uint32_t ms) { m_vwap_interval_ms.store(ms, std::memory_order_relaxed); }
+    uint32_t GetVwapInterval() { return m_vwap_interval_ms.load(std::memory_order_relaxed); }
+
+    // applied to every accepted session socket (call before Start())
+    void SetSocketProfile(const SocketProfile& profile) { m_socket_profile = profile; }
+    const SocketProfile& GetSocketProfile() const { return m_socket_profile; }
+
+    DeliveryLatency& GetDeliveryLatency(bool express) { return express ? m_latency_express : m_latency_normal; }
+    FeedLatency& GetFeedLatency() { return m_feed_latency; }
+    // TSC -> wall clock, re-anchored every second by the monitor
+    const TscClock& GetTscClock() const { return m_tsc_clock; }
+    inline double Tick2Ts(uint64_t ticks) const { return static_cast<double>(ticks) / m_cpu_ghz; }
+
     boost::asio::io_context& GetIoContext() { return m_io; }
 
     std::string GetCoinSymbol(int index) const;
     int GetCoinIndex(std::string& symbol) const;
+    size_t GetCoinCount() const;
+    const SymbolWire* GetSymbolWire() const { return m_symbol_wire.data(); }
+    Frame* GetSymbolDictV2() const { return m_symbol_dict_v2; }
+
+    // consistent copy of the coin's analytics, published by hot_dispatcher once per processed batch
+    bool GetCoinSnapshot(int index, CoinSnapshot& out) const;
+    // snapshot payload frame of the given coins (MSG_SNAPSHOT / MSG_QUERY_RESULT / MSG_VWAP) in the given protocol version,
+    // the caller owns the reference
+    Frame* MakeSnapshotFrame(const std::vector<int>& coins, uint8_t version, uint8_t data_type = MSG_SNAPSHOT, uint32_t request_id = 0);
+    // the same, the snapshots are read into 'snaps' (reused by the caller)
+    Frame* MakeSnapshotFrame(const std::vector<int>& coins, std::vector<CoinSnapshot>& snaps, uint8_t version, uint8_t data_type = MSG_SNAPSHOT, uint32_t request_id = 0);
 
 private:
     void do_accept();
+    void start_session(boost::asio::ip::tcp::socket socket);
     void session_dispatcher();
     void clear_sessions();
 
@@ -86,28 +286,66 @@ private:
     void binance_stream();
     void hot_dispatcher();
     void event_dispatcher();
+    void deliver_coin_batch(const std::vector<SessionRoute>& clients, const std::vector<WhaleEvent>& events, std::vector<WhaleEvent>& group_events, bool express = false);
+    void publish_vwap(const RouteTable& routes, VwapTicker& ticker);
+    bool deliver_express(const RouteTable& routes, std::vector<WhaleEvent>& express_events, std::vector<WhaleEvent>& group_events);
+    void resume_session(Session* session, const std::vector<ResumePoint>& points, std::vector<WhaleEvent>& group_events);
     void speed_monitor();
-    void parse_single_event(simdjson::dom::element item);
-    void process_market_msg(const ix::WebSocketMessagePtr& msg);
+    void append_session_stats(std::stringstream& ss);
+    void push_trade(const TradeFields& trade, uint64_t tick_rcvd, std::vector<MarketEvent>& batch);
+    void push_hot(const std::vector<MarketEvent>& batch);
+    void arbitrate(FeedShard& shard, std::vector<MarketEvent>& batch);
+    void start_feed_shard(FeedShard& shard);
+    void append_feed_stats(std::stringstream& ss);
+    void append_feed_latency(std::stringstream& ss);
+    void push_backfill(int ind_symbol, const std::vector<BackfillTrade>& trades);
 
     void register_coins();
     void init_coin_data();
     void set_cpu_ghz();
 
-    inline double Tick2Ts(uint64_t ticks) { return static_cast<double>(ticks) / m_cpu_ghz; }
-
 protected:
 
     boost::asio::io_context& m_io;
     boost::asio::ip::tcp::acceptor m_acceptor;
+    std::unique_ptr<IoPool> m_io_pool;      // nullptr - sessions on m_io
 
     std::mutex m_mtx_subscribers;
     std::vector<std::shared_ptr<Session>> m_subscribers;
 
     RingBuffer<MarketEvent, BUFFER_SIZE>  m_hot_buffer;
     RingBuffer<WhaleEvent, COLD_BUFFER_SIZE> m_event_buffer;
+    RingBuffer<WhaleEvent, EXPRESS_BUFFER_SIZE> m_express_buffer;   // mega-whales, hot_dispatcher -> event_dispatcher
+
+    FramePool m_segment_pool;   // shared whale record segments (encoded once for all sessions of a group)
+    WhaleHistory m_whale_history;   // per-symbol whale numbers & the last whales for resume, event_dispatcher only
+    std::vector<SWhaleRecordV2> m_delta_records;    // event_dispatcher scratch for delta-encoded segments
+    Frame* m_symbol_dict_v2{ nullptr };
 
     CoinRegistry m_reg_coin;
+    std::vector<SymbolWire> m_symbol_wire;  // [ind_coin] pre-encoded symbol names for Session frames
+    std::unique_ptr<SeqLock<CoinSnapshot>[]> m_coin_snapshot;   // [ind_coin] written by hot_dispatcher only
+
+    std::unique_ptr<MulticastPublisher> m_mcast;    // fed by event_dispatcher
+    std::vector<uint8_t> m_retransmit_buf;          // guarded by m_mtx_retransmit
+    std::mutex m_mtx_retransmit;
+
+    std::unique_ptr<ShmWriter<SWhaleRecordV2>> m_shm_whales;    // fed by event_dispatcher
+    std::unique_ptr<ShmWriter<SMarketRecord>> m_shm_market;     // fed by hot_dispatcher
+
+    std::string m_feed_url{ BINANCE_FEED_URL };
+    uint32_t m_feed_shard_cnt{ 1 };
+    int m_feed_first_core{ -1 };
+    uint32_t m_feed_lines{ 1 };
+    FeedArbiter m_feed_arbiter;                             // first copy of every trade, with several lines
+    std::vector<std::unique_ptr<FeedShard>> m_feed_shards;  // built by Start()
+    bool m_hot_push_shared{ false };                        // several feed connections push to m_hot_buffer
+    std::atomic_flag m_hot_push_lock = ATOMIC_FLAG_INIT;
+    std::unique_ptr<FeedRecorder> m_feed_recorder;
+    std::mutex m_mtx_feed_record;  // Add() from the WebSocket callbacks of all feed connections
+
+    TradeIdTracker m_trade_ids;                 // duplicates & gaps, hot_dispatcher only
+    std::unique_ptr<TradeBackfill> m_backfill;  // nullptr - gaps are only counted
 
     std::atomic<bool> m_running{ true };
 
@@ -119,8 +357,19 @@ protected:
 
     std::atomic<bool> m_data_emulation{ true };
     std::atomic<bool> m_ext_vwap{ false };
+    std::atomic<double> m_express_notional{ 0 };
+    std::atomic<uint32_t> m_vwap_interval_ms{ VWAP_INTERVAL_MS };
+
+    SocketProfile m_socket_profile;
+
+    DeliveryLatency m_latency_normal;
+    DeliveryLatency m_latency_express;
+    FeedLatency m_feed_latency;     // live stream stages, hot_dispatcher -> speed_monitor
+    TscClock m_tsc_clock;
     std::atomic<bool> m_show_log_msg{ true };
     std::atomic<bool> m_need_update_clients{ true };
+    std::vector<RouteUpdate> m_route_updates;   // guarded by m_mtx_subscribers
+    std::atomic<bool> m_need_apply_routes{ false };
     std::atomic<bool> m_need_reset_vwap{ false };
  
     //size_t COIN_CNT{0};
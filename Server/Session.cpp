@@ -5,8 +5,16 @@
 #include <iostream>
 #include <cstring>
 #include <cassert>
+#include <algorithm>
 #include <Utils.h>
 
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <time.h>
+#endif
+
 namespace asio = boost::asio;
 using tcp = asio::ip::tcp;
 using error_code = boost::system::error_code;
@@ -16,21 +24,34 @@ using steady_clock = std::chrono::steady_clock;
 
 Session::Session(tcp::socket socket, Server& server)
     : m_socket(std::move(socket))
-    , m_strand(asio::make_strand(m_socket.get_executor()))
+    , m_strand(asio::make_strand(static_cast<asio::io_context&>(asio::query(m_socket.get_executor(), asio::execution::context))))
     , m_server(server)
 {
     m_time_last_send = steady_clock::now();
-    m_event_dispatcher = std::thread(&Session::event_reader, this);
+    m_que_write.reserve(SESSION_READY_FRAMES);
 }
 
 Session::~Session()
 {
+    release_frames();
 }
 
 void Session::Start()
 {
     //m_self = shared_from_this(); // Holding a shared_ptr (self)
 
+    const SocketProfile& profile = m_server.GetSocketProfile();
+    if (!ApplySocketProfile(m_socket, profile) && m_server.IsShowLogMsg())
+        std::cerr << "\nSession: socket profile not fully applied (" << SocketProfileToString(profile) << ")\n";
+
+    m_quick_ack = profile.quick_ack;
+
+#ifdef __linux__
+    m_tx_timestamps = profile.tx_timestamps;
+    if (m_tx_timestamps)
+        arm_tx_timestamps();
+#endif
+
     async_read_header();
 }
 
@@ -69,6 +90,9 @@ void Session::async_read_header()
                 }
 
 
+                if (m_quick_ack)
+                    RearmQuickAck(m_socket);
+
                 SProtocolHeader hdr;
                 std::memcpy(&hdr, m_buf_header.data(), sizeof(hdr));
 
@@ -79,7 +103,7 @@ void Session::async_read_header()
                     return;
                 }
 
-                if (hdr.version != 1)
+                if (hdr.version != PROTOCOL_VERSION_1 && hdr.version != PROTOCOL_VERSION_2)
                 {
                     std::cerr << "\nSession: bad version, closing\n";
                     close();
@@ -103,12 +127,12 @@ void Session::async_read_header()
                     return;
                 }
 
-                async_read_body(len, data_type);
+                async_read_body(len, data_type, hdr.version);
 
             }));
 }
 
-void Session::async_read_body(std::size_t len, uint8_t data_type)
+void Session::async_read_body(std::size_t len, uint8_t data_type, uint8_t version)
 {
     if (!m_socket.is_open())
     {
@@ -124,7 +148,7 @@ void Session::async_read_body(std::size_t len, uint8_t data_type)
 
     asio::async_read(m_socket, asio::buffer(m_buf_body),
         asio::bind_executor(m_strand,
-            [this, self, data_type, len](error_code ec, std::size_t /*n*/)
+            [this, self, data_type, version, len](error_code ec, std::size_t /*n*/)
             {
                 if (ec)
                 {
@@ -146,9 +170,24 @@ void Session::async_read_body(std::size_t len, uint8_t data_type)
                     return;
                 }
 
-                if (data_type == 0x01)
+                if (data_type == MSG_SUBSCRIBE)
                 {
-                    handle_subscribe(m_buf_body);
+                    if (m_subscribed)
+                        std::cerr << "\nSession: already subscribed, use subscription update\n";
+                    else
+                        handle_subscribe(m_buf_body, version);
+                }
+                else if (data_type == MSG_SUBSCRIPTION_UPDATE)
+                {
+                    handle_subscription_update(m_buf_body);
+                }
+                else if (data_type == MSG_QUERY)
+                {
+                    handle_query(m_buf_body, version);
+                }
+                else if (data_type == MSG_RETRANSMIT)
+                {
+                    handle_retransmit(m_buf_body);
                 }
                 else
                 {
@@ -160,7 +199,7 @@ void Session::async_read_body(std::size_t len, uint8_t data_type)
             }));
 }
 
-void Session::handle_subscribe(const std::vector<uint8_t>& payload)
+void Session::handle_subscribe(const std::vector<uint8_t>& payload, uint8_t version)
 {
     if (payload.empty())
     {
@@ -199,27 +238,319 @@ void Session::handle_subscribe(const std::vector<uint8_t>& payload)
     }
     uint8_t symb_len = payload[pos++];
 
+    m_subscriptions.clear();
+
+    std::vector<SymbolSubscription> subs;
+
+    if (symb_len > 0)
+    {
+        // single (symbol, treshold)
+        if (!read_subscription(payload, pos, symb_len, subs))
+        {
+            close();
+            return;
+        }
+    }
+    else
+    {
+        // list: uint16_t count + count * (symbol_len, symbol, treshold)
+        if (pos + 2 > payload.size())
+        {
+            std::cout << "No symbol_count\n";
+            close();
+            return;
+        }
+
+        uint16_t cnt;
+        std::memcpy(&cnt, payload.data() + pos, 2);
+        cnt = net_to_host_u16(cnt);
+        pos += 2;
+
+        for (uint16_t i = 0; i < cnt; i++)
+        {
+            if (pos + 1 > payload.size())
+            {
+                std::cout << "No symbol_length\n";
+                close();
+                return;
+            }
+            symb_len = payload[pos++];
+
+            if (!read_subscription(payload, pos, symb_len, subs))
+            {
+                close();
+                return;
+            }
+        }
+    }
+
+    for (const auto& sub : subs)
+        SetSubscription(sub.ind_symbol, sub.treshold);
+
+    // encoding (optional, v2 only)
+    m_encoding = EProtocolEncoding::Fixed;
+    if (version == PROTOCOL_VERSION_2 && pos + 1 <= payload.size())
+    {
+        uint8_t encoding = payload[pos++];
+        if (encoding == static_cast<uint8_t>(EProtocolEncoding::Delta))
+            m_encoding = EProtocolEncoding::Delta;
+    }
+
+    // slow-consumer policy & lag budget (optional)
+    if (pos + 1 <= payload.size())
+    {
+        uint8_t policy = payload[pos++];
+        if (policy <= static_cast<uint8_t>(ESlowConsumerPolicy::Disconnect))
+            m_policy = static_cast<ESlowConsumerPolicy>(policy);
+
+        if (pos + 4 <= payload.size())
+        {
+            uint32_t max_lag_kb;
+            std::memcpy(&max_lag_kb, payload.data() + pos, 4);
+            max_lag_kb = net_to_host_u32(max_lag_kb);
+            pos += 4;
+
+            if (max_lag_kb > 0)
+                m_max_lag_bytes = static_cast<size_t>(max_lag_kb) * 1024;
+        }
+    }
+
+    // resume list (optional, v2): the whales after these numbers are resent before the live ones
+    if (version == PROTOCOL_VERSION_2 && pos + 2 <= payload.size())
+    {
+        uint16_t cnt;
+        std::memcpy(&cnt, payload.data() + pos, 2);
+        cnt = net_to_host_u16(cnt);
+        pos += 2;
+
+        m_resume.clear();
+        for (uint16_t i = 0; i < cnt; i++)
+        {
+            if (pos + 1 > payload.size() || pos + 1 + payload[pos] + 8 > payload.size())
+            {
+                std::cout << "No resume_point\n";
+                break;
+            }
+
+            uint8_t len = payload[pos++];
+            std::string symbol((char*)payload.data() + pos, len);
+            pos += len;
+
+            uint64_t last_seq;
+            std::memcpy(&last_seq, payload.data() + pos, 8);
+            last_seq = net_to_host_u64(last_seq);
+            pos += 8;
+
+            int ind = m_server.GetCoinIndex(symbol);
+            if (ind >= 0 && static_cast<size_t>(ind) < m_server.GetCoinCount())
+                m_resume.push_back({ ind, last_seq });
+        }
+
+        m_resume_requested = true;
+    }
+
+    // the server answers in the version the client subscribed with
+    m_version = version;
+
+    if (m_server.IsShowLogMsg())
+    {
+        std::cout << "\nSession: client subscribed to";
+        for (const auto& sub : m_subscriptions)
+            std::cout << " " << m_server.GetCoinSymbol(sub.ind_symbol);
+        std::cout << " (protocol v" << int(m_version) << (m_encoding == EProtocolEncoding::Delta ? ", delta" : "") << ")\n";
+    }
+
+    if (m_version == PROTOCOL_VERSION_2)
+    {
+        // v2 records carry a symbol index: the dictionary goes first
+        Frame* dict = m_server.GetSymbolDictV2();
+        FramePool::AddRef(dict);
+        queue_segment(dict);
+    }
+
+    // current analytics of the subscribed coins: the client is warm before the next whale
+    std::vector<int> coins;
+    coins.reserve(m_subscriptions.size());
+    for (const auto& sub : m_subscriptions)
+        coins.push_back(sub.ind_symbol);
+    queue_segment(m_server.MakeSnapshotFrame(coins, m_version));
+
+    m_server.RegisterSession(shared_from_this());
+    m_subscribed = true;
+
+
+    do_write();
+}
+
+void Session::handle_subscription_update(const std::vector<uint8_t>& payload)
+{
+    if (!m_subscribed)
+    {
+        std::cerr << "\nSession: subscription update before subscribe\n";
+        return;
+    }
+
+    size_t pos = 0;
+
+    if (pos + 2 > payload.size())
+    {
+        std::cout << "No update_count\n";
+        return;
+    }
+
+    uint16_t cnt;
+    std::memcpy(&cnt, payload.data() + pos, 2);
+    cnt = net_to_host_u16(cnt);
+    pos += 2;
+
+    std::vector<RouteUpdate> updates;
+    std::vector<SymbolSubscription> subs;
+
+    for (uint16_t i = 0; i < cnt; i++)
+    {
+        if (pos + 2 > payload.size())
+        {
+            std::cout << "No update_action\n";
+            return;
+        }
+
+        uint8_t action = payload[pos++];
+        uint8_t symb_len = payload[pos++];
+
+        subs.clear();
+        if (!read_subscription(payload, pos, symb_len, subs))
+            return;
+
+        bool remove = (action == static_cast<uint8_t>(ESubscriptionAction::Remove));
+        for (const auto& sub : subs)
+            updates.push_back({ this, sub.ind_symbol, sub.treshold, remove });
+    }
+
+    // applied under the server's subscribers lock, event_dispatcher picks it up before routing the next batch
+    if (!m_server.UpdateSubscriptions(this, updates))
+        return;
+
+    if (m_server.IsShowLogMsg())
+        std::cout << "\nSession: subscription updated (" << updates.size() << " changes, " << m_subscriptions.size() << " symbols)\n";
+}
+
+void Session::handle_query(const std::vector<uint8_t>& payload, uint8_t version)
+{
+    // answered from the seqlock slots on this strand: any query rate, the hot path is not touched
+    size_t pos = 0;
+
+    if (pos + 6 > payload.size())
+    {
+        std::cout << "No query_header\n";
+        return;
+    }
+
+    uint32_t request_id;
+    std::memcpy(&request_id, payload.data() + pos, 4);
+    request_id = net_to_host_u32(request_id);
+    pos += 4;
+
+    uint16_t cnt;
+    std::memcpy(&cnt, payload.data() + pos, 2);
+    cnt = net_to_host_u16(cnt);
+    pos += 2;
+
+    std::vector<int> coins;
+
+    if (cnt == 0)
+    {
+        for (const auto& sub : m_subscriptions)
+            coins.push_back(sub.ind_symbol);
+    }
+
+    for (uint16_t i = 0; i < cnt; i++)
+    {
+        if (pos + 1 > payload.size())
+        {
+            std::cout << "No symbol_length\n";
+            return;
+        }
+        uint8_t symb_len = payload[pos++];
+
+        if (pos + symb_len > payload.size())
+        {
+            std::cout << "No symbol_data\n";
+            return;
+        }
+
+        std::string symbol((char*)payload.data() + pos, symb_len);
+        pos += symb_len;
+
+        if (symbol == SUBSCRIBE_ALL_SYMBOLS)
+        {
+            for (size_t ind = 0; ind < m_server.GetCoinCount(); ind++)
+                coins.push_back(static_cast<int>(ind));
+            continue;
+        }
+
+        int ind = m_server.GetCoinIndex(symbol);
+        if (ind >= 0 && static_cast<size_t>(ind) < m_server.GetCoinCount())
+            coins.push_back(ind);
+    }
+
+    // a client that does not read its answers must not grow the queue without bound
+    if (m_que_bytes > m_max_lag_bytes)
+        return;
+
+    if (version != PROTOCOL_VERSION_2)
+        version = PROTOCOL_VERSION_1;
+
+    queue_segment(m_server.MakeSnapshotFrame(coins, version, MSG_QUERY_RESULT, request_id));
+    m_cnt_query.fetch_add(1, std::memory_order_relaxed);
+
+    do_write();
+}
+
+void Session::handle_retransmit(const std::vector<uint8_t>& payload)
+{
+    // multicast receiver lost datagrams: resend the ones still in the publisher's ring over this session
+    if (payload.size() < 12)
+    {
+        std::cout << "No retransmit_range\n";
+        return;
+    }
+
+    uint64_t from_seq;
+    std::memcpy(&from_seq, payload.data(), 8);
+    from_seq = net_to_host_u64(from_seq);
+
+    uint32_t count;
+    std::memcpy(&count, payload.data() + 8, 4);
+    count = net_to_host_u32(count);
+
+    Frame* frame = m_server.MakeRetransmitFrame(from_seq, count);
+    if (!frame)
+    {
+        std::cerr << "\nSession: retransmit request, multicast is off\n";
+        return;
+    }
+
+    queue_segment(frame);
+    do_write();
+}
+
+bool Session::read_subscription(const std::vector<uint8_t>& payload, size_t& pos, uint8_t symb_len, std::vector<SymbolSubscription>& subs)
+{
     //symbol
     if (pos + symb_len > payload.size())
     {
         std::cout << "No symbol_data\n";
-        close();
-        return;
+        return false;
     }
 
     std::string symbol((char*)payload.data() + pos, symb_len);
     pos += symb_len;
 
-    int ind = m_server.GetCoinIndex(symbol);
-    m_ind_symb = ind;
-
-
     //treshold
     if (pos + 8 > payload.size())
     {
         std::cout << "No treshold\n";
-        close();
-        return;
+        return false;
     }
 
     uint64_t ubits;
@@ -227,172 +558,435 @@ void Session::handle_subscribe(const std::vector<uint8_t>& payload)
     ubits = net_to_host_u64(ubits);
     pos += 8;
 
-    std::memcpy(&m_whale_treshold, &ubits, sizeof(m_whale_treshold));
+    double treshold;
+    std::memcpy(&treshold, &ubits, sizeof(treshold));
+
+    // "*" - every coin with this treshold, explicit symbols given later override it
+    if (symbol == SUBSCRIBE_ALL_SYMBOLS)
+    {
+        for (size_t ind = 0; ind < m_server.GetCoinCount(); ind++)
+            subs.push_back({ static_cast<int>(ind), treshold });
+        return true;
+    }
 
+    int ind = m_server.GetCoinIndex(symbol);
+    if (ind < 0 || static_cast<size_t>(ind) >= m_server.GetCoinCount())
+    {
+        std::cout << "\nSession: unknown symbol " << symbol << "\n";
+        return true;
+    }
 
-    if (m_server.IsShowLogMsg())
-        std::cout << "\nSession: client subscribed to " << symbol << "\n";
+    subs.push_back({ ind, treshold });
+    return true;
+}
 
-    m_server.RegisterSession(shared_from_this());
+void Session::SetSubscription(int ind_symbol, double treshold)
+{
+    for (auto& sub : m_subscriptions)
+    {
+        if (sub.ind_symbol == ind_symbol)
+        {
+            sub.treshold = treshold;
+            return;
+        }
+    }
 
+    m_subscriptions.push_back({ ind_symbol, treshold });
+}
 
-    do_write();
+bool Session::TakeResumeRequest(std::vector<ResumePoint>& points)
+{
+    if (!m_resume_requested)
+        return false;
+
+    m_resume_requested = false;
+    points.swap(m_resume);
+    m_resume.clear();
+    return true;
 }
 
-void Session::DeliverUpdates(std::vector<WhaleEvent>& events, size_t size)
+void Session::RemoveSubscription(int ind_symbol)
 {
-    auto self = shared_from_this();
-    asio::post(m_strand, [this, self, events, size]()
+    std::erase_if(m_subscriptions, [ind_symbol](const SymbolSubscription& sub) {
+        return sub.ind_symbol == ind_symbol;
+        });
+}
+
+void Session::DeliverSegment(Frame* segment)
+{
+    // called by Server::event_dispatcher, the caller passes one reference to 'segment'
+
+    if (segment->express && m_socket.is_open() && m_express_frames.can_write(1)) [[unlikely]]
+    {
+        m_express_frames.push_batch(&segment, 1);
+    }
+    else if (!m_socket.is_open() || !m_ready_frames.can_write(1))
+    {
+        if (m_socket.is_open() && IsWhaleSegment(segment))
         {
-            if (!m_socket.is_open())
+            m_cnt_dropped.fetch_add(segment->count, std::memory_order_relaxed);
+            if (m_policy == ESlowConsumerPolicy::DropOldest || m_policy == ESlowConsumerPolicy::Conflate)
+                m_dropped_unreported.fetch_add(segment->count, std::memory_order_relaxed);
+        }
+
+        FramePool::Release(segment);
+        return;
+    }
+    else
+    {
+        m_ready_frames.push_batch(&segment, 1);
+    }
+
+    // one drain in flight at a time -> the post fits into m_post_memory (no heap)
+    if (!m_drain_posted.exchange(true, std::memory_order_acq_rel))
+    {
+        auto self = shared_from_this();
+        asio::post(m_strand, MakeCustomAllocHandler(m_post_memory, [this, self]()
             {
-                return;
-            }
+                drain_ready_frames();
+            }));
+    }
+}
 
-            std::vector<uint8_t> payload;
-            payload.reserve(size * (sizeof(WhaleEvent)) + 4);
+void Session::drain_ready_frames()
+{
+    // reset before draining: a frame pushed after this point will post a new drain
+    m_drain_posted.store(false, std::memory_order_seq_cst);
 
-            // count
-            uint32_t count = host_to_net_u32(static_cast<uint32_t>(size));
-            payload.insert(payload.end(), (uint8_t*)&count, (uint8_t*)&count + 4);
+    if (!m_socket.is_open())
+    {
+        release_frames();
+        return;
+    }
 
-            for (int i=0; i<size; i++ )
-            {
-                //Signal& e = events[i];
-                const WhaleEvent& we = events[i];
-
-
-                // price
-                uint64_t price;
-                static_assert(sizeof(price) == sizeof(we.price), "double size mismatch");
-                std::memcpy(&price, &we.price, sizeof(price));
-                price = host_to_net_u64(price);
-                payload.insert(payload.end(), (uint8_t*)&price, (uint8_t*)&price + 8);
-
-
-                //quantity
-                uint64_t quantity;
-                static_assert(sizeof(quantity) == sizeof(we.quantity), "double size mismatch");
-                std::memcpy(&quantity, &we.quantity, sizeof(quantity));
-                quantity = host_to_net_u64(quantity);
-                payload.insert(payload.end(), (uint8_t*)&quantity, (uint8_t*)&quantity + 8);
-
-                //is_sell
-                payload.push_back(static_cast<uint8_t>(we.is_sell));
-
-
-                //timestamp
-                uint64_t timestamp;
-                static_assert(sizeof(timestamp) == sizeof(we.timestamp), "double size mismatch");
-                std::memcpy(&timestamp, &we.timestamp, sizeof(timestamp));
-                timestamp = host_to_net_u64(timestamp);
-                payload.insert(payload.end(), (uint8_t*)&timestamp, (uint8_t*)&timestamp + 8);
-
-                //symbol name
-                std::string symbol = m_server.GetCoinSymbol(we.index_symbol);
-                uint16_t str_len = symbol.length();
-                str_len = host_to_net_u16(str_len);
-                payload.insert(payload.end(), (uint8_t*)&str_len, (uint8_t*)&str_len + 2);
-                payload.insert(payload.end(), (uint8_t*)symbol.data(), (uint8_t*)symbol.data() + symbol.length());
-
-                //vwap_sess
-                uint64_t vwap_sess;
-                static_assert(sizeof(vwap_sess) == sizeof(we.vwap_sess), "double size mismatch");
-                std::memcpy(&vwap_sess, &we.vwap_sess, sizeof(vwap_sess));
-                vwap_sess = host_to_net_u64(vwap_sess);
-                payload.insert(payload.end(), (uint8_t*)&vwap_sess, (uint8_t*)&vwap_sess + 8);
-
-                //vwap_roll50
-                uint64_t vwap_roll50;
-                static_assert(sizeof(vwap_roll50) == sizeof(we.vwap_roll50), "double size mismatch");
-                std::memcpy(&vwap_roll50, &we.vwap_roll50, sizeof(vwap_roll50));
-                vwap_roll50 = host_to_net_u64(vwap_roll50);
-                payload.insert(payload.end(), (uint8_t*)&vwap_roll50, (uint8_t*)&vwap_roll50 + 8);
-
-                //delta_roll
-                double delta_roll_src = we.delta_roll;
-                uint64_t delta_roll;
-                static_assert(sizeof(delta_roll) == sizeof(delta_roll_src), "double size mismatch");
-                std::memcpy(&delta_roll, &delta_roll_src, sizeof(delta_roll));
-                delta_roll = host_to_net_u64(delta_roll);
-                payload.insert(payload.end(), (uint8_t*)&delta_roll, (uint8_t*)&delta_roll + 8);
+    Frame* frames[64];
+    size_t cnt = 0;
 
-            }
+    // express first: they go ahead of everything not yet in flight
+    while ((cnt = m_express_frames.pop_batch(frames, std::size(frames))) > 0)
+    {
+        for (size_t i = 0; i < cnt; i++)
+        {
+            queue_express(frames[i]);
+        }
+    }
 
-            SProtocolHeader hdr;
-            hdr.signature = host_to_net_u16(PROTOCOL_HEADER_SIGNATURE);
-            hdr.version = 1;
-            hdr.data_type = 0x02;
-            hdr.msg_num = m_msg_num++;
-            hdr.len = host_to_net_u32(static_cast<uint32_t>(payload.size()));
-
-            auto frame = std::make_shared<std::vector<uint8_t>>();
-            frame->resize(sizeof(hdr) + payload.size());
-            std::memcpy(frame->data(), &hdr, sizeof(hdr));
-            if (!payload.empty())
-            {
-                std::memcpy(frame->data() + sizeof(hdr), payload.data(), payload.size());
-            }
+    while ((cnt = m_ready_frames.pop_batch(frames, std::size(frames))) > 0)
+    {
+        for (size_t i = 0; i < cnt; i++)
+        {
+            queue_segment(frames[i]);
+        }
+    }
+
+    if (m_dropped_unreported.load(std::memory_order_relaxed) > 0)
+    {
+        report_gap(m_dropped_unreported.exchange(0, std::memory_order_relaxed));
+    }
+
+    if (m_write_cnt == 0)
+    {
+        do_write();
+    }
+
+    m_time_last_send = steady_clock::now();
+}
+
+void Session::queue_segment(Frame* segment)
+{
+    // strand only, msg_num is stamped in do_write (dropped frames leave no hole in the numbering)
+
+    if (m_closing.load(std::memory_order_relaxed))
+    {
+        FramePool::Release(segment);
+        return;
+    }
+
+    WriteItem item;
+    item.body = segment;
+    item.gap = 0;
+    item.head_size = static_cast<uint8_t>(EncodeSegmentHead(item.head.data(), *segment, 0));
+
+    const size_t bytes = item.bytes();
+
+    // a VWAP tick is superseded by the next one: not queued past the lag budget
+    if (segment->data_type == MSG_VWAP && m_que_bytes + bytes > m_max_lag_bytes)
+    {
+        FramePool::Release(segment);
+        return;
+    }
+
+    // control frames (dictionary, snapshot, query result, retransmit) are always queued
+    if (IsWhaleSegment(segment) && m_que_bytes + bytes > m_max_lag_bytes && !make_room(bytes, segment))
+    {
+        m_cnt_dropped.fetch_add(segment->count, std::memory_order_relaxed);
+        FramePool::Release(segment);
+        return;
+    }
+
+    m_que_write.push_back(item);
+    m_que_bytes += bytes;
+    m_lag_bytes.store(m_que_bytes, std::memory_order_relaxed);
+}
 
-            bool need_start = m_que_write.empty() /*&& !m_writing*/;
-            m_que_write.push_back(frame);
-            if (need_start)
+void Session::queue_express(Frame* segment)
+{
+    if (m_closing.load(std::memory_order_relaxed))
+    {
+        FramePool::Release(segment);
+        return;
+    }
+
+    // after the in-flight write and earlier express frames, not subject to the lag policy
+    size_t pos = m_que_pos + m_write_cnt;
+    while (pos < m_que_write.size() && m_que_write[pos].body && m_que_write[pos].body->express)
+        pos++;
+
+    // v2 whales are numbered per symbol and a reconnecting client resumes from the highest number it has seen:
+    // the express frame does not overtake a queued batch of its own symbol, only those of the others
+    if (m_version == PROTOCOL_VERSION_2)
+    {
+        for (size_t i = m_que_write.size(); i > pos; i--)
+        {
+            const Frame* body = m_que_write[i - 1].body;
+            if (IsWhaleSegment(body) && body->ind_symbol == segment->ind_symbol)
             {
-                do_write();
+                pos = i;
+                break;
             }
+        }
+    }
+
+    WriteItem item;
+    item.body = segment;
+    item.gap = 0;
+    item.head_size = static_cast<uint8_t>(EncodeSegmentHead(item.head.data(), *segment, 0));
+
+    m_que_write.insert(m_que_write.begin() + pos, item);
+    m_que_bytes += item.bytes();
+    m_lag_bytes.store(m_que_bytes, std::memory_order_relaxed);
+}
+
+bool Session::make_room(size_t bytes, const Frame* segment)
+{
+    // the client is behind by more than its lag budget: apply the policy, false -> drop 'segment'
+    switch (m_policy)
+    {
+    case ESlowConsumerPolicy::DropNewest:
+        return false;
+
+    case ESlowConsumerPolicy::Disconnect:
+        if (m_server.IsShowLogMsg())
+            std::cout << "\nSession: slow consumer, lag " << m_que_bytes / 1024 << " KB, disconnecting\n";
+        close();
+        return false;
 
-            m_time_last_send = steady_clock::now();
+    case ESlowConsumerPolicy::Conflate:
+        conflate(segment);
+        if (m_que_bytes + bytes > m_max_lag_bytes)
+            drop_oldest(bytes);
+        return true;
+
+    case ESlowConsumerPolicy::DropOldest:
+        drop_oldest(bytes);
+        return true;
+    }
+
+    return false;
+}
+
+void Session::conflate(const Frame* segment)
+{
+    // keep only the newest batch of the symbol: queued (not in flight) batches of it are superseded,
+    // the client learns how many whales it did not get from a gap notice ahead of the newest batch
+    auto first = m_que_write.begin() + m_que_pos + m_write_cnt;
+    uint32_t dropped = 0;
+
+    auto last = std::remove_if(first, m_que_write.end(), [this, segment, &dropped](const WriteItem& item) {
+        if (!IsWhaleSegment(item.body) || item.body->express || item.body->ind_symbol != segment->ind_symbol)
+            return false;
+
+        dropped += item.body->count;
+        m_que_bytes -= item.bytes();
+        FramePool::Release(item.body);
+        return true;
         });
+
+    m_que_write.erase(last, m_que_write.end());
+
+    if (dropped > 0)
+    {
+        m_cnt_dropped.fetch_add(dropped, std::memory_order_relaxed);
+        report_gap(dropped);
+    }
+}
+
+void Session::drop_oldest(size_t bytes)
+{
+    // the oldest queued (not in flight) batches are replaced by one gap notice, express frames are kept
+    size_t first = m_que_pos + m_write_cnt;
+    while (first < m_que_write.size() && m_que_write[first].body && m_que_write[first].body->express)
+        first++;
+
+    size_t i = first;
+    uint32_t dropped = 0;
+
+    // a gap notice already at the front is merged
+    if (i < m_que_write.size() && !m_que_write[i].body)
+    {
+        dropped = m_que_write[i].gap;
+        m_que_bytes -= m_que_write[i].bytes();
+        i++;
+    }
+
+    // stale VWAP ticks in between go too (not counted: the next tick supersedes them)
+    while (i < m_que_write.size() && m_que_bytes + bytes + GAP_FRAME_SIZE > m_max_lag_bytes &&
+        (IsWhaleSegment(m_que_write[i].body) || (m_que_write[i].body && m_que_write[i].body->data_type == MSG_VWAP)))
+    {
+        WriteItem& item = m_que_write[i++];
+
+        if (IsWhaleSegment(item.body))
+        {
+            dropped += item.body->count;
+            m_cnt_dropped.fetch_add(item.body->count, std::memory_order_relaxed);
+        }
+        m_que_bytes -= item.bytes();
+        FramePool::Release(item.body);
+    }
+
+    if (i == first)
+        return;
+
+    WriteItem& gap = m_que_write[first];
+    gap.body = nullptr;
+    gap.gap = dropped;
+    gap.head_size = static_cast<uint8_t>(EncodeGapFrame(gap.head.data(), m_version, dropped));
+    m_que_bytes += gap.bytes();
+
+    m_que_write.erase(m_que_write.begin() + first + 1, m_que_write.begin() + i);
+}
+
+void Session::report_gap(uint32_t dropped)
+{
+    WriteItem& gap = m_que_write.emplace_back();
+    gap.body = nullptr;
+    gap.gap = dropped;
+    gap.head_size = static_cast<uint8_t>(EncodeGapFrame(gap.head.data(), m_version, dropped));
+    m_que_bytes += gap.bytes();
 }
 
 void Session::do_write()
 {
     if (!m_socket.is_open())
     {
-        m_que_write.clear();
+        release_frames();
         return;
     }
 
-    if (m_que_write.empty())
+    if (m_write_cnt > 0 || m_que_pos == m_que_write.size())
     {
-        return;
+        return;     // write in flight or nothing to send
+    }
+
+    // coalesce queued frames into one gather write (one writev) up to the byte budget
+    size_t bytes = 0;
+    size_t n = 0;
+    uint64_t tick_deliver = 0;     // oldest whale segment of the write
+    while (m_que_pos + m_write_cnt < m_que_write.size() && m_write_cnt < SESSION_WRITE_MAX_FRAMES)
+    {
+        const WriteItem& item = m_que_write[m_que_pos + m_write_cnt];
+        size_t item_bytes = item.bytes();
+
+        if (m_write_cnt > 0 && bytes + item_bytes > SESSION_WRITE_BUDGET)
+            break;
+
+        // heads are copied: m_que_write may reallocate while the write is in flight
+        m_write_heads[m_write_cnt] = item.head;
+        StampMsgNum(m_write_heads[m_write_cnt].data(), m_msg_num++);
+        m_write_bufs[n++] = asio::buffer(m_write_heads[m_write_cnt].data(), item.head_size);
+        if (item.body)
+        {
+            m_write_bufs[n++] = asio::buffer(item.body->data(), item.body->size);
+            if (!tick_deliver)
+                tick_deliver = item.body->tick_deliver;
+        }
+
+        bytes += item_bytes;
+        m_write_cnt++;
     }
 
-    auto frame = m_que_write.front();
+    m_cnt_write.fetch_add(1, std::memory_order_relaxed);
+
+    if (m_tx_timestamps)
+        track_tx(bytes, tick_deliver);
+
+    std::span<const asio::const_buffer> buffers(m_write_bufs.data(), n);
+
     auto self = shared_from_this();
 
-    asio::async_write(m_socket, asio::buffer(*frame),
-        asio::bind_executor(m_strand,
-            [this, self, frame](error_code ec, std::size_t /*n*/) 
+    asio::async_write(m_socket, buffers,
+        asio::bind_executor(m_strand, MakeCustomAllocHandler(m_write_memory,
+            [this, self](error_code ec, std::size_t /*n*/) 
             {
-                if (ec)
-                {
-                    if (ec == asio::error::connection_reset ||
-                        ec == asio::error::eof)
-                    {
-                        if (m_server.IsShowLogMsg())
-                            std::cout << "\nClient disconnected\n";
-                    }
-                    else if(ec == asio::error::operation_aborted)
-                    {
-                        //std::cout << "\nWrite aborted (server disconnects clients in Server::SetSignals)\n";
-                    }
-                    else
-                    {
-                        write_error("Write error", ec);
-                    }
+                on_write(ec);
+            })));
+}
 
-                    close();
-                    return;
-                }
+void Session::on_write(const error_code& ec)
+{
+    if (ec)
+    {
+        if (ec == asio::error::connection_reset ||
+            ec == asio::error::eof ||
+            ec == asio::error::broken_pipe)
+        {
+            if (m_server.IsShowLogMsg())
+                std::cout << "\nClient disconnected\n";
+        }
+        else if(ec == asio::error::operation_aborted)
+        {
+            //std::cout << "\nWrite aborted (server disconnects clients in Server::SetSignals)\n";
+        }
+        else
+        {
+            write_error("Write error", ec);
+        }
 
-                // remove sent frame and continue
-                m_que_write.pop_front();
-                if (!m_que_write.empty())
-                {
-                    do_write();
-                }
-            }));
+        close();
+        return;
+    }
+
+    // drop our references to the sent segments and continue
+    const uint64_t now = __rdtsc();
+    for (size_t i = 0; i < m_write_cnt; i++)
+    {
+        WriteItem& item = m_que_write[m_que_pos++];
+        m_que_bytes -= item.bytes();
+
+        if (item.body && item.body->tick_rcvd)
+            m_server.GetDeliveryLatency(item.body->express).Add(now - item.body->tick_rcvd);
+
+        FramePool::Release(item.body);
+    }
+    m_write_cnt = 0;
+    m_lag_bytes.store(m_que_bytes, std::memory_order_relaxed);
+
+    if (m_que_pos == m_que_write.size())
+    {
+        m_que_write.clear();    // keeps capacity
+        m_que_pos = 0;
+    }
+    else
+    {
+        // a lagging client never drains the queue completely: drop the sent prefix
+        if (m_que_pos >= SESSION_QUE_COMPACT)
+        {
+            m_que_write.erase(m_que_write.begin(), m_que_write.begin() + m_que_pos);
+            m_que_pos = 0;
+        }
+
+        do_write();
+    }
 }
 
 void Session::close()
@@ -410,16 +1004,11 @@ void Session::close()
         m_socket.close(ec);
     }
 
-    if (m_event_dispatcher.joinable())
-    {
-        m_event_dispatcher.join();
-    }
-
     // clear queued frames on the strand to avoid races
     auto self = shared_from_this();
     asio::post(m_strand, [this, self]() 
         {
-            m_que_write.clear();
+            release_frames();
 
             //m_self.reset();
         });
@@ -427,6 +1016,29 @@ void Session::close()
     //std::cout << "\nSession closed\n";
 }
 
+void Session::release_frames()
+{
+    for (size_t i = m_que_pos; i < m_que_write.size(); i++)
+    {
+        FramePool::Release(m_que_write[i].body);
+    }
+    m_que_write.clear();
+    m_que_pos = 0;
+    m_write_cnt = 0;
+    m_que_bytes = 0;
+    m_lag_bytes.store(0, std::memory_order_relaxed);
+
+    Frame* frame = nullptr;
+    while (m_ready_frames.pop_batch(&frame, 1) > 0)
+    {
+        FramePool::Release(frame);
+    }
+    while (m_express_frames.pop_batch(&frame, 1) > 0)
+    {
+        FramePool::Release(frame);
+    }
+}
+
 bool Session::Expired() const
 {
     return !m_socket.is_open();
@@ -441,72 +1053,78 @@ void Session::ForceClose()
         });
 }
 
-void Session::PushEvent(const WhaleEvent& event)
+void Session::track_tx(size_t bytes, uint64_t tick_deliver)
 {
-    if (m_event_buffer.can_write(1))
-    {
-        m_event_buffer.push_batch(&event, 1);
-    }
-    else
-    {
-        // drop cnt
-    }
-}
-
-void Session::event_reader() {
-    //SetThreadAffinityMask(GetCurrentThread(), 1 << 6);
-    //SetThreadAffinityMask(GetCurrentThread(), 1 << 2);
+    m_tx_bytes += bytes;
 
-    int empty_cycles = 0;
-    const size_t size_batch = 4096;
-    std::vector<WhaleEvent> batch(size_batch);
+    if (!tick_deliver)
+        return;     // control frames only
 
-    int w_cnt = 0;
+    if (m_tx_pending.size() >= SESSION_TX_PENDING_MAX)
+        m_tx_pending.pop_front();   // timestamps are not coming (e.g. dropped by the kernel)
 
-    uint64_t reader_idx = m_event_buffer.get_head();
+#ifdef __linux__
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
 
-    while (m_socket.is_open()) {
-        size_t total_processed_in_this_tick = 0;
-        size_t read_count = 0;
+    const int64_t since_deliver = static_cast<int64_t>(m_server.Tick2Ts(__rdtsc() - tick_deliver));
+    m_tx_pending.push_back({ m_tx_bytes - 1, now.tv_sec * 1'000'000'000LL + now.tv_nsec - since_deliver });
+#endif
+}
 
+void Session::arm_tx_timestamps()
+{
+    // the kernel queues the timestamps on the socket's error queue (EPOLLERR)
+    auto self = shared_from_this();
+    m_socket.async_wait(tcp::socket::wait_error, asio::bind_executor(m_strand, [this, self](error_code ec)
+        {
+            if (ec || m_closing.load(std::memory_order_relaxed) || !m_socket.is_open())
+                return;
 
-        uint64_t h = m_event_buffer.get_head();
+            read_tx_timestamps();
+            arm_tx_timestamps();
+        }));
+}
 
-        if (h - reader_idx > m_event_buffer.capacity() * 0.9) {
-            reader_idx = h;
-            m_event_buffer.update_tail(reader_idx);
-            printf("\nSession::event_reader OVERLOADED! DROPS!\n");
-        }
+void Session::read_tx_timestamps()
+{
+#ifdef __linux__
+    const int fd = m_socket.native_handle();
+    alignas(cmsghdr) char control[256];
 
+    for (;;)
+    {
+        msghdr msg{};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
 
-        while ((read_count = m_event_buffer.pop_batch(&batch[0], size_batch)) > 0) {
-            total_processed_in_this_tick += read_count;
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            break;
 
-            reader_idx += read_count;
+        const scm_timestamping* tss = nullptr;
+        const sock_extended_err* err = nullptr;
 
+        for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPING)
+                tss = reinterpret_cast<const scm_timestamping*>(CMSG_DATA(cm));
+            else if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+                err = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cm));
+        }
 
-            DeliverUpdates(batch, read_count);
+        if (!tss || !err || err->ee_origin != SO_EE_ORIGIN_TIMESTAMPING)
+            continue;
 
-        }
+        // ee_data - offset of the last byte of the timestamped send (32 bits, wraps)
+        const uint32_t key = err->ee_data;
+        const int64_t tx_ns = tss->ts[0].tv_sec * 1'000'000'000LL + tss->ts[0].tv_nsec;
 
-        if (total_processed_in_this_tick > 0) {
-            empty_cycles = 0;
-            _mm_pause();
-        }
-        else {
-            empty_cycles++;
-            if (empty_cycles < 1000) {
-                _mm_pause();
-            }
-            else if (empty_cycles < 50000) {
-                for (int j = 0; j < 10; ++j) _mm_pause();
-            }
-            else if (empty_cycles < 100000) {
-                std::this_thread::yield();
-            }
-            else {
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
-            }
+        while (!m_tx_pending.empty() && static_cast<int32_t>(static_cast<uint32_t>(m_tx_pending.front().byte_end) - key) <= 0)
+        {
+            const int64_t ns = tx_ns - m_tx_pending.front().deliver_ns;
+            m_tx_latency.Add(ns > 0 ? static_cast<uint64_t>(ns) : 0);
+            m_tx_pending.pop_front();
         }
     }
-}
\ No newline at end of file
+#endif
+}
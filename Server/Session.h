@@ -1,45 +1,47 @@
 #pragma once
 
 #include "RingBuffer.h"
+#include "WhaleEvent.h"
+#include "FramePool.h"
+#include "FrameEncoder.h"
+#include "HandlerAlloc.h"
+#include "DeliveryLatency.h"
 #include <Protocol.h>
+#include <SocketProfile.h>
 #include <boost/asio.hpp>
-#include <deque>
 #include <vector>
+#include <deque>
 #include <memory>
 #include <chrono>
+#include <array>
+#include <span>
 
 
 class Server;
 
-constexpr size_t SESSION_BUFFER_SIZE = 512*1024;
-
-
-#pragma pack(push,1)
-struct WhaleEvent {
-
-    double price;
-    double quantity;
-
-    bool is_sell;
-    uint64_t timestamp;
-    int index_symbol;
-
-    double vwap_sess;
-    double vwap_roll50;
-    double reserve;  //vwap_ewma;  // not used
-
-    float delta_roll;
-    float reserve2; //float delta_ewma; // not used
-    
+constexpr size_t SESSION_READY_FRAMES = 1024;
+constexpr size_t SESSION_EXPRESS_FRAMES = 64;
+constexpr size_t SESSION_WRITE_MAX_FRAMES = 32;         // 2 buffers per frame, asio sends up to 64 buffers per writev
+constexpr size_t SESSION_WRITE_BUDGET = 256 * 1024;     // bytes per gather write
+constexpr size_t SESSION_WRITE_OP_SIZE = 2048;          // asio op of a gather write (carries its 64 buffers)
+constexpr size_t SESSION_MAX_LAG_BYTES = 4 * 1024 * 1024;   // default lag budget (queued, not yet written)
+constexpr size_t SESSION_QUE_COMPACT = 256;             // sent items kept at the queue front before compaction
+constexpr size_t SESSION_TX_PENDING_MAX = 4096;         // gather writes waiting for their TX timestamp
 
-    char pad[3];
-
-    inline double total_usd() const { return price * quantity; }
 
+// one coin of a subscription
+struct SymbolSubscription
+{
+    int ind_symbol;
+    double treshold;
 };
-#pragma pack(pop)
-static_assert(sizeof(WhaleEvent) == 64, "WhaleEvent must be 64 bytes");
 
+// last whale number a reconnecting client has seen of a symbol
+struct ResumePoint
+{
+    int ind_symbol;
+    uint64_t last_seq;
+};
 
 
 class Session : public std::enable_shared_from_this<Session> 
@@ -51,26 +53,57 @@ public:
     ~Session();
 
     void Start();
-    void DeliverUpdates(std::vector<WhaleEvent>& events, size_t size);
+    void DeliverSegment(Frame* segment);
     bool Expired() const;
     void ForceClose();
-    void PushEvent(const WhaleEvent& event);
 
-    inline double GetWhaleTreshold() { return m_whale_treshold; };
-    inline int GetSymbolIndex() { return m_ind_symb; };
+    uint64_t GetWriteCount() const { return m_cnt_write.load(std::memory_order_relaxed); }
+    uint64_t GetDroppedCount() const { return m_cnt_dropped.load(std::memory_order_relaxed); }
+    size_t GetLagBytes() const { return m_lag_bytes.load(std::memory_order_relaxed); }
+    uint64_t GetQueryCount() const { return m_cnt_query.load(std::memory_order_relaxed); }
+    // delivery -> kernel transmit of this session's whale writes (socket profile txts=1)
+    TxLatency& GetTxLatency() { return m_tx_latency; }
+
+    // after RegisterSession() the subscriptions are guarded by the server's subscribers lock
+    inline const std::vector<SymbolSubscription>& GetSubscriptions() { return m_subscriptions; };
+    void SetSubscription(int ind_symbol, double treshold);
+    void RemoveSubscription(int ind_symbol);
+    // resume list of the subscribe (v2), taken once by Server::event_dispatcher under the subscribers lock
+    bool TakeResumeRequest(std::vector<ResumePoint>& points);
+    inline uint8_t GetProtocolVersion() { return m_version; };
+    inline EProtocolEncoding GetEncoding() { return m_encoding; };
+    inline ESlowConsumerPolicy GetSlowConsumerPolicy() { return m_policy; };
+    // req_type: VWAP alone is a ticker-only subscription, anything else gets whales
+    inline bool WantsVwap() const { return m_req_type & static_cast<uint8_t>(EProtocolDataType::VWAP); };
+    inline bool WantsWhales() const { return !WantsVwap() || (m_req_type & static_cast<uint8_t>(EProtocolDataType::Whale)); };
 
 private:
     void async_read_header();
-    void async_read_body(std::size_t len, uint8_t data_type);
-    void handle_subscribe(const std::vector<uint8_t>& payload);
+    void async_read_body(std::size_t len, uint8_t data_type, uint8_t version);
+    void handle_subscribe(const std::vector<uint8_t>& payload, uint8_t version);
+    void handle_subscription_update(const std::vector<uint8_t>& payload);
+    void handle_query(const std::vector<uint8_t>& payload, uint8_t version);
+    void handle_retransmit(const std::vector<uint8_t>& payload);
+    bool read_subscription(const std::vector<uint8_t>& payload, size_t& pos, uint8_t symb_len, std::vector<SymbolSubscription>& subs);
+    void drain_ready_frames();
+    void queue_segment(Frame* segment);
+    void queue_express(Frame* segment);
+    bool make_room(size_t bytes, const Frame* segment);
+    void drop_oldest(size_t bytes);
+    void conflate(const Frame* segment);
+    void report_gap(uint32_t dropped);
     void do_write();
+    void on_write(const boost::system::error_code& ec);
     void close();
-
-    void event_reader();
+    void release_frames();
+    void track_tx(size_t bytes, uint64_t tick_deliver);
+    void arm_tx_timestamps();
+    void read_tx_timestamps();
 
 private:
-    using SocketExecutor = boost::asio::ip::tcp::socket::executor_type;
-    using SessionStrand = boost::asio::strand<SocketExecutor>;
+    // on the io_context executor itself, not the socket's polymorphic one: only that one takes the handler's allocator,
+    // so the posts of event_dispatcher (a non-io thread) stay in HandlerMemory
+    using SessionStrand = boost::asio::strand<boost::asio::io_context::executor_type>;
     using time_point = std::chrono::steady_clock::time_point;
 
     tcp::socket m_socket;
@@ -82,24 +115,77 @@ private:
     std::array<uint8_t, sizeof(SProtocolHeader)> m_buf_header;
     std::vector<uint8_t> m_buf_body;
 
-    std::deque<std::shared_ptr<std::vector<uint8_t>>> m_que_write;
+    // outbound: shared record segments from Server::event_dispatcher, handed over to the strand via m_ready_frames
+    RingBuffer<Frame*, SESSION_READY_FRAMES> m_ready_frames;
+    RingBuffer<Frame*, SESSION_EXPRESS_FRAMES> m_express_frames;    // mega-whales, queued ahead of m_ready_frames
+    std::atomic<bool> m_drain_posted{ false };
+    HandlerMemory m_post_memory;
+
+    // per-session head (header [+ count]) + shared body, sent with one gather write.
+    // A gap notice is a head without body.
+    struct WriteItem
+    {
+        std::array<uint8_t, FRAME_HEAD_MAX_SIZE> head;
+        uint8_t head_size;
+        Frame* body;
+        uint32_t gap;       // gap notice: dropped records
+
+        size_t bytes() const { return head_size + (body ? body->size : 0); }
+    };
+
+    std::vector<WriteItem> m_que_write;    // [m_que_pos, size) - not sent yet
+    size_t m_que_pos{ 0 };
+
+    // in-flight gather write: m_que_write[m_que_pos, m_que_pos + m_write_cnt)
+    size_t m_write_cnt{ 0 };
+    std::array<std::array<uint8_t, FRAME_HEAD_MAX_SIZE>, SESSION_WRITE_MAX_FRAMES> m_write_heads;
+    std::array<boost::asio::const_buffer, 2 * SESSION_WRITE_MAX_FRAMES> m_write_bufs;
+    HandlerMemory m_write_memory{ SESSION_WRITE_OP_SIZE };
+    std::atomic<uint64_t> m_cnt_write{ 0 };
+
+    // socket profile
+    bool m_quick_ack{ false };
+
+    // SO_TIMESTAMPING: the kernel reports each send by the offset of its last byte (m_tx_bytes counts them),
+    // a gather write with whales waits in m_tx_pending with its delivery time on the kernel's clock (CLOCK_REALTIME)
+    struct TxPending
+    {
+        uint64_t byte_end;
+        int64_t deliver_ns;
+    };
+    bool m_tx_timestamps{ false };
+    uint64_t m_tx_bytes{ 0 };
+    std::deque<TxPending> m_tx_pending;
+    TxLatency m_tx_latency;
+
+    // slow consumer: m_que_bytes (strand) is bounded by m_max_lag_bytes according to m_policy
+    ESlowConsumerPolicy m_policy{ ESlowConsumerPolicy::DropNewest };
+    size_t m_max_lag_bytes{ SESSION_MAX_LAG_BYTES };
+    size_t m_que_bytes{ 0 };
+    std::atomic<size_t> m_lag_bytes{ 0 };               // m_que_bytes for the monitor
+    std::atomic<uint64_t> m_cnt_dropped{ 0 };           // whale records
+    std::atomic<uint32_t> m_dropped_unreported{ 0 };    // dropped by DeliverSegment (ring full), not in a gap notice yet
+    std::atomic<uint64_t> m_cnt_query{ 0 };             // answered queries
 
     uint8_t m_req_type{ 0 };
 
     uint8_t m_msg_num{ 0 };
 
+    uint8_t m_version{ PROTOCOL_VERSION_1 };
+    EProtocolEncoding m_encoding{ EProtocolEncoding::Fixed };
+
     time_point m_time_last_send;
 
     //std::shared_ptr<Session> m_self;          // keep the self-pointer while the session is active
     std::atomic<bool> m_closing{ false };
 
-    //
+    // set on the strand before RegisterSession(), then changed by Server::UpdateSubscriptions();
+    // read by Server::event_dispatcher when it rebuilds the routing
+    std::vector<SymbolSubscription> m_subscriptions;
+    bool m_subscribed{ false };
 
-    RingBuffer<WhaleEvent, SESSION_BUFFER_SIZE> m_event_buffer;
-    std::thread m_event_dispatcher;
-
-public:
-    double m_whale_treshold{ 0 };
-    int m_ind_symb{ 0 };
+    // the same for the resume request
+    std::vector<ResumePoint> m_resume;
+    bool m_resume_requested{ false };
 
 };
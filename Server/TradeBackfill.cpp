@@ -0,0 +1,169 @@
+// TradeBackfill.cpp
+
+#include "TradeBackfill.h"
+#include "TradeParser.h"
+#include <ixwebsocket/IXHttpClient.h>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+
+RestTradeSource::RestTradeSource(const std::string& base_url)
+    : m_base_url(base_url)
+{
+    while (!m_base_url.empty() && m_base_url.back() == '/')
+        m_base_url.pop_back();
+
+    if (const char* key = std::getenv("BINANCE_API_KEY"))
+        m_api_key = key;
+}
+
+bool RestTradeSource::Fetch(const std::string& symbol, uint64_t from_id, uint32_t limit, std::vector<BackfillTrade>& out)
+{
+    const std::string url = m_base_url + "/fapi/v1/historicalTrades?symbol=" + symbol
+        + "&fromId=" + std::to_string(from_id) + "&limit=" + std::to_string(std::min(limit, MAX_LIMIT));
+
+    ix::HttpClient client;
+    ix::HttpRequestArgsPtr args = client.createRequest(url);
+    args->connectTimeout = 5;
+    args->transferTimeout = 10;
+    if (!m_api_key.empty())
+        args->extraHeaders["X-MBX-APIKEY"] = m_api_key;
+
+    ix::HttpResponsePtr res = client.get(url, args);
+    if (!res || res->errorCode != ix::HttpErrorCode::Ok || res->statusCode != 200)
+    {
+        std::cerr << "\n[Backfill] " << symbol << " from " << from_id << ": HTTP " << (res ? res->statusCode : 0)
+            << " " << (res ? res->errorMsg : std::string()) << "\n";
+        return false;
+    }
+
+    return ParseTrades(res->body, out);
+}
+
+bool RestTradeSource::ParseTrades(std::string_view json, std::vector<BackfillTrade>& out)
+{
+    out.clear();
+
+    simdjson::ondemand::parser parser;
+    simdjson::padded_string padded(json);
+    simdjson::ondemand::document doc;
+    simdjson::ondemand::array arr;
+    if (parser.iterate(padded).get(doc) || doc.get_array().get(arr))
+        return false;       // not JSON or an error object {"code":..,"msg":".."}
+
+    for (auto item : arr)
+    {
+        simdjson::ondemand::object obj;
+        BackfillTrade t{};
+        std::string_view price, qty;
+
+        if (item.get_object().get(obj)
+            || obj["id"].get_uint64().get(t.trade_id)
+            || obj["price"].get_string().get(price)
+            || obj["qty"].get_string().get(qty)
+            || obj["time"].get_uint64().get(t.timestamp)
+            || obj["isBuyerMaker"].get_bool().get(t.is_sell))
+            return false;
+
+        if (!ParseDecimal(price.data(), price.data() + price.size(), t.price)
+            || !ParseDecimal(qty.data(), qty.data() + qty.size(), t.quantity))
+            return false;
+
+        out.push_back(t);
+    }
+
+    return true;
+}
+
+
+TradeBackfill::TradeBackfill(std::unique_ptr<TradeSnapshotSource> source, std::vector<std::string> symbols, Sink sink)
+    : m_source(std::move(source))
+    , m_symbols(std::move(symbols))
+    , m_sink(std::move(sink))
+{
+}
+
+TradeBackfill::~TradeBackfill()
+{
+    Stop();
+}
+
+void TradeBackfill::Start()
+{
+    if (m_running.exchange(true))
+        return;
+
+    m_thread = std::thread(&TradeBackfill::worker, this);
+}
+
+void TradeBackfill::Stop()
+{
+    m_running = false;
+
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+bool TradeBackfill::Request(int ind_symbol, uint64_t from_id, uint64_t count)
+{
+    if (!m_queue.can_write(1))
+        return false;
+
+    BackfillRequest req{ ind_symbol, from_id, count };
+    m_queue.push_batch(&req, 1);
+    m_requests.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void TradeBackfill::worker()
+{
+    BackfillRequest reqs[16];
+
+    while (m_running)
+    {
+        size_t cnt = m_queue.pop_batch(reqs, std::size(reqs));
+        if (cnt == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+
+        for (size_t i = 0; i < cnt && m_running; i++)
+            fetch(reqs[i]);
+    }
+}
+
+void TradeBackfill::fetch(const BackfillRequest& req)
+{
+    if (req.ind_symbol < 0 || static_cast<size_t>(req.ind_symbol) >= m_symbols.size())
+        return;
+
+    const uint64_t end_id = req.from_id + req.count;
+    uint64_t from_id = req.from_id;
+
+    // in pages: the snapshot may return trades past the gap, they are cut off
+    while (from_id < end_id && m_running)
+    {
+        const uint32_t limit = static_cast<uint32_t>(std::min<uint64_t>(end_id - from_id, FETCH_LIMIT));
+        if (!m_source->Fetch(m_symbols[req.ind_symbol], from_id, limit, m_trades))
+        {
+            m_failed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        m_trades.erase(std::remove_if(m_trades.begin(), m_trades.end(),
+            [&](const BackfillTrade& t) { return t.trade_id < from_id || t.trade_id >= end_id; }), m_trades.end());
+        if (m_trades.empty())
+            return;
+
+        m_sink(req.ind_symbol, m_trades);
+        m_fetched.fetch_add(m_trades.size(), std::memory_order_relaxed);
+
+        uint64_t last_id = 0;
+        for (const auto& t : m_trades)
+            last_id = std::max(last_id, t.trade_id);
+        from_id = last_id + 1;
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "RingBuffer.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <atomic>
+
+
+// Missed trades (a TradeIdTracker gap) fetched from a trade snapshot and fed back into the ingest, off the hot path:
+// hot_dispatcher queues the gap, a worker thread fetches it and hands the trades to the sink.
+
+struct BackfillTrade
+{
+    uint64_t trade_id;
+    uint64_t timestamp;     // trade time, ms
+    double price;
+    double quantity;
+    bool is_sell;
+};
+
+struct BackfillRequest
+{
+    int ind_symbol;
+    uint64_t from_id;
+    uint64_t count;
+};
+
+
+// where the missed trades come from: the exchange REST API, a local stand-in in tests
+class TradeSnapshotSource
+{
+public:
+    virtual ~TradeSnapshotSource() = default;
+
+    // trades of 'symbol' from 'from_id' on, at most 'limit', false if the request failed
+    virtual bool Fetch(const std::string& symbol, uint64_t from_id, uint32_t limit, std::vector<BackfillTrade>& out) = 0;
+};
+
+// Binance futures GET <base_url>/fapi/v1/historicalTrades, the API key (if any) from the BINANCE_API_KEY environment variable
+class RestTradeSource : public TradeSnapshotSource
+{
+public:
+    static constexpr uint32_t MAX_LIMIT = 500;
+
+    explicit RestTradeSource(const std::string& base_url);
+
+    bool Fetch(const std::string& symbol, uint64_t from_id, uint32_t limit, std::vector<BackfillTrade>& out) override;
+
+    // the response body: [{"id":..,"price":"..","qty":"..","quoteQty":"..","time":..,"isBuyerMaker":..},...]
+    static bool ParseTrades(std::string_view json, std::vector<BackfillTrade>& out);
+
+private:
+    std::string m_base_url;
+    std::string m_api_key;
+};
+
+
+class TradeBackfill
+{
+public:
+    static constexpr uint64_t QUEUE_SIZE = 1024;
+    static constexpr uint32_t FETCH_LIMIT = 500;
+
+    // fetched trades of a symbol, called on the worker thread
+    using Sink = std::function<void(int ind_symbol, const std::vector<BackfillTrade>& trades)>;
+
+    // 'symbols' - names by coin index
+    TradeBackfill(std::unique_ptr<TradeSnapshotSource> source, std::vector<std::string> symbols, Sink sink);
+    ~TradeBackfill();
+
+    // disable copying
+    TradeBackfill(const TradeBackfill&) = delete;
+    TradeBackfill& operator=(const TradeBackfill&) = delete;
+
+    void Start();
+    void Stop();
+
+    // queues a gap (one producer thread), false if the queue is full - the gap stays missing
+    bool Request(int ind_symbol, uint64_t from_id, uint64_t count);
+
+    uint64_t GetRequests() const { return m_requests.load(std::memory_order_relaxed); }
+    uint64_t GetFetched() const { return m_fetched.load(std::memory_order_relaxed); }
+    uint64_t GetFailed() const { return m_failed.load(std::memory_order_relaxed); }
+
+private:
+    void worker();
+    void fetch(const BackfillRequest& req);
+
+private:
+    std::unique_ptr<TradeSnapshotSource> m_source;
+    std::vector<std::string> m_symbols;
+    Sink m_sink;
+
+    RingBuffer<BackfillRequest, QUEUE_SIZE> m_queue;
+    std::vector<BackfillTrade> m_trades;    // worker scratch
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{ false };
+
+    std::atomic<uint64_t> m_requests{ 0 };
+    std::atomic<uint64_t> m_fetched{ 0 };
+    std::atomic<uint64_t> m_failed{ 0 };
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <vector>
+#include <atomic>
+
+
+// Per-symbol exchange trade ids of the ingest: a trade seen before (redundant connections, reconnect overlap) is dropped,
+// a jump over ids is counted as missing. The last TRADE_ID_WINDOW ids of a symbol are remembered in a bitmap, so a
+// missing trade that comes later (backfill, another connection) is still taken once; older ones are dropped as late.
+// One writer thread (hot_dispatcher), the counters are read by the monitor.
+
+constexpr uint64_t TRADE_ID_WINDOW = 1024;
+
+// what Accept() did with a trade id
+enum ETradeIdState : uint8_t
+{
+    TRADE_ID_DROPPED = 0,       // already taken or older than the window
+    TRADE_ID_FRESH,             // above the head (or not numbered): the latest trade of the symbol
+    TRADE_ID_RECOVERED,         // a missing id below the head filled in: older than the last trade
+};
+
+// ids jumped over by a trade: [from_id, from_id + count)
+struct TradeIdGap
+{
+    uint64_t from_id = 0;
+    uint64_t count = 0;
+};
+
+
+class TradeIdTracker
+{
+    static constexpr size_t WORDS = TRADE_ID_WINDOW / 64;
+    static_assert(TRADE_ID_WINDOW % 64 == 0, "TRADE_ID_WINDOW must be a multiple of 64");
+
+    struct alignas(64) Window
+    {
+        uint64_t head;              // highest id taken, 0 - none yet
+        uint64_t bits[WORDS];       // ids (head - TRADE_ID_WINDOW, head] taken, bit id % TRADE_ID_WINDOW
+    };
+
+public:
+    TradeIdTracker() = default;
+    explicit TradeIdTracker(size_t symbol_cnt) { Reset(symbol_cnt); }
+
+    void Reset(size_t symbol_cnt)
+    {
+        m_win.assign(symbol_cnt, Window{});
+        m_duplicates = 0;
+        m_late = 0;
+        m_missing = 0;
+        m_recovered = 0;
+    }
+
+    // TRADE_ID_DROPPED (false) - drop it. A jump over ids is reported in 'gap' (count 0 - none).
+    // Trade id 0 (not numbered, the emulator) is always fresh.
+    inline ETradeIdState Accept(int ind_symbol, uint64_t trade_id, TradeIdGap& gap)
+    {
+        gap.count = 0;
+        if (trade_id == 0)
+            return TRADE_ID_FRESH;
+
+        Window& w = m_win[ind_symbol];
+
+        // in order: the next id of the symbol
+        if (trade_id > w.head) [[likely]]
+        {
+            if (trade_id - w.head > 1 && w.head != 0) [[unlikely]]
+            {
+                gap.from_id = w.head + 1;
+                gap.count = trade_id - w.head - 1;
+                m_missing.fetch_add(gap.count, std::memory_order_relaxed);
+            }
+
+            // ids leaving the window
+            if (trade_id - w.head >= TRADE_ID_WINDOW)
+                std::memset(w.bits, 0, sizeof(w.bits));
+            else
+                for (uint64_t id = w.head + 1; id < trade_id; id++)
+                    clear(w, id);
+
+            set(w, trade_id);
+            w.head = trade_id;
+            return TRADE_ID_FRESH;
+        }
+
+        if (w.head - trade_id >= TRADE_ID_WINDOW)
+        {
+            m_late.fetch_add(1, std::memory_order_relaxed);
+            return TRADE_ID_DROPPED;
+        }
+
+        if (test(w, trade_id))
+        {
+            m_duplicates.fetch_add(1, std::memory_order_relaxed);
+            return TRADE_ID_DROPPED;
+        }
+
+        // a missing trade filled in
+        set(w, trade_id);
+        m_recovered.fetch_add(1, std::memory_order_relaxed);
+        return TRADE_ID_RECOVERED;
+    }
+
+    uint64_t GetHead(int ind_symbol) const { return m_win[ind_symbol].head; }
+
+    uint64_t GetDuplicates() const { return m_duplicates.load(std::memory_order_relaxed); }
+    uint64_t GetLate() const { return m_late.load(std::memory_order_relaxed); }
+    uint64_t GetMissing() const { return m_missing.load(std::memory_order_relaxed); }      // jumped over (recovered ones included)
+    uint64_t GetRecovered() const { return m_recovered.load(std::memory_order_relaxed); }
+
+private:
+    static inline void set(Window& w, uint64_t id) { w.bits[(id / 64) % WORDS] |= 1ULL << (id % 64); }
+    static inline void clear(Window& w, uint64_t id) { w.bits[(id / 64) % WORDS] &= ~(1ULL << (id % 64)); }
+    static inline bool test(const Window& w, uint64_t id) { return (w.bits[(id / 64) % WORDS] >> (id % 64)) & 1; }
+
+private:
+    std::vector<Window> m_win;
+
+    std::atomic<uint64_t> m_duplicates{ 0 };
+    std::atomic<uint64_t> m_late{ 0 };
+    std::atomic<uint64_t> m_missing{ 0 };
+    std::atomic<uint64_t> m_recovered{ 0 };
+};
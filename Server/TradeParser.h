@@ -0,0 +1,222 @@
+#pragma once
+
+#include <simdjson.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+
+
+// Binance sends prices and quantities as decimal strings ("96000.10", "0.003").
+// The digits are gathered into an integer and divided once by an exact power of ten: both are exact doubles
+// (mantissa <= 2^53, scale <= 22), so the single rounding gives the same double as std::from_chars.
+// Anything else (exponent, sign, too many digits) goes to std::from_chars.
+inline bool ParseDecimal(const char* first, const char* last, double& out)
+{
+    static constexpr double POW10[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* p = first;
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int scale = 0;
+
+    for (; p != last && static_cast<unsigned>(*p - '0') <= 9; ++p, ++digits)
+        mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+
+    if (p != last && *p == '.')
+    {
+        for (++p; p != last && static_cast<unsigned>(*p - '0') <= 9; ++p, ++digits, ++scale)
+            mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+    }
+
+    if (p != last || digits == 0 || digits > 19 || mantissa > (1ull << 53) || scale > 22) [[unlikely]]
+    {
+        auto [ptr, ec] = std::from_chars(first, last, out);
+        return ec == std::errc() && ptr == last;
+    }
+
+    out = static_cast<double>(mantissa) / POW10[scale];
+    return true;
+}
+
+
+// One trade of the Binance trade stream
+struct TradeFields
+{
+    std::string_view symbol;    // points into the parsed message, valid during the callback
+    uint64_t timestamp = 0;     // "E", ms
+    uint64_t trade_id = 0;      // "t"
+    double price = 0.0;
+    double quantity = 0.0;
+    bool is_sell = false;       // "m": the buyer is the maker
+};
+
+
+// simdjson On-Demand parser of the Binance trade stream: a single trade object, an array of them or
+// a combined stream message ({"stream":..., "data": ...}). Only the used fields are materialized, no DOM is built.
+// The fields are looked up in the order Binance sends them (spot and futures: e, E, [T], s, t, p, q, ..., m),
+// so every lookup continues where the previous one stopped; an object in another order is read again unordered.
+// One parser per thread.
+class TradeParser
+{
+public:
+    TradeParser() = default;
+
+    // disable copying
+    TradeParser(const TradeParser&) = delete;
+    TradeParser& operator=(const TradeParser&) = delete;
+
+    // calls on_trade(const TradeFields&) for every trade, returns the trade count.
+    // The message is parsed in place when the readable bytes at it ('capacity') cover the simdjson padding.
+    template <typename OnTrade>
+    size_t Parse(std::string_view msg, size_t capacity, OnTrade&& on_trade)
+    {
+        if (capacity >= msg.size() + simdjson::SIMDJSON_PADDING)
+            return parse(simdjson::padded_string_view(msg.data(), msg.size(), capacity), on_trade);
+
+        return Parse(msg, on_trade);
+    }
+
+    template <typename OnTrade>
+    size_t Parse(const std::string& msg, OnTrade&& on_trade)
+    {
+        return Parse(std::string_view(msg), msg.capacity(), on_trade);
+    }
+
+    template <typename OnTrade>
+    size_t Parse(std::string_view msg, OnTrade&& on_trade)
+    {
+        if (m_buf.size() < msg.size() + simdjson::SIMDJSON_PADDING)
+            m_buf.resize(msg.size() + simdjson::SIMDJSON_PADDING);
+
+        std::memcpy(m_buf.data(), msg.data(), msg.size());
+        return parse(simdjson::padded_string_view(m_buf.data(), msg.size(), m_buf.size()), on_trade);
+    }
+
+private:
+    template <typename OnTrade>
+    size_t parse(simdjson::padded_string_view json, OnTrade& on_trade)
+    {
+        simdjson::ondemand::document doc;
+        if (m_parser.iterate(json).get(doc))
+            return 0;
+
+        simdjson::ondemand::value root;
+        if (doc.get_value().get(root))
+            return 0;
+
+        return parse_value(root, on_trade);
+    }
+
+    template <typename OnTrade>
+    size_t parse_value(simdjson::ondemand::value value, OnTrade& on_trade)
+    {
+        simdjson::ondemand::json_type type;
+        if (value.type().get(type))
+            return 0;
+
+        size_t cnt = 0;
+
+        if (type == simdjson::ondemand::json_type::array)
+        {
+            simdjson::ondemand::array items;
+            if (value.get_array().get(items))
+                return 0;
+
+            for (auto item : items)
+            {
+                simdjson::ondemand::value v;
+                if (item.get(v))
+                    break;
+                cnt += parse_value(v, on_trade);
+            }
+        }
+        else if (type == simdjson::ondemand::json_type::object)
+        {
+            simdjson::ondemand::object obj;
+            if (value.get_object().get(obj))
+                return 0;
+
+            // combined stream: {"stream": "...", "data": trade or [trades]}, Binance sends "stream" first, so the
+            // envelope is recognized by the first key and "data" is looked up once, without trying it as a trade
+            const bool envelope = first_key_is(obj, "stream");
+
+            TradeFields t;
+            if (!envelope && !obj.reset().error()
+                && (read_trade<false>(obj, t) || (!obj.reset().error() && read_trade<true>(obj, t))))
+            {
+                on_trade(t);
+                return 1;
+            }
+
+            // anything else (subscribe answers) is skipped
+            simdjson::ondemand::value data;
+            if (!obj.reset().error() && !obj.find_field_unordered("data").get(data))
+                cnt += parse_value(data, on_trade);
+        }
+
+        return cnt;
+    }
+
+    template <bool Unordered>
+    static bool read_trade(simdjson::ondemand::object& obj, TradeFields& t)
+    {
+        auto field = [&](std::string_view key)
+        {
+            if constexpr (Unordered)
+                return obj.find_field_unordered(key);
+            else
+                return obj.find_field(key);
+        };
+
+        // symbol, price and quantity have no escapes: they are read in place, not unescaped into the parser buffer
+        simdjson::ondemand::raw_json_string symbol, price, quantity;
+
+        if (field("E").get_uint64().get(t.timestamp)
+            || field("s").get_raw_json_string().get(symbol)
+            || field("t").get_uint64().get(t.trade_id)
+            || field("p").get_raw_json_string().get(price)
+            || field("q").get_raw_json_string().get(quantity)
+            || field("m").get_bool().get(t.is_sell))
+        {
+            return false;
+        }
+
+        t.symbol = raw_view(symbol);
+        std::string_view p = raw_view(price), q = raw_view(quantity);
+
+        return ParseDecimal(p.data(), p.data() + p.size(), t.price)
+            && ParseDecimal(q.data(), q.data() + q.size(), t.quantity);
+    }
+
+    // the key of the first field is 'key' (the value is not read, reset() the object before the next lookup)
+    static bool first_key_is(simdjson::ondemand::object& obj, std::string_view key)
+    {
+        for (auto field : obj)
+        {
+            simdjson::ondemand::raw_json_string raw;
+            return !field.key().get(raw) && raw == key;
+        }
+        return false;
+    }
+
+    // string contents up to the closing quote
+    static std::string_view raw_view(simdjson::ondemand::raw_json_string raw)
+    {
+        const char* first = raw.raw();
+        const char* last = first;
+        while (*last != '"')
+            ++last;
+        return std::string_view(first, static_cast<size_t>(last - first));
+    }
+
+private:
+    simdjson::ondemand::parser m_parser;
+    std::vector<char> m_buf;            // padded copy of messages without spare capacity
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "SeqLock.h"
+#include <cstdint>
+#include <chrono>
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+
+// TSC -> wall clock (epoch ns), to compare local receive ticks with exchange timestamps.
+// An anchor is a (tsc, epoch) pair read back to back, the pair with the shortest TSC bracket of a few tries.
+// The rate is measured against the wall clock from the first anchor, so it gets more precise the longer the
+// server runs; Update() (once a second, one thread) moves the anchor to follow NTP slewing. Readers never wait.
+struct TscCalibration
+{
+    uint64_t base_tsc;
+    int64_t  base_epoch_ns;
+    double   ghz;               // TSC ticks per ns
+
+    inline int64_t ToEpochNs(uint64_t tsc) const
+    {
+        return base_epoch_ns + static_cast<int64_t>(static_cast<double>(static_cast<int64_t>(tsc - base_tsc)) / ghz);
+    }
+};
+
+
+class TscClock
+{
+public:
+    // 'ghz' - a first estimate of the TSC rate
+    void Start(double ghz)
+    {
+        const Anchor first = sample();
+        m_first_tsc = first.tsc;
+        m_first_epoch_ns = first.epoch_ns;
+        m_cal.Store(TscCalibration{ m_first_tsc, m_first_epoch_ns, ghz });
+        m_ghz = ghz;
+    }
+
+    void Update()
+    {
+        const auto [tsc, epoch_ns] = sample();
+
+        // at least a second of baseline before the rate is replaced
+        if (epoch_ns - m_first_epoch_ns >= 1'000'000'000 && tsc > m_first_tsc)
+            m_ghz = static_cast<double>(tsc - m_first_tsc) / static_cast<double>(epoch_ns - m_first_epoch_ns);
+
+        m_cal.Store(TscCalibration{ tsc, epoch_ns, m_ghz });
+    }
+
+    TscCalibration Get() const { return m_cal.Load(); }
+
+    int64_t ToEpochNs(uint64_t tsc) const { return Get().ToEpochNs(tsc); }
+
+    static int64_t NowEpochNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    struct Anchor
+    {
+        uint64_t tsc;
+        int64_t  epoch_ns;
+    };
+
+    static Anchor sample()
+    {
+        Anchor anchor{ 0, 0 };
+        uint64_t best = UINT64_MAX;
+        for (int i = 0; i < 16; i++)
+        {
+            const uint64_t t1 = __rdtsc();
+            const int64_t ns = NowEpochNs();
+            const uint64_t t2 = __rdtsc();
+
+            if (t2 - t1 < best)
+            {
+                best = t2 - t1;
+                anchor = Anchor{ t1 + (t2 - t1) / 2, ns };
+            }
+        }
+        return anchor;
+    }
+
+private:
+    SeqLock<TscCalibration> m_cal;
+    uint64_t m_first_tsc{ 0 };
+    int64_t m_first_epoch_ns{ 0 };
+    double m_ghz{ 1.0 };
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+
+#pragma pack(push,1)
+struct WhaleEvent {
+
+    double price;
+    double quantity;
+
+    bool is_sell;
+    uint64_t timestamp;
+    int16_t index_symbol;   // 16 bits leave room for 'seq' in the cache line
+
+    double vwap_sess;
+    double vwap_roll50;
+    uint64_t tick_rcvd;     // rdtsc when the market event was received (delivery latency)
+
+    float delta_roll;
+
+    uint64_t seq;           // per-symbol whale number (1, 2, ...), set by Server::event_dispatcher
+
+    char pad[1];
+
+    inline double total_usd() const { return price * quantity; }
+
+};
+#pragma pack(pop)
+static_assert(sizeof(WhaleEvent) == 64, "WhaleEvent must be 64 bytes");
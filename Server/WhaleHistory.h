@@ -0,0 +1,83 @@
+#pragma once
+
+#include "WhaleEvent.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+
+constexpr size_t WHALE_HISTORY_DEPTH = 4096;    // whales kept per symbol (power of two)
+
+
+// Numbers the whales of every symbol (1, 2, ...) and keeps the last WHALE_HISTORY_DEPTH of them,
+// so a reconnecting session can be resent what it missed.
+// Used by Server::event_dispatcher only: it numbers the whales and replays them before routing the live ones,
+// so there is no locking and no race between the replay and the live stream.
+class WhaleHistory
+{
+    static_assert((WHALE_HISTORY_DEPTH & (WHALE_HISTORY_DEPTH - 1)) == 0, "depth must be a power of two");
+
+public:
+    explicit WhaleHistory(size_t symbol_cnt)
+        : m_ring(symbol_cnt * WHALE_HISTORY_DEPTH)
+        , m_head(symbol_cnt, 0)
+    {
+    }
+
+    // disable copying
+    WhaleHistory(const WhaleHistory&) = delete;
+    WhaleHistory& operator=(const WhaleHistory&) = delete;
+
+    // sets ev.seq and keeps a copy (unknown symbols are not numbered)
+    void Add(WhaleEvent& ev)
+    {
+        if (ev.index_symbol < 0 || static_cast<size_t>(ev.index_symbol) >= m_head.size())
+        {
+            ev.seq = 0;
+            return;
+        }
+
+        ev.seq = ++m_head[ev.index_symbol];
+        m_ring[slot(ev.index_symbol, ev.seq)] = ev;
+    }
+
+    // last number given to the symbol, 0 - none yet
+    uint64_t GetHead(int ind_symbol) const { return m_head[ind_symbol]; }
+
+    // oldest number still kept
+    uint64_t GetFirst(int ind_symbol) const
+    {
+        uint64_t head = m_head[ind_symbol];
+        return head > WHALE_HISTORY_DEPTH ? head - WHALE_HISTORY_DEPTH + 1 : 1;
+    }
+
+    // appends the kept whales numbered after 'last_seq', returns how many numbers after it are no longer kept
+    uint64_t CollectAfter(int ind_symbol, uint64_t last_seq, std::vector<WhaleEvent>& out) const
+    {
+        const uint64_t head = m_head[ind_symbol];
+        const uint64_t first = GetFirst(ind_symbol);
+
+        uint64_t from = last_seq + 1;
+        uint64_t lost = 0;
+        if (from < first)
+        {
+            lost = first - from;
+            from = first;
+        }
+
+        for (uint64_t seq = from; seq <= head; seq++)
+            out.push_back(m_ring[slot(ind_symbol, seq)]);
+
+        return lost;
+    }
+
+private:
+    size_t slot(int ind_symbol, uint64_t seq) const
+    {
+        return static_cast<size_t>(ind_symbol) * WHALE_HISTORY_DEPTH + static_cast<size_t>(seq & (WHALE_HISTORY_DEPTH - 1));
+    }
+
+private:
+    std::vector<WhaleEvent> m_ring;     // [symbol][seq % depth]
+    std::vector<uint64_t> m_head;       // [symbol] last number
+};
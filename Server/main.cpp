@@ -1,5 +1,7 @@
 #include <boost/asio.hpp>
 #include <iostream>
+#include <string>
+#include <CommandLine.h>
 #include "Server.h"
 
 namespace io = boost::asio;
@@ -16,6 +18,7 @@ void signal_handler(int s)
         g_pServer->Stop();
 }
 
+
 int main(int argc, char* argv[])
 {
     try
@@ -25,24 +28,80 @@ int main(int argc, char* argv[])
         uint16_t port = 6000;
         bool data_emulation = true;//false;
         bool ext_vwap = true;
-
-        if (argc >= 2)
-            port = static_cast<uint16_t>(std::atoi(argv[1]));
-
-        if (argc >= 3)
-            data_emulation = static_cast<bool>(std::atoi(argv[2]));
-
-        if (argc >= 4)
-            ext_vwap = static_cast<bool>(std::atoi(argv[3]));
-
-
-        Server server(io, 6000);
+        double express_notional = 0;
+        uint32_t vwap_interval_ms = VWAP_INTERVAL_MS;
+        std::string mcast_group;
+        uint16_t mcast_port = 0;    // 0 - no multicast
+        std::string mcast_iface;
+        std::string shm_name;
+        bool shm_market = false;
+        uint32_t io_threads = 0;    // 0 - sessions on the main thread
+        int io_first_core = -1;
+        std::string socket_profile; // "nodelay=1,sndbuf=...,rcvbuf=...,busypoll=50,quickack=1,txts=1"
+        std::string feed_record;    // capture file of the raw Binance messages (emul 0)
+        std::string feed_url;       // trade stream URL (emul 0), empty - Binance futures; one per feed line, comma-separated
+        uint32_t feed_shards = 1;   // exchange connections (emul 0), the coins are split between them
+        int feed_first_core = -1;
+        std::string backfill_url;   // REST base URL for missed trades (emul 0), e.g. https://fapi.binance.com, empty - off
+        uint32_t feed_lines = 1;    // redundant copies of every exchange connection (emul 0), the first copy of a trade wins
+
+        const CommandLineOption options[] =
+        {
+            { "port",               "listening port (6000)",                                                    NumberOption(port) },
+            { "emulation",          "1 - emulated trades (default), 0 - the exchange stream",                   FlagOption(data_emulation) },
+            { "vwap_roll",          "1 - rolling VWAP in the server (default), 0 - off",                        FlagOption(ext_vwap) },
+            { "express_notional",   "USD notional of the express lane, 0 - off",                                NumberOption(express_notional) },
+            { "vwap_interval_ms",   "VWAP ticker interval, 0 - off",                                            NumberOption(vwap_interval_ms) },
+            { "multicast",          "whales over UDP multicast to <group>:<port>",                              HostPortOption(mcast_group, mcast_port) },
+            { "mcast_iface",        "multicast interface address",                                              TextOption(mcast_iface) },
+            { "shm_name",           "shared-memory channel <name>.whales",                                      TextOption(shm_name) },
+            { "shm_market",         "1 - every trade to <shm_name>.market too",                                 FlagOption(shm_market) },
+            { "io_threads",         "session I/O threads, 0 - the main thread",                                 NumberOption(io_threads) },
+            { "io_first_core",      "first core of the I/O threads, -1 - not pinned",                           NumberOption(io_first_core) },
+            { "socket_profile",     "session socket options, e.g. nodelay=1,sndbuf=4194304,busypoll=50,txts=1", TextOption(socket_profile) },
+            { "feed_record",        "capture file of the raw exchange messages",                                TextOption(feed_record) },
+            { "feed_url",           "trade stream URL, one per feed line, comma-separated",                     TextOption(feed_url) },
+            { "feed_shards",        "exchange connections, the coins are split between them",                  NumberOption(feed_shards) },
+            { "feed_first_core",    "first core of the feed connections, -1 - not pinned",                      NumberOption(feed_first_core) },
+            { "backfill_url",       "REST base URL for missed trades, e.g. https://fapi.binance.com",           TextOption(backfill_url) },
+            { "feed_lines",         "redundant copies of every exchange connection (A/B lines)",                NumberOption(feed_lines) },
+        };
+
+        // "Server 5000 0 1" (port, emulation, vwap_roll) as before, then "--name=value" in any order
+        switch (ParseCommandLine(argc, argv, "Server", options, 3))
+        {
+        case ECommandLine::Help:
+            return 0;
+        case ECommandLine::Error:
+            return 1;
+        default:
+            break;
+        }
+
+
+        Server server(io, port, io_threads, io_first_core);
         g_pServer = &server;
 
         signal(SIGINT, signal_handler);
 
         server.EnableDataEmulation(data_emulation);
         server.SetExtCalcVWAP(ext_vwap);
+        server.SetExpressNotional(express_notional);
+        server.SetVwapInterval(vwap_interval_ms);
+        server.SetSocketProfile(ParseSocketProfile(socket_profile));
+
+        if (mcast_port != 0)
+            server.EnableMulticast(mcast_group, mcast_port, mcast_iface);
+        if (!shm_name.empty())
+            server.EnableShm(shm_name, shm_market);
+        if (!feed_url.empty())
+            server.SetFeedUrl(feed_url);
+        server.SetFeedShards(feed_shards, feed_first_core);
+        server.SetFeedLines(feed_lines);
+        if (!feed_record.empty())
+            server.EnableFeedRecord(feed_record);
+        if (!backfill_url.empty() && !data_emulation)
+            server.EnableTradeBackfill(std::make_unique<RestTradeSource>(backfill_url));
         server.EnableShowLogMsg(true);
 
         server.Start();
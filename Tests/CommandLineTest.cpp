@@ -0,0 +1,99 @@
+// CommandLineTest.cpp
+
+#include <gtest/gtest.h>
+#include <CommandLine.h>
+#include <string>
+#include <vector>
+
+
+// the server's first options: port, emulation, vwap_roll, then named-only ones
+struct ServerArgs
+{
+    uint16_t port = 6000;
+    bool emulation = true;
+    bool vwap_roll = true;
+    double notional = 0;
+    std::string mcast_group;
+    uint16_t mcast_port = 0;
+
+    ECommandLine Parse(std::vector<std::string> args)
+    {
+        const CommandLineOption options[] =
+        {
+            { "port",               "", NumberOption(port) },
+            { "emulation",          "", FlagOption(emulation) },
+            { "vwap_roll",          "", FlagOption(vwap_roll) },
+            { "express_notional",   "", NumberOption(notional, 0.0) },
+            { "multicast",          "", HostPortOption(mcast_group, mcast_port) },
+        };
+
+        args.insert(args.begin(), "Server");
+        std::vector<char*> argv;
+        for (std::string& a : args)
+            argv.push_back(a.data());
+
+        return ParseCommandLine(static_cast<int>(argv.size()), argv.data(), "Server", options, 3);
+    }
+};
+
+
+TEST(CommandLineTest, PositionalThenNamed) {
+    ServerArgs a;
+    EXPECT_EQ(a.Parse({ "5000", "0", "1" }), ECommandLine::Run);
+    EXPECT_EQ(a.port, 5000);
+    EXPECT_FALSE(a.emulation);
+    EXPECT_TRUE(a.vwap_roll);
+
+    ServerArgs b;
+    EXPECT_EQ(b.Parse({ "5001", "--express_notional=250000.5", "--multicast=239.255.0.1:7000" }), ECommandLine::Run);
+    EXPECT_EQ(b.port, 5001);
+    EXPECT_TRUE(b.emulation);
+    EXPECT_DOUBLE_EQ(b.notional, 250000.5);
+    EXPECT_EQ(b.mcast_group, "239.255.0.1");
+    EXPECT_EQ(b.mcast_port, 7000);
+
+    ServerArgs c;
+    EXPECT_EQ(c.Parse({ "--vwap_roll=0", "--port=5002" }), ECommandLine::Run);
+    EXPECT_EQ(c.port, 5002);
+    EXPECT_FALSE(c.vwap_roll);
+}
+
+TEST(CommandLineTest, RejectsBadInput) {
+    const std::vector<std::vector<std::string>> bad =
+    {
+        { "70000" },                                // port out of range
+        { "5000x" },                                // trailing characters
+        { "5000", "2" },                            // flag is 0 or 1
+        { "5000", "0", "1", "1" },                  // a fourth bare argument
+        { "--port=5000", "0" },                     // bare after named
+        { "--port" },                               // no value
+        { "--ports=5000" },                         // unknown
+        { "--express_notional=-1" },                // below the minimum
+        { "--multicast=239.255.0.1" },              // no port
+        { "--multicast=239.255.0.1:0" },
+        { "--multicast=239.255.0.1:65536" },
+        { "--multicast=239.255.0.1:7000x" },
+    };
+
+    for (const auto& args : bad)
+    {
+        ServerArgs a;
+        EXPECT_EQ(a.Parse(args), ECommandLine::Error) << args.back();
+    }
+
+    ServerArgs h;
+    EXPECT_EQ(h.Parse({ "5000", "--help" }), ECommandLine::Help);
+}
+
+TEST(CommandLineTest, EnumRange) {
+    enum class EPolicy : uint8_t { A = 0, B = 1, C = 2 };
+    EPolicy policy = EPolicy::A;
+    auto set = EnumOption(policy, EPolicy::A, EPolicy::C);
+
+    EXPECT_TRUE(set("2"));
+    EXPECT_EQ(policy, EPolicy::C);
+    EXPECT_FALSE(set("3"));
+    EXPECT_FALSE(set("-1"));
+    EXPECT_FALSE(set("256"));
+    EXPECT_EQ(policy, EPolicy::C);
+}
@@ -0,0 +1,154 @@
+// DeltaCodecTest.cpp
+
+#include <gtest/gtest.h>
+#include "FrameEncoder.h"
+#include "DeltaCodec.h"
+#include <chrono>
+#include <random>
+#include <vector>
+
+
+// a realistic whale stream: few symbols, price random walk on 0.01 ticks, ms timestamps
+static std::vector<SWhaleRecordV2> make_records(size_t cnt)
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> tick(-50, 50);
+    std::uniform_int_distribution<int> lots(1, 500000);
+    std::uniform_int_distribution<int> dt(0, 40);
+
+    std::vector<SWhaleRecordV2> recs(cnt);
+    double price = 96000.00;
+    uint64_t ts = 1700000000000ULL;
+
+    for (size_t i = 0; i < cnt; i++)
+    {
+        SWhaleRecordV2& r = recs[i];
+        r = SWhaleRecordV2{};
+
+        price += tick(rng) * 0.01;
+        ts += dt(rng);
+
+        r.price = price;
+        r.quantity = lots(rng) * 0.00001;
+        r.timestamp = ts;
+        r.vwap_sess = price - 12.34;
+        r.vwap_roll50 = price + 0.56;
+        r.delta_roll = static_cast<float>(r.price - r.vwap_roll50);
+        r.symbol = static_cast<uint32_t>(i % 3);
+        r.is_sell = static_cast<uint8_t>(i & 1);
+        r.seq = 1000 + i / 3;
+    }
+    return recs;
+}
+
+
+TEST(DeltaCodecTest, Varint) {
+    const uint64_t values[] = { 0, 1, 127, 128, 16383, 16384, 1ULL << 35, ~0ULL };
+
+    for (uint64_t v : values)
+    {
+        uint8_t buf[VARINT_MAX];
+        uint8_t* end = put_varint(buf, v);
+
+        uint64_t out = 0;
+        EXPECT_EQ(get_varint(buf, end, out), end);
+        EXPECT_EQ(out, v);
+
+        // truncated
+        EXPECT_EQ(get_varint(buf, end - 1, out), nullptr);
+    }
+
+    const int64_t signed_values[] = { 0, -1, 1, -64, 64, INT64_MIN, INT64_MAX };
+    for (int64_t v : signed_values)
+        EXPECT_EQ(unzigzag(zigzag(v)), v);
+}
+
+TEST(DeltaCodecTest, RoundTrip) {
+    auto recs = make_records(512);
+
+    std::vector<uint8_t> buf(DeltaBatchMaxSize(recs.size()));
+    size_t size = EncodeDeltaBatch(buf.data(), recs.data(), recs.size());
+
+    std::vector<SWhaleRecordV2> out(recs.size());
+    size_t cnt = 0;
+    ASSERT_TRUE(DecodeDeltaBatch(buf.data(), size, out.data(), out.size(), cnt));
+    ASSERT_EQ(cnt, recs.size());
+
+    // exact at exchange precision (8 decimals)
+    for (size_t i = 0; i < cnt; i++)
+    {
+        EXPECT_EQ(to_fx(out[i].price), to_fx(recs[i].price));
+        EXPECT_EQ(to_fx(out[i].quantity), to_fx(recs[i].quantity));
+        EXPECT_EQ(to_fx(out[i].vwap_sess), to_fx(recs[i].vwap_sess));
+        EXPECT_EQ(to_fx(out[i].vwap_roll50), to_fx(recs[i].vwap_roll50));
+        EXPECT_NEAR(out[i].delta_roll, recs[i].delta_roll, 1e-3);
+        EXPECT_EQ(out[i].timestamp, recs[i].timestamp);
+        EXPECT_EQ(out[i].symbol, recs[i].symbol);
+        EXPECT_EQ(out[i].is_sell, recs[i].is_sell);
+        EXPECT_EQ(out[i].seq, recs[i].seq);
+    }
+
+    // malformed input is rejected
+    EXPECT_FALSE(DecodeDeltaBatch(buf.data(), size - 1, out.data(), out.size(), cnt));
+    EXPECT_FALSE(DecodeDeltaBatch(buf.data(), size, out.data(), out.size() - 1, cnt));
+}
+
+TEST(DeltaCodecTest, Benchmark) {
+    constexpr size_t BATCH = 16;
+    constexpr size_t BATCHES = 50'000;
+
+    auto recs = make_records(BATCH * 64);
+
+    SymbolWire symbols[3];
+    symbols[0].Set("BTCUSDT");
+    symbols[1].Set("ETHUSDT");
+    symbols[2].Set("SOLUSDT");
+
+    // bytes per event on the wire (records only, the frame header is the same for all)
+    std::vector<WhaleEvent> events(recs.size());
+    for (size_t i = 0; i < recs.size(); i++)
+    {
+        std::memset(&events[i], 0, sizeof(WhaleEvent));
+        events[i].price = recs[i].price;
+        events[i].quantity = recs[i].quantity;
+        events[i].timestamp = recs[i].timestamp;
+        events[i].index_symbol = static_cast<int>(recs[i].symbol);
+    }
+
+    std::vector<uint8_t> v1(WhaleRecordsV1MaxSize(BATCH));
+    std::vector<uint8_t> buf(DeltaBatchMaxSize(BATCH));
+    std::vector<SWhaleRecordV2> out(BATCH);
+
+    size_t bytes_v1 = 0, bytes_delta = 0;
+    for (size_t b = 0; b < recs.size() / BATCH; b++)
+    {
+        bytes_v1 += EncodeWhaleRecordsV1(v1.data(), events.data() + b * BATCH, BATCH, symbols, 3);
+        bytes_delta += EncodeDeltaBatch(buf.data(), recs.data() + b * BATCH, BATCH);
+    }
+
+    // encode / decode speed
+    uint64_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < BATCHES; b++)
+        sink += EncodeDeltaBatch(buf.data(), recs.data() + (b % 64) * BATCH, BATCH);
+    auto encode_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    size_t size = EncodeDeltaBatch(buf.data(), recs.data(), BATCH);
+    size_t cnt = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < BATCHES; b++)
+    {
+        DecodeDeltaBatch(buf.data(), size, out.data(), out.size(), cnt);
+        sink += cnt;
+    }
+    auto decode_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "[          ] Bytes/event: v1 " << (double)bytes_v1 / recs.size()
+        << " | v2 " << sizeof(SWhaleRecordV2)
+        << " | delta " << (double)bytes_delta / recs.size() << std::endl;
+    std::cout << "[          ] Delta (" << BATCH << " whales/batch): encode " << (double)encode_ns / (BATCHES * BATCH)
+        << " ns/event | decode " << (double)decode_ns / (BATCHES * BATCH) << " ns/event" << std::endl;
+
+    EXPECT_GT(sink, 0u);
+    EXPECT_LT(bytes_delta, bytes_v1);
+}
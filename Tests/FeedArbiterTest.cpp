@@ -0,0 +1,158 @@
+// FeedArbiterTest.cpp
+
+#include <gtest/gtest.h>
+#include "Server.h"
+#include "FeedArbiter.h"
+#include <boost/asio.hpp>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+
+TEST(FeedArbiterTest, FirstCopyWins) {
+    FeedArbiter arb(2);
+    uint64_t behind = 0;
+
+    EXPECT_TRUE(arb.Arbitrate(0, 5001, 1000, behind));
+    EXPECT_FALSE(arb.Arbitrate(0, 5001, 1300, behind));
+    EXPECT_EQ(behind, 300u);
+
+    // the lines may lead in turn, symbols are independent
+    EXPECT_TRUE(arb.Arbitrate(0, 5003, 2000, behind));
+    EXPECT_TRUE(arb.Arbitrate(0, 5002, 2100, behind));
+    EXPECT_FALSE(arb.Arbitrate(0, 5003, 2050, behind));
+    EXPECT_EQ(behind, 50u);
+    EXPECT_TRUE(arb.Arbitrate(1, 5001, 2200, behind));
+
+    // a copy that was received earlier but lost the race has no delay
+    EXPECT_FALSE(arb.Arbitrate(0, 5002, 2090, behind));
+    EXPECT_EQ(behind, 0u);
+
+    // the slot moved on: an id FEED_ARB_SLOTS older is dropped
+    EXPECT_TRUE(arb.Arbitrate(0, 5001 + FEED_ARB_SLOTS, 3000, behind));
+    EXPECT_FALSE(arb.Arbitrate(0, 5001, 3100, behind));
+    EXPECT_EQ(behind, 0u);
+}
+
+// two local feed lines replay the same trades on a shared schedule (one every 2 us), each on its own thread; line B
+// is held back 50 us on the first half and line A on the second. Every trade must come out exactly once.
+TEST(FeedArbiterTest, RacingLines) {
+    constexpr uint64_t TRADES = 100'000;
+    constexpr int SYMBOLS = 4;
+
+    FeedArbiter arb(SYMBOLS);
+    uint64_t wins[2] = {}, copies[2] = {}, behind_sum[2] = {};
+    const auto start = std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
+
+    auto line = [&](int l)
+    {
+        uint64_t behind = 0;
+        for (uint64_t i = 0; i < TRADES; i++)
+        {
+            // injected delay of the slow line of this half
+            const bool slow = (i < TRADES / 2) == (l == 1);
+            const auto due = start + std::chrono::microseconds(2 * i + (slow ? 50 : 0));
+            while (std::chrono::steady_clock::now() < due)
+                _mm_pause();
+
+            if (arb.Arbitrate(static_cast<int>(i % SYMBOLS), 1'000'000 + i / SYMBOLS, __rdtsc(), behind))
+            {
+                wins[l]++;
+            }
+            else
+            {
+                copies[l]++;
+                behind_sum[l] += behind;
+            }
+        }
+    };
+
+    std::thread a(line, 0), b(line, 1);
+    a.join();
+    b.join();
+
+    std::printf("[          ] A %.1f%% B %.1f%% of the first copies, copies behind: A %.0f B %.0f ticks\n",
+        100.0 * wins[0] / TRADES, 100.0 * wins[1] / TRADES,
+        copies[0] ? static_cast<double>(behind_sum[0]) / copies[0] : 0.0, copies[1] ? static_cast<double>(behind_sum[1]) / copies[1] : 0.0);
+    EXPECT_EQ(wins[0] + wins[1], TRADES);
+    EXPECT_EQ(copies[0] + copies[1], TRADES);
+    EXPECT_GT(wins[0], TRADES / 10);
+    EXPECT_GT(wins[1], TRADES / 10);
+}
+
+TEST(FeedArbiterTest, ServerLines) {
+    boost::asio::io_context io;
+    Server server(io, 0);
+    server.EnableShowLogMsg(false);
+    server.SetFeedLines(2);
+
+    FeedShard a, b;
+    a.line = 0;
+    b.line = 1;
+
+    const std::string msg1 = R"({"e":"trade","E":1700000000001,"s":"BTCUSDT","t":77,"p":"96000.1","q":"0.5","m":true})";
+    const std::string msg2 = R"({"e":"trade","E":1700000000002,"s":"BTCUSDT","t":78,"p":"96000.2","q":"0.5","m":true})";
+
+    // the same trade on both lines: parsed twice, forwarded once
+    EXPECT_EQ(server.ProcessMarketMsg(msg1, msg1.size(), 10'000, &a), 1u);
+    EXPECT_EQ(server.ProcessMarketMsg(msg1, msg1.size(), 10'250, &b), 1u);
+    EXPECT_EQ(server.ProcessMarketMsg(msg2, msg2.size(), 11'000, &b), 1u);
+    EXPECT_EQ(server.ProcessMarketMsg(msg2, msg2.size(), 11'100, &a), 1u);
+
+    EXPECT_EQ(a.wins.load(), 1u);
+    EXPECT_EQ(b.wins.load(), 1u);
+    EXPECT_EQ(b.copies.load(), 1u);
+    EXPECT_EQ(b.behind_ticks.load(), 250u);
+    EXPECT_EQ(a.behind_ticks.load(), 100u);
+}
+
+// the connections of the shard and line settings, built without opening them
+TEST(FeedArbiterTest, ShardPlan) {
+    boost::asio::io_context io;
+    Server server(io, 0);
+    server.EnableShowLogMsg(false);
+
+    // defaults: one connection, every coin, the plain stream URL -> combined stream
+    server.SetFeedUrl("wss://fstream.binance.com/ws");
+    server.InitFeedShards();
+    ASSERT_EQ(server.GetFeedShards().size(), 1u);
+    EXPECT_EQ(server.GetFeedShards()[0]->name, "");
+    EXPECT_EQ(server.GetFeedShards()[0]->url, "wss://fstream.binance.com/stream?streams=btcusdt@trade/ethusdt@trade/solusdt@trade/bnbusdt@trade");
+
+    // 2 shards x 2 lines: coin i -> shard i % 2, the lines of a shard next to each other, line i -> i-th URL, the query kept
+    server.SetFeedShards(2, 4);
+    server.SetFeedLines(2);
+    server.SetFeedUrl("ws://127.0.0.1:9443/ws?delay=50,ws://127.0.0.2:9443/ws");
+    server.InitFeedShards();
+
+    const auto& shards = server.GetFeedShards();
+    ASSERT_EQ(shards.size(), 4u);
+
+    const char* names[] = { "#0A", "#0B", "#1A", "#1B" };
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        EXPECT_EQ(shards[i]->id, static_cast<int>(i));
+        EXPECT_EQ(shards[i]->line, static_cast<int>(i % 2));
+        EXPECT_EQ(shards[i]->name, names[i]);
+        EXPECT_EQ(shards[i]->core, 4 + static_cast<int>(i));
+        EXPECT_EQ(shards[i]->status.load(), EFeedStatus::Down);
+        EXPECT_EQ(shards[i]->ws, nullptr);
+    }
+
+    EXPECT_EQ(shards[0]->coins, (std::vector<int>{ 0, 2 }));
+    EXPECT_EQ(shards[3]->coins, (std::vector<int>{ 1, 3 }));
+    EXPECT_EQ(shards[0]->url, "ws://127.0.0.1:9443/stream?streams=btcusdt@trade/solusdt@trade&delay=50");
+    EXPECT_EQ(shards[1]->url, "ws://127.0.0.2:9443/stream?streams=btcusdt@trade/solusdt@trade");
+    EXPECT_EQ(shards[2]->url, "ws://127.0.0.1:9443/stream?streams=ethusdt@trade/bnbusdt@trade&delay=50");
+    EXPECT_EQ(shards[3]->url, "ws://127.0.0.2:9443/stream?streams=ethusdt@trade/bnbusdt@trade");
+
+    // more shards than coins: one coin per connection, one URL for both lines
+    server.SetFeedShards(9);
+    server.SetFeedUrl("ws://127.0.0.1:9443/ws");
+    server.InitFeedShards();
+    ASSERT_EQ(server.GetFeedShards().size(), 8u);
+    EXPECT_EQ(server.GetFeedShards()[7]->url, "ws://127.0.0.1:9443/stream?streams=bnbusdt@trade");
+    EXPECT_EQ(server.GetFeedShards()[7]->core, -1);
+}
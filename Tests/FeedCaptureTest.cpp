@@ -0,0 +1,121 @@
+// FeedCaptureTest.cpp
+
+#include <gtest/gtest.h>
+#include "Server.h"
+#include "FeedCapture.h"
+#include <boost/asio.hpp>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+
+static std::string capture_path(const char* name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+TEST(FeedCaptureTest, RecordAndReplay) {
+    const std::string path = capture_path("feed_capture_test.cap");
+
+    const std::vector<std::string> msgs =
+    {
+        R"({"result":null,"id":1})",
+        R"({"e":"trade","E":1700000000001,"T":1700000000000,"s":"BTCUSDT","t":1,"p":"96000.10","q":"3.5","X":"MARKET","m":true})",
+        R"({"stream":"ethusdt@trade","data":[{"e":"trade","E":2,"s":"ETHUSDT","t":2,"p":"2700.5","q":"1.25","m":false},{"e":"trade","E":3,"s":"XRPUSDT","t":3,"p":"0.5","q":"10","m":false}]})",
+    };
+
+    {
+        FeedRecorder rec;
+        ASSERT_TRUE(rec.Open(path, 3.0, 1000));
+        for (size_t i = 0; i < msgs.size(); i++)
+            rec.Add(2000 + i, msgs[i]);
+        EXPECT_EQ(rec.GetFrameCount(), msgs.size());
+    }
+
+    FeedCaptureReader reader(path);
+    EXPECT_EQ(reader.GetHeader().tsc_ghz, 3.0);
+    EXPECT_EQ(reader.GetHeader().start_tsc, 1000u);
+
+    FeedCaptureReader::Frame f;
+    for (size_t i = 0; i < msgs.size(); i++)
+    {
+        ASSERT_TRUE(reader.Next(f));
+        EXPECT_EQ(f.tick_rcvd, 2000 + i);
+        EXPECT_EQ(f.payload, msgs[i]);
+        EXPECT_GE(f.capacity, f.payload.size() + FEED_CAPTURE_TAIL);
+    }
+    EXPECT_FALSE(reader.Next(f));
+
+    // replayed in place through the ingest path (the subscribe answer has no trades)
+    boost::asio::io_context io;
+    Server server(io, 0);
+    server.EnableShowLogMsg(false);
+
+    size_t trades = 0;
+    reader.Rewind();
+    while (reader.Next(f))
+        trades += server.ProcessMarketMsg(f.payload, f.capacity, f.tick_rcvd);
+    EXPECT_EQ(trades, 3u);
+
+    // a capture cut short ends at its last complete frame
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - FEED_CAPTURE_TAIL - 8);
+    FeedCaptureReader cut(path);
+    size_t cnt = 0;
+    while (cut.Next(f))
+        cnt++;
+    EXPECT_EQ(cnt, msgs.size() - 1);
+
+    std::filesystem::remove(path);
+}
+
+// several blocks and a payload above the block size: the recorder's thread writes the full blocks while Add() goes on,
+// the file keeps the order
+TEST(FeedCaptureTest, BlocksWrittenByRecorderThread) {
+    const std::string path = capture_path("feed_capture_blocks.cap");
+    constexpr size_t MSGS = 40'000;
+
+    char text[256];
+    auto make_msg = [&](size_t i)
+    {
+        const int len = std::snprintf(text, sizeof(text), R"({"e":"trade","E":%zu,"s":"BTCUSDT","t":%zu,"p":"96000.10","q":"0.%zu","m":true})", i, i, i);
+        return std::string(text, static_cast<size_t>(len));
+    };
+    const std::string big(FeedRecorder::BUFFER_SIZE * 2 + 5, 'x');
+
+    {
+        FeedRecorder rec;
+        ASSERT_TRUE(rec.Open(path, 3.0, 1000));
+        for (size_t i = 0; i < MSGS / 2; i++)
+            rec.Add(i, make_msg(i));
+        rec.Add(MSGS / 2, big);
+        for (size_t i = MSGS / 2; i < MSGS; i++)
+            rec.Add(i + 1, make_msg(i));
+
+        // the full blocks reach the file before Close()
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (std::filesystem::file_size(path) < FeedRecorder::BUFFER_SIZE * 3 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        EXPECT_GE(std::filesystem::file_size(path), FeedRecorder::BUFFER_SIZE * 3);
+
+        EXPECT_EQ(rec.GetFrameCount(), MSGS + 1);
+        EXPECT_EQ(rec.GetWriterWaits(), 0u);
+    }
+
+    FeedCaptureReader reader(path);
+    FeedCaptureReader::Frame f;
+    for (size_t i = 0; i <= MSGS; i++)
+    {
+        ASSERT_TRUE(reader.Next(f)) << i;
+        EXPECT_EQ(f.tick_rcvd, i);
+        if (i == MSGS / 2)
+            EXPECT_EQ(f.payload, big);
+        else
+            ASSERT_EQ(f.payload, make_msg(i < MSGS / 2 ? i : i - 1));
+    }
+    EXPECT_FALSE(reader.Next(f));
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,305 @@
+// FrameEncoderTest.cpp
+
+#include <gtest/gtest.h>
+#include "FrameEncoder.h"
+#include "FramePool.h"
+#include "LoopbackServer.h"
+#include <boost/asio.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+
+// global allocation counter (active only inside the measured section)
+static std::atomic<bool> g_count_alloc{ false };
+static std::atomic<uint64_t> g_alloc_cnt{ 0 };
+
+void* operator new(std::size_t size)
+{
+    if (g_count_alloc.load(std::memory_order_relaxed))
+        g_alloc_cnt.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+
+static double read_f64_be(const uint8_t* p)
+{
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    v = net_to_host_u64(v);
+    double d;
+    std::memcpy(&d, &v, 8);
+    return d;
+}
+
+static std::vector<WhaleEvent> make_events(size_t cnt)
+{
+    std::vector<WhaleEvent> events(cnt);
+    for (size_t i = 0; i < cnt; i++)
+    {
+        WhaleEvent& we = events[i];
+        std::memset(&we, 0, sizeof(we));
+        we.price = 96000.5 + i;
+        we.quantity = 2.25;
+        we.is_sell = (i & 1);
+        we.timestamp = 1700000000000ULL + i;
+        we.index_symbol = static_cast<int>(i % 2);
+        we.vwap_sess = 95999.0;
+        we.vwap_roll50 = 96000.0;
+        we.delta_roll = 0.5f;
+    }
+    return events;
+}
+
+
+TEST(FrameEncoderTest, EncodeV1Layout) {
+    SymbolWire symbols[2];
+    symbols[0].Set("BTCUSDT");
+    symbols[1].Set("ETHUSDT");
+
+    auto events = make_events(2);
+
+    // as a session writes it: its own head + the shared records
+    std::vector<uint8_t> buf(WHALE_FRAME_HEAD_SIZE + WhaleRecordsV1MaxSize(events.size()));
+    size_t size = WHALE_FRAME_HEAD_SIZE + EncodeWhaleRecordsV1(buf.data() + WHALE_FRAME_HEAD_SIZE, events.data(), events.size(), symbols, 2);
+    EncodeWhaleFrameHeadV1(buf.data(), static_cast<uint32_t>(events.size()), size - WHALE_FRAME_HEAD_SIZE, 0);
+
+    SProtocolHeader hdr;
+    std::memcpy(&hdr, buf.data(), sizeof(hdr));
+    EXPECT_EQ(net_to_host_u16(hdr.signature), PROTOCOL_HEADER_SIGNATURE);
+    EXPECT_EQ(hdr.version, 1);
+    EXPECT_EQ(hdr.data_type, 0x02);
+    EXPECT_EQ(net_to_host_u32(hdr.len), size - sizeof(hdr));
+
+    const uint8_t* p = buf.data() + sizeof(hdr);
+    uint32_t cnt;
+    std::memcpy(&cnt, p, 4);
+    EXPECT_EQ(net_to_host_u32(cnt), 2u);
+    p += 4;
+
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        EXPECT_DOUBLE_EQ(read_f64_be(p), events[i].price); p += 8;
+        EXPECT_DOUBLE_EQ(read_f64_be(p), events[i].quantity); p += 8;
+        EXPECT_EQ(*p++, static_cast<uint8_t>(events[i].is_sell));
+
+        uint64_t ts;
+        std::memcpy(&ts, p, 8);
+        EXPECT_EQ(net_to_host_u64(ts), events[i].timestamp);
+        p += 8;
+
+        uint16_t len;
+        std::memcpy(&len, p, 2);
+        len = net_to_host_u16(len);
+        p += 2;
+        EXPECT_EQ(std::string((const char*)p, len), i == 0 ? "BTCUSDT" : "ETHUSDT");
+        p += len;
+
+        EXPECT_DOUBLE_EQ(read_f64_be(p), events[i].vwap_sess); p += 8;
+        EXPECT_DOUBLE_EQ(read_f64_be(p), events[i].vwap_roll50); p += 8;
+        EXPECT_DOUBLE_EQ(read_f64_be(p), 0.5); p += 8;
+    }
+
+    EXPECT_EQ(static_cast<size_t>(p - buf.data()), size);
+}
+
+TEST(FrameEncoderTest, SharedSegmentHeads) {
+    SymbolWire symbols[2];
+    symbols[0].Set("BTCUSDT");
+    symbols[1].Set("ETHUSDT");
+
+    auto events = make_events(64);
+
+    FramePool pool;
+    Frame* segment = pool.Acquire(WhaleRecordsV1MaxSize(events.size()));
+    segment->size = EncodeWhaleRecordsV1(segment->data(), events.data(), events.size(), symbols, 2);
+    segment->count = static_cast<uint32_t>(events.size());
+
+    // the heads of two sessions differ in their msg_num only
+    uint8_t head[WHALE_FRAME_HEAD_SIZE], head2[WHALE_FRAME_HEAD_SIZE];
+    EncodeWhaleFrameHeadV1(head, segment->count, segment->size, 7);
+    ASSERT_EQ(EncodeSegmentHead(head2, *segment, 9), WHALE_FRAME_HEAD_SIZE);
+
+    SProtocolHeader hdr;
+    std::memcpy(&hdr, head, sizeof(hdr));
+    EXPECT_EQ(hdr.msg_num, 7);
+    EXPECT_EQ(net_to_host_u32(hdr.len), 4 + segment->size);
+    StampMsgNum(head2, 7);
+    EXPECT_EQ(0, std::memcmp(head, head2, sizeof(head)));
+
+    // one segment queued by 3 sessions returns to the pool after the last release
+    FramePool::AddRef(segment, 3);
+    FramePool::Release(segment);   // encoder
+    FramePool::Release(segment);
+    FramePool::Release(segment);
+    EXPECT_EQ(pool.GetFreeCount(), 0u);
+    FramePool::Release(segment);
+    EXPECT_EQ(pool.GetFreeCount(), 1u);
+}
+
+TEST(FrameEncoderTest, EncodeV2Records) {
+    SymbolWire symbols[2];
+    symbols[0].Set("BTCUSDT");
+    symbols[1].Set("ETHUSDT");
+
+    auto events = make_events(3);
+
+    FramePool pool;
+    Frame* segment = pool.Acquire(WhaleRecordsV2Size(events.size()));
+    segment->size = EncodeWhaleRecordsV2(segment->data(), events.data(), events.size());
+    segment->count = static_cast<uint32_t>(events.size());
+    segment->version = PROTOCOL_VERSION_2;
+
+    ASSERT_EQ(segment->size, 3 * sizeof(SWhaleRecordV2));
+
+    // records are read back as is
+    const SWhaleRecordV2* rec = reinterpret_cast<const SWhaleRecordV2*>(segment->data());
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        EXPECT_EQ(rec[i].price, events[i].price);
+        EXPECT_EQ(rec[i].quantity, events[i].quantity);
+        EXPECT_EQ(rec[i].timestamp, events[i].timestamp);
+        EXPECT_EQ(rec[i].vwap_sess, events[i].vwap_sess);
+        EXPECT_EQ(rec[i].vwap_roll50, events[i].vwap_roll50);
+        EXPECT_EQ(rec[i].delta_roll, events[i].delta_roll);
+        EXPECT_EQ(rec[i].symbol, static_cast<uint32_t>(events[i].index_symbol));
+        EXPECT_EQ(rec[i].is_sell, static_cast<uint8_t>(events[i].is_sell));
+    }
+
+    // v2 head: header only, len = records
+    uint8_t head[FRAME_HEAD_MAX_SIZE];
+    ASSERT_EQ(EncodeSegmentHead(head, *segment, 5), sizeof(SProtocolHeader));
+    SProtocolHeader hdr;
+    std::memcpy(&hdr, head, sizeof(hdr));
+    EXPECT_EQ(hdr.version, PROTOCOL_VERSION_2);
+    EXPECT_EQ(hdr.data_type, MSG_DATA);
+    EXPECT_EQ(hdr.msg_num, 5);
+    EXPECT_EQ(net_to_host_u32(hdr.len), segment->size);
+
+    // dictionary
+    std::vector<uint8_t> dict(SymbolDictV2MaxSize(2));
+    size_t dict_size = EncodeSymbolDictV2(dict.data(), symbols, 2);
+
+    uint32_t cnt;
+    std::memcpy(&cnt, dict.data(), 4);
+    EXPECT_EQ(cnt, 2u);
+
+    uint32_t index;
+    std::memcpy(&index, dict.data() + 4 + 4 + 1 + 7, 4);
+    EXPECT_EQ(index, 1u);
+    EXPECT_EQ(dict[4 + 4 + 1 + 7 + 4], 7);
+    EXPECT_EQ(std::string((const char*)dict.data() + 4 + 4 + 1 + 7 + 4 + 1, 7), "ETHUSDT");
+    EXPECT_EQ(dict_size, 4u + 2 * (4 + 1 + 7));
+
+    FramePool::Release(segment);
+}
+
+// Session::DeliverSegment -> drain on the strand -> gather write -> completion, over a loopback socket
+// (the session's io thread and a reader thread run too): no heap allocation on any thread once warm
+TEST(FrameEncoderTest, ZeroAllocSteadyState) {
+    LoopbackServer lb;
+    Server& server = lb.GetServer();
+    auto [client, session] = lb.Connect(false);
+
+    auto events = make_events(64);
+
+    std::atomic<bool> stop{ false };
+    std::atomic<uint64_t> received{ 0 };
+    std::thread reader([&client, &stop, &received]()
+        {
+            std::vector<uint8_t> buf(256 * 1024);
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                boost::system::error_code ec;
+                size_t n = client.read_some(boost::asio::buffer(buf), ec);
+                if (ec)
+                    break;
+                received.fetch_add(n, std::memory_order_relaxed);
+            }
+        });
+
+    // as Server::deliver_coin_batch does for one session; waits until the client has the frame
+    uint64_t sent = 0;
+    auto deliver_batch = [&]()
+        {
+            Frame* segment = lb.GetPool().Acquire(WhaleRecordsV1MaxSize(events.size()));
+            segment->size = EncodeWhaleRecordsV1(segment->data(), events.data(), events.size(), server.GetSymbolWire(), server.GetCoinCount());
+            segment->count = static_cast<uint32_t>(events.size());
+            segment->ind_symbol = 0;
+            sent += WHALE_FRAME_HEAD_SIZE + segment->size;
+
+            FramePool::AddRef(segment);
+            session->DeliverSegment(segment);
+            FramePool::Release(segment);
+
+            while (received.load(std::memory_order_relaxed) < sent)
+                std::this_thread::yield();
+        };
+
+    // warm-up: pool, session queue, handler memory, io_context internals
+    for (int i = 0; i < 64; i++)
+        deliver_batch();
+
+    g_alloc_cnt = 0;
+    g_count_alloc = true;
+
+    for (int i = 0; i < 10'000; i++)
+        deliver_batch();
+
+    g_count_alloc = false;
+
+    EXPECT_EQ(g_alloc_cnt.load(), 0u);
+    EXPECT_LE(lb.GetPool().GetFrameCount(), 2u);
+    EXPECT_EQ(session->GetDroppedCount(), 0u);
+
+    lb.Stop();
+    stop = true;
+    reader.join();
+}
+
+TEST(FrameEncoderTest, SnapshotFrameV1Layout) {
+    SymbolWire symbols[2];
+    symbols[0].Set("BTCUSDT");
+    symbols[1].Set("ETHUSDT");
+
+    CoinSnapshot snap{};
+    snap.index_symbol = 1;
+    snap.last_price = 2700.5;
+    snap.timestamp = 1700000000000ULL;
+    snap.vwap_sess = 2699.25;
+    snap.trade_cnt = 42;
+
+    std::vector<uint8_t> buf(SnapshotMaxSize(1));
+    size_t size = EncodeSnapshotV1(buf.data(), &snap, 1, symbols, 2);
+    ASSERT_EQ(size, 4u + 2 + 7 + 7 * 8);
+
+    uint32_t cnt;
+    std::memcpy(&cnt, buf.data(), 4);
+    EXPECT_EQ(net_to_host_u32(cnt), 1u);
+    EXPECT_EQ(std::string((const char*)buf.data() + 6, 7), "ETHUSDT");
+
+    uint64_t trades;
+    std::memcpy(&trades, buf.data() + size - 8, 8);
+    EXPECT_EQ(net_to_host_u64(trades), 42u);
+
+    // v2: records as is
+    size = EncodeSnapshotV2(buf.data(), &snap, 1);
+    ASSERT_EQ(size, sizeof(SSnapshotRecordV2));
+
+    SSnapshotRecordV2 r;
+    std::memcpy(&r, buf.data(), sizeof(r));
+    EXPECT_EQ(r.symbol, 1u);
+    EXPECT_EQ(r.last_price, 2700.5);
+    EXPECT_EQ(r.vwap_sess, 2699.25);
+    EXPECT_EQ(r.trade_cnt, 42u);
+}
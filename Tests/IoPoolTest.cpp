@@ -0,0 +1,246 @@
+// IoPoolTest.cpp
+
+#include <gtest/gtest.h>
+#include "IoPool.h"
+#include "LoopbackServer.h"
+#include <boost/asio.hpp>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <set>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+
+
+TEST(IoPoolTest, NextIsRoundRobin) {
+    IoPool pool(3);
+
+    std::vector<asio::io_context*> seen;
+    for (int i = 0; i < 6; i++)
+        seen.push_back(&pool.Next());
+
+    EXPECT_NE(seen[0], seen[1]);
+    EXPECT_NE(seen[1], seen[2]);
+    EXPECT_NE(seen[0], seen[2]);
+    for (int i = 0; i < 3; i++)
+        EXPECT_EQ(seen[i], seen[i + 3]);
+
+    pool.CountAccepted(*seen[1]);
+    EXPECT_EQ(pool.GetAccepted(0) + pool.GetAccepted(1) + pool.GetAccepted(2), 1u);
+}
+
+// SO_REUSEPORT listeners: connections spread over the threads, each socket is served by the thread that accepted it
+TEST(IoPoolTest, ConnectionsSpreadAndStayOnThread) {
+    if (!IoPool::HasReusePort())
+        GTEST_SKIP() << "no SO_REUSEPORT";
+
+    constexpr int CONNECTIONS = 32;
+
+    uint16_t port;
+    {
+        asio::io_context io;
+        tcp::acceptor probe(io);
+        IoPool::OpenAcceptor(probe, 0, true);
+        port = probe.local_endpoint().port();
+    }
+
+    std::mutex mtx;
+    std::set<std::thread::id> accept_threads;
+    int served = 0;
+    int moved = 0;
+
+    IoPool pool(2);
+    pool.Start(port, [&](tcp::socket socket)
+        {
+            auto s = std::make_shared<tcp::socket>(std::move(socket));
+            auto buf = std::make_shared<char>();
+            const auto accepted_on = std::this_thread::get_id();
+
+            {
+                std::lock_guard<std::mutex> lk(mtx);
+                accept_threads.insert(accepted_on);
+            }
+
+            s->async_read_some(asio::buffer(buf.get(), 1), [&, s, buf, accepted_on](boost::system::error_code, size_t)
+                {
+                    std::lock_guard<std::mutex> lk(mtx);
+                    served++;
+                    if (std::this_thread::get_id() != accepted_on)
+                        moved++;
+                });
+        });
+
+    asio::io_context client_io;
+    std::vector<tcp::socket> clients;
+    for (int i = 0; i < CONNECTIONS; i++)
+    {
+        clients.emplace_back(client_io);
+        clients.back().connect(tcp::endpoint(asio::ip::address_v4::loopback(), port));
+        asio::write(clients.back(), asio::buffer("x", 1));
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            if (served == CONNECTIONS)
+                break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    pool.CloseListeners();
+    uint64_t accepted = pool.GetAccepted(0) + pool.GetAccepted(1);
+    pool.Stop();
+
+    std::lock_guard<std::mutex> lk(mtx);
+    EXPECT_EQ(served, CONNECTIONS);
+    EXPECT_EQ(moved, 0);
+    EXPECT_EQ(accepted, static_cast<uint64_t>(CONNECTIONS));
+    EXPECT_EQ(accept_threads.size(), 2u);
+}
+
+// whale frames delivered per second by sessions spread over 'threads' I/O threads (SO_REUSEPORT listeners):
+// one producer plays event_dispatcher and hands the same segment to every session, a blocking reader per client
+static double fanout_frames_per_sec(uint32_t threads)
+{
+    constexpr size_t SESSIONS = 16;
+    constexpr size_t RECORDS_PER_FRAME = 4;
+    constexpr auto DURATION = std::chrono::milliseconds(500);
+
+    LoopbackServer lb;      // the server and the frame pool, its own io thread stays idle
+    Server& server = lb.GetServer();
+
+    uint16_t port;
+    {
+        asio::io_context io;
+        tcp::acceptor probe(io);
+        IoPool::OpenAcceptor(probe, 0, true);
+        port = probe.local_endpoint().port();
+    }
+
+    std::mutex mtx;
+    std::vector<std::shared_ptr<Session>> sessions;
+
+    IoPool pool(threads);
+    pool.Start(port, [&](tcp::socket socket)
+        {
+            auto s = std::make_shared<Session>(std::move(socket), server);
+            std::lock_guard<std::mutex> lk(mtx);
+            sessions.push_back(s);
+        });
+
+    asio::io_context client_io;
+    std::deque<tcp::socket> clients;
+    for (size_t i = 0; i < SESSIONS; i++)
+        clients.emplace_back(client_io).connect(tcp::endpoint(asio::ip::address_v4::loopback(), port));
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            if (sessions.size() == SESSIONS)
+                break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    pool.CloseListeners();
+
+    std::vector<std::shared_ptr<Session>> targets;
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        targets = sessions;
+    }
+    EXPECT_EQ(targets.size(), SESSIONS);
+
+    std::vector<WhaleEvent> events(RECORDS_PER_FRAME);
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        std::memset(&events[i], 0, sizeof(WhaleEvent));
+        events[i].price = 96000.0 + i;
+        events[i].quantity = 2.0;
+    }
+
+    Frame* segment = lb.GetPool().Acquire(WhaleRecordsV1MaxSize(events.size()));
+    segment->size = EncodeWhaleRecordsV1(segment->data(), events.data(), events.size(), server.GetSymbolWire(), server.GetCoinCount());
+    segment->count = static_cast<uint32_t>(events.size());
+    const size_t frame_size = WHALE_FRAME_HEAD_SIZE + segment->size;
+
+    std::atomic<bool> stop_readers{ false };
+    std::atomic<uint64_t> received_bytes{ 0 };
+    std::vector<std::thread> readers;
+    for (tcp::socket& c : clients)
+    {
+        readers.emplace_back([&c, &stop_readers, &received_bytes]()
+            {
+                std::vector<uint8_t> buf(256 * 1024);
+                while (!stop_readers.load(std::memory_order_relaxed))
+                {
+                    boost::system::error_code ec;
+                    size_t n = c.read_some(asio::buffer(buf), ec);
+                    if (ec)
+                        break;
+                    received_bytes.fetch_add(n, std::memory_order_relaxed);
+                }
+            });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t batches = 0;
+    while (std::chrono::steady_clock::now() - start < DURATION)
+    {
+        FramePool::AddRef(segment, static_cast<uint32_t>(targets.size()));
+        for (auto& s : targets)
+            s->DeliverSegment(segment);
+
+        if ((++batches & 15) == 0)
+            std::this_thread::yield();
+    }
+    const uint64_t received = received_bytes.load();
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (auto& s : targets)
+        s->ForceClose();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    stop_readers = true;
+    for (auto& c : clients)
+    {
+        boost::system::error_code ec;
+        c.shutdown(tcp::socket::shutdown_both, ec);
+        c.close(ec);
+    }
+    for (auto& t : readers)
+        t.join();
+
+    pool.Stop();
+    targets.clear();
+    sessions.clear();
+    FramePool::Release(segment);
+
+    return static_cast<double>(received / frame_size) / secs;
+}
+
+// the same fan-out on one and on four I/O threads; how much the extra threads give depends on the free cores,
+// so both runs are only required to deliver
+TEST(IoPoolTest, FanoutThroughput) {
+    if (!IoPool::HasReusePort())
+        GTEST_SKIP() << "no SO_REUSEPORT";
+
+    const double one = fanout_frames_per_sec(1);
+    const double four = fanout_frames_per_sec(4);
+
+    std::cout << "[          ] 16 sessions, " << std::thread::hardware_concurrency() << " cores | 1 I/O thread: " << one / 1e3
+        << " K frames/s | 4 I/O threads: " << four / 1e3 << " K frames/s (x" << (one > 0 ? four / one : 0.0) << ")" << std::endl;
+
+    EXPECT_GT(one, 0.0);
+    EXPECT_GT(four, 0.0);
+}
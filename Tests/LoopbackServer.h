@@ -0,0 +1,145 @@
+// LoopbackServer.h
+
+#pragma once
+
+#include "Server.h"
+#include "Session.h"
+#include <boost/asio.hpp>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Test fixture of the session outbound path: a Server (started only by StartPipeline) whose io_context runs on its own thread, and
+// sessions accepted from blocking loopback client sockets. Stop() (or the destructor) closes the sessions and the
+// clients, then stops the io thread; the frame pool outlives all of them.
+class LoopbackServer
+{
+public:
+    struct Connection
+    {
+        boost::asio::ip::tcp::socket& client;
+        std::shared_ptr<Session> session;
+    };
+
+    // 'configure' - called before the io thread starts (socket profile, I/O threads, ...)
+    template<typename F>
+    explicit LoopbackServer(F&& configure)
+        : m_server(m_io, 0)
+        , m_acceptor(m_io, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0))
+        , m_work(boost::asio::make_work_guard(m_io))
+    {
+        m_server.EnableShowLogMsg(false);
+        configure(m_server);
+        m_io_thread = std::thread([this]() { m_io.run(); });
+    }
+
+    LoopbackServer() : LoopbackServer([](Server&) {}) {}
+
+    // configure: the whole pipeline runs, the trades come from InjectTrade() only (no exchange connection)
+    static void StartPipeline(Server& server)
+    {
+        server.EnableDataEmulation(false);
+        server.SetFeedUrl("ws://127.0.0.1:1/ws");   // nothing listens there
+        server.Start();
+    }
+
+    // one exchange trade message into the ingest, as the feed connection would hand it over
+    void InjectTrade(const std::string& symbol, uint64_t trade_id, double price, double qty)
+    {
+        char msg[256];
+        const int len = std::snprintf(msg, sizeof(msg), R"({"e":"trade","E":%llu,"s":"%s","t":%llu,"p":"%.2f","q":"%.4f","m":true})",
+            static_cast<unsigned long long>(1700000000000 + trade_id), symbol.c_str(), static_cast<unsigned long long>(trade_id), price, qty);
+        m_server.ProcessMarketMsg(std::string_view(msg, static_cast<size_t>(len)), static_cast<size_t>(len), __rdtsc());
+    }
+
+    // next frame of the client within 'timeout', false - none
+    static bool ReadFrame(boost::asio::ip::tcp::socket& client, SProtocolHeader& hdr, std::vector<uint8_t>& body,
+        std::chrono::milliseconds timeout = std::chrono::milliseconds(2000))
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (client.available() < sizeof(hdr))
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        boost::asio::read(client, boost::asio::buffer(&hdr, sizeof(hdr)));
+        body.resize(net_to_host_u32(hdr.len));
+        boost::asio::read(client, boost::asio::buffer(body));
+        return true;
+    }
+
+    ~LoopbackServer() { Stop(); }
+
+    // disable copying
+    LoopbackServer(const LoopbackServer&) = delete;
+    LoopbackServer& operator=(const LoopbackServer&) = delete;
+
+    // a client connected to a new session; 'client_rcvbuf' / 'session_sndbuf' > 0 - small socket buffers to build a
+    // backlog, 'start' - the session reads requests (subscribe, query)
+    Connection Connect(bool start = true, int client_rcvbuf = 0, int session_sndbuf = 0)
+    {
+        namespace asio = boost::asio;
+
+        asio::ip::tcp::socket& client = m_clients.emplace_back(m_io);
+        client.open(asio::ip::tcp::v4());
+        if (client_rcvbuf > 0)
+            client.set_option(asio::socket_base::receive_buffer_size(client_rcvbuf));
+        client.connect(m_acceptor.local_endpoint());
+
+        asio::ip::tcp::socket peer = m_acceptor.accept();
+        if (session_sndbuf > 0)
+            peer.set_option(asio::socket_base::send_buffer_size(session_sndbuf));
+
+        auto session = std::make_shared<Session>(std::move(peer), m_server);
+        if (start)
+            session->Start();
+        m_sessions.push_back(session);
+
+        return Connection{ client, session };
+    }
+
+    void Stop()
+    {
+        if (!m_io_thread.joinable())
+            return;
+
+        for (auto& s : m_sessions)
+            s->ForceClose();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        for (auto& c : m_clients)
+        {
+            boost::system::error_code ec;
+            c.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+            c.close(ec);
+        }
+
+        m_server.Stop();
+
+        m_work.reset();
+        m_io.stop();
+        m_io_thread.join();
+
+        m_sessions.clear();
+    }
+
+    Server& GetServer() { return m_server; }
+    FramePool& GetPool() { return m_pool; }
+
+private:
+    FramePool m_pool;       // first in, last out: the sessions hold segment references
+    boost::asio::io_context m_io;
+    Server m_server;
+    boost::asio::ip::tcp::acceptor m_acceptor;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> m_work;
+    std::deque<boost::asio::ip::tcp::socket> m_clients;
+    std::vector<std::shared_ptr<Session>> m_sessions;
+    std::thread m_io_thread;
+};
@@ -0,0 +1,111 @@
+// MockExchangeTest.cpp
+
+#include <gtest/gtest.h>
+#include "LoopbackServer.h"
+#include <boost/asio.hpp>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <spawn.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+
+// the mock process, stopped (SIGINT) and reaped on every exit of the test
+struct MockProcess
+{
+    pid_t pid = 0;
+
+    ~MockProcess()
+    {
+        if (pid <= 0)
+            return;
+
+        int status = 0;
+        kill(pid, SIGINT);
+        waitpid(pid, &status, 0);
+    }
+};
+#endif
+
+
+// End to end over loopback: the MockExchange process serves synthetic trades, the server's feed connections
+// (2 shards, combined streams) parse them into the hot buffer and hot_dispatcher takes every one of them
+TEST(MockExchangeTest, TradesReachHotDispatcher) {
+#if defined(MOCK_EXCHANGE_PATH) && !defined(_WIN32)
+    constexpr uint64_t TRADES = 5'000;
+    namespace asio = boost::asio;
+    const asio::ip::address_v4 loopback = asio::ip::address_v4::loopback();
+
+    // a free loopback port for the mock
+    uint16_t port = 0;
+    {
+        asio::io_context io;
+        asio::ip::tcp::acceptor probe(io, asio::ip::tcp::endpoint(loopback, 0));
+        port = probe.local_endpoint().port();
+    }
+
+    const std::string port_arg = std::to_string(port);
+    char scenario[] = "rate=5000";
+    char* argv[] = { const_cast<char*>(MOCK_EXCHANGE_PATH), const_cast<char*>(port_arg.c_str()), scenario, nullptr };
+
+    MockProcess mock;
+    if (posix_spawn(&mock.pid, MOCK_EXCHANGE_PATH, nullptr, nullptr, argv, environ) != 0)
+        GTEST_SKIP() << "cannot start " << MOCK_EXCHANGE_PATH;
+
+    // listening before the feed connects, so no reconnect is needed
+    bool listening = false;
+    for (int i = 0; i < 500 && !listening; i++)
+    {
+        asio::io_context io;
+        asio::ip::tcp::socket probe(io);
+        boost::system::error_code ec;
+        probe.connect(asio::ip::tcp::endpoint(loopback, port), ec);
+        listening = !ec;
+        if (!listening)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(listening) << "MockExchange does not listen on " << port;
+
+    LoopbackServer lb([&](Server& server)
+        {
+            server.EnableDataEmulation(false);
+            server.SetFeedShards(2);
+            server.SetFeedUrl("ws://127.0.0.1:" + port_arg + "/ws");
+            server.Start();
+        });
+    Server& server = lb.GetServer();
+    const FeedLatency& lat = server.GetFeedLatency();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+    while (lat.parse.count.load() < TRADES && std::chrono::steady_clock::now() < deadline)
+    {
+        int status = 0;
+        ASSERT_EQ(waitpid(mock.pid, &status, WNOHANG), 0) << "MockExchange exited";
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    EXPECT_GE(lat.parse.count.load(), TRADES);
+
+    const auto& shards = server.GetFeedShards();
+    ASSERT_EQ(shards.size(), 2u);
+    for (const auto& shard : shards)
+    {
+        EXPECT_EQ(shard->status.load(), EFeedStatus::Up);
+        EXPECT_GT(shard->msg_cnt.load(), 0u);
+        EXPECT_EQ(shard->reconnects.load(), 0u);
+    }
+
+    // "E" is the mock's send time on the same clock: exchange -> receive well below a second
+    EXPECT_GT(lat.exchange.count.load(), 0u);
+    EXPECT_LT(lat.exchange.Percentile(0.5), 1'000'000'000u);
+
+    std::cout << "[          ] trades: " << lat.parse.count.load() << " | exchange -> receive p50 " << lat.exchange.Percentile(0.5)
+        << " ns | parse p50 " << lat.parse.Percentile(0.5) << " ns | analytics p50 " << lat.analytics.Percentile(0.5) << " ns" << std::endl;
+#else
+    GTEST_SKIP() << "MockExchange is not built";
+#endif
+}
@@ -0,0 +1,189 @@
+// MulticastTest.cpp
+
+#include <gtest/gtest.h>
+#include "MulticastPublisher.h"
+#include <boost/asio.hpp>
+#include <vector>
+#include <cstring>
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+namespace asio = boost::asio;
+using udp = asio::ip::udp;
+
+
+static const char MCAST_GROUP[] = "239.255.77.1";
+static const char MCAST_IFACE[] = "127.0.0.1";
+
+static WhaleEvent make_whale(size_t i)
+{
+    WhaleEvent we;
+    std::memset(&we, 0, sizeof(we));
+    we.price = 96000.0 + i;
+    we.quantity = 2.0;
+    we.timestamp = 1700000000000ULL + i;
+    we.index_symbol = static_cast<int>(i % 4);
+    return we;
+}
+
+
+TEST(MulticastTest, DatagramsAreMtuSizedAndRetransmittable) {
+    asio::io_context io;
+    MulticastPublisher pub(io, MCAST_GROUP, 47001, MCAST_IFACE);
+
+    // 3 full datagrams + 1 partial
+    const size_t cnt = 3 * MCAST_MAX_RECORDS + 5;
+    for (size_t i = 0; i < cnt; i++)
+        pub.Add(make_whale(i));
+    pub.Flush();
+
+    EXPECT_LE(sizeof(SMcastHeader) + MCAST_MAX_RECORDS * sizeof(SWhaleRecordV2), MCAST_MAX_DATAGRAM);
+    ASSERT_EQ(pub.GetNextSeq(), 5u);
+
+    std::vector<uint8_t> out;
+    uint64_t first = pub.Retransmit(3, 10, out);   // only 3 and 4 exist
+    EXPECT_EQ(first, 1u);
+
+    SMcastHeader hdr;
+    std::memcpy(&hdr, out.data(), sizeof(hdr));
+    EXPECT_EQ(hdr.seq, 3u);
+    EXPECT_EQ(hdr.count, MCAST_MAX_RECORDS);
+    EXPECT_NE(pub.GetEpoch(), 0u);
+    EXPECT_EQ(hdr.epoch, pub.GetEpoch());
+
+    size_t pos = sizeof(hdr) + hdr.count * sizeof(SWhaleRecordV2);
+    std::memcpy(&hdr, out.data() + pos, sizeof(hdr));
+    EXPECT_EQ(hdr.seq, 4u);
+    EXPECT_EQ(hdr.count, 5u);
+    EXPECT_EQ(out.size(), pos + sizeof(hdr) + 5 * sizeof(SWhaleRecordV2));
+
+    // the last record of the partial datagram
+    SWhaleRecordV2 r;
+    std::memcpy(&r, out.data() + out.size() - sizeof(r), sizeof(r));
+    EXPECT_EQ(r.price, 96000.0 + cnt - 1);
+    EXPECT_EQ(r.symbol, static_cast<uint32_t>((cnt - 1) % 4));
+
+    // the ring keeps the latest MCAST_RETRANSMIT_DATAGRAMS only
+    for (size_t i = 0; i < MCAST_RETRANSMIT_DATAGRAMS; i++)
+    {
+        pub.Add(make_whale(i));
+        pub.Flush();
+    }
+    out.clear();
+    first = pub.Retransmit(1, 4, out);
+    EXPECT_EQ(first, 5u);
+    EXPECT_TRUE(out.empty());
+}
+
+// Retransmit copies next to a Flush() that keeps lapping the ring: every datagram handed out is whole and in order,
+// the lapped ones are reported through the first available seq
+TEST(MulticastTest, RetransmitWhileFlushing) {
+    constexpr size_t DATAGRAMS = 200'000;
+
+    asio::io_context io;
+    MulticastPublisher pub(io, MCAST_GROUP, 47003, MCAST_IFACE);
+
+    std::atomic<bool> done{ false };
+    std::thread publisher([&]()
+        {
+            // one whale per datagram: datagram seq = i + 1
+            for (size_t i = 0; i < DATAGRAMS; i++)
+            {
+                pub.Add(make_whale(i));
+                pub.Flush();
+            }
+            done = true;
+        });
+
+    std::vector<uint8_t> out;
+    uint64_t requests = 0, datagrams = 0;
+    while (!done)
+    {
+        // the oldest end of the ring, where Flush() overwrites
+        const uint64_t next = pub.GetNextSeq();
+        const uint64_t from = (next > MCAST_RETRANSMIT_DATAGRAMS) ? next - MCAST_RETRANSMIT_DATAGRAMS : 1;
+
+        out.clear();
+        const uint64_t first = pub.Retransmit(from, MCAST_RETRANSMIT_MAX, out);
+        requests++;
+
+        uint64_t prev = 0;
+        size_t pos = 0;
+        while (pos < out.size())
+        {
+            SMcastHeader hdr;
+            ASSERT_LE(pos + sizeof(hdr), out.size());
+            std::memcpy(&hdr, out.data() + pos, sizeof(hdr));
+            ASSERT_EQ(hdr.count, 1u);
+            ASSERT_EQ(hdr.epoch, pub.GetEpoch());
+            ASSERT_GT(hdr.seq, prev);
+            ASSERT_GE(hdr.seq, from);
+            ASSERT_LE(pos + sizeof(hdr) + sizeof(SWhaleRecordV2), out.size());
+
+            SWhaleRecordV2 r;
+            std::memcpy(&r, out.data() + pos + sizeof(hdr), sizeof(r));
+            ASSERT_EQ(r.price, 96000.0 + static_cast<double>(hdr.seq - 1));
+
+            prev = hdr.seq;
+            pos += sizeof(hdr) + sizeof(r);
+            datagrams++;
+        }
+        EXPECT_GE(first, from > 1 ? from : 1);
+    }
+
+    publisher.join();
+    std::cout << "[          ] " << requests << " retransmits, " << datagrams << " datagrams copied" << std::endl;
+    EXPECT_GT(datagrams, 0u);
+}
+
+TEST(MulticastTest, LoopbackDeliveryInOrder) {
+    asio::io_context io;
+
+    udp::socket rcv(io);
+    rcv.open(udp::v4());
+    rcv.set_option(asio::socket_base::reuse_address(true));
+    rcv.bind(udp::endpoint(asio::ip::address_v4::any(), 47002));
+    boost::system::error_code ec;
+    rcv.set_option(asio::ip::multicast::join_group(asio::ip::make_address_v4(MCAST_GROUP), asio::ip::make_address_v4(MCAST_IFACE)), ec);
+    if (ec)
+        GTEST_SKIP() << "no multicast on loopback: " << ec.message();
+
+    MulticastPublisher pub(io, MCAST_GROUP, 47002, MCAST_IFACE);
+
+    const size_t DATAGRAMS = 50;
+    for (size_t i = 0; i < DATAGRAMS * MCAST_MAX_RECORDS; i++)
+        pub.Add(make_whale(i));
+    pub.Flush();
+
+    rcv.non_blocking(true);
+    std::vector<uint8_t> buf(MCAST_MAX_DATAGRAM);
+    uint64_t expected = 1;
+    size_t received = 0;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (received < DATAGRAMS && std::chrono::steady_clock::now() < deadline)
+    {
+        size_t n = rcv.receive(asio::buffer(buf), 0, ec);
+        if (ec == asio::error::would_block)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        ASSERT_FALSE(ec);
+
+        SMcastHeader hdr;
+        ASSERT_GE(n, sizeof(hdr));
+        std::memcpy(&hdr, buf.data(), sizeof(hdr));
+        EXPECT_EQ(hdr.signature, PROTOCOL_HEADER_SIGNATURE);
+        EXPECT_EQ(hdr.seq, expected++);
+        EXPECT_EQ(n, sizeof(hdr) + hdr.count * sizeof(SWhaleRecordV2));
+        received++;
+    }
+
+    if (received == 0)
+        GTEST_SKIP() << "no multicast route on loopback";
+
+    EXPECT_EQ(received, DATAGRAMS);
+    EXPECT_EQ(pub.GetSendErrors(), 0u);
+}
@@ -0,0 +1,741 @@
+// SessionTest.cpp
+
+#include <gtest/gtest.h>
+#include "LoopbackServer.h"
+#include <boost/asio.hpp>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <future>
+#include <numeric>
+#include <string>
+#include <tuple>
+
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+
+
+// Session outbound path over loopback: producer thread plays Server::event_dispatcher
+// (DeliverSegment at a high whale rate), a blocking reader checks the frame stream.
+TEST(SessionTest, GatherWriteThroughput) {
+    constexpr size_t RECORDS_PER_FRAME = 16;
+    constexpr auto DURATION = std::chrono::milliseconds(1000);
+
+    LoopbackServer lb;
+    Server& server = lb.GetServer();
+    auto [client, session] = lb.Connect(false);
+
+    // one shared segment, referenced by every queued frame
+    std::vector<WhaleEvent> events(RECORDS_PER_FRAME);
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        std::memset(&events[i], 0, sizeof(WhaleEvent));
+        events[i].price = 96000.0 + i;
+        events[i].quantity = 2.0;
+        events[i].index_symbol = 0;
+    }
+
+    Frame* segment = lb.GetPool().Acquire(WhaleRecordsV1MaxSize(events.size()));
+    segment->size = EncodeWhaleRecordsV1(segment->data(), events.data(), events.size(), server.GetSymbolWire(), server.GetCoinCount());
+    segment->count = static_cast<uint32_t>(events.size());
+
+    const size_t frame_size = WHALE_FRAME_HEAD_SIZE + segment->size;
+
+    std::atomic<bool> stop_reader{ false };
+    std::atomic<uint64_t> received_frames{ 0 };
+    std::atomic<bool> stream_ok{ true };
+
+    std::thread reader([&]()
+        {
+            std::vector<uint8_t> buf(1024 * 1024);
+            std::vector<uint8_t> partial;
+            uint8_t expected_msg_num = 0;
+
+            while (!stop_reader.load(std::memory_order_relaxed))
+            {
+                boost::system::error_code ec;
+                size_t n = client.read_some(asio::buffer(buf), ec);
+                if (ec)
+                    break;
+
+                partial.insert(partial.end(), buf.begin(), buf.begin() + n);
+
+                size_t pos = 0;
+                while (partial.size() - pos >= frame_size)
+                {
+                    SProtocolHeader hdr;
+                    std::memcpy(&hdr, partial.data() + pos, sizeof(hdr));
+
+                    if (net_to_host_u16(hdr.signature) != PROTOCOL_HEADER_SIGNATURE ||
+                        hdr.msg_num != expected_msg_num++ ||
+                        net_to_host_u32(hdr.len) + sizeof(hdr) != frame_size)
+                    {
+                        stream_ok = false;
+                    }
+
+                    pos += frame_size;
+                    received_frames.fetch_add(1, std::memory_order_relaxed);
+                }
+                partial.erase(partial.begin(), partial.begin() + pos);
+            }
+        });
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t delivered = 0;
+
+    while (std::chrono::steady_clock::now() - start < DURATION)
+    {
+        FramePool::AddRef(segment);
+        session->DeliverSegment(segment);
+        delivered++;
+
+        if ((delivered & 63) == 0)
+            std::this_thread::yield();
+    }
+
+    // let the queue drain
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t frames = received_frames.load();
+    uint64_t writes = session->GetWriteCount();
+
+    double fps = frames / (duration / 1000.0);
+    double mbps = fps * frame_size / (1024.0 * 1024.0);
+
+    std::cout << "[          ] Sent: " << fps / 1e3 << " K frames/sec (" << mbps << " MB/s, "
+        << RECORDS_PER_FRAME << " whales/frame) | frames per write: " << (writes ? (double)frames / writes : 0.0)
+        << " | dropped: " << (delivered - frames) << std::endl;
+
+    EXPECT_TRUE(stream_ok.load());
+    EXPECT_GT(frames, 0u);
+    EXPECT_GE(frames, writes);
+
+    stop_reader = true;
+    lb.Stop();
+    reader.join();
+
+    FramePool::Release(segment);
+}
+
+// Slow consumer with a drop policy: the backlog stays within the lag budget and
+// every whale is either delivered or accounted for in a gap notice.
+static void run_slow_consumer(ESlowConsumerPolicy policy)
+{
+    constexpr size_t RECORDS_PER_FRAME = 16;
+    constexpr size_t FRAMES = 4000;
+    constexpr uint32_t MAX_LAG_KB = 64;
+
+    LoopbackServer lb;
+    Server& server = lb.GetServer();
+    auto [client, session] = lb.Connect(true, 4096, 4096);
+
+    // subscribe: BTCUSDT, v1, the policy, 64 KB lag budget
+    std::string symbol = server.GetCoinSymbol(0);
+    double treshold = 0;
+    uint64_t treshold_bits;
+    std::memcpy(&treshold_bits, &treshold, 8);
+    treshold_bits = host_to_net_u64(treshold_bits);
+    uint32_t max_lag_kb = host_to_net_u32(MAX_LAG_KB);
+
+    std::vector<uint8_t> payload;
+    payload.push_back(static_cast<uint8_t>(EProtocolDataType::Whale));
+    payload.push_back(static_cast<uint8_t>(symbol.size()));
+    payload.insert(payload.end(), symbol.begin(), symbol.end());
+    payload.insert(payload.end(), (uint8_t*)&treshold_bits, (uint8_t*)&treshold_bits + 8);
+    payload.push_back(static_cast<uint8_t>(policy));
+    payload.insert(payload.end(), (uint8_t*)&max_lag_kb, (uint8_t*)&max_lag_kb + 4);
+
+    std::vector<uint8_t> subscribe(sizeof(SProtocolHeader));
+    WriteFrameHeader(subscribe.data(), PROTOCOL_VERSION_1, MSG_SUBSCRIBE, static_cast<uint32_t>(payload.size()));
+    subscribe.insert(subscribe.end(), payload.begin(), payload.end());
+    asio::write(client, asio::buffer(subscribe));
+
+    while (session->GetSlowConsumerPolicy() != policy)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    std::vector<WhaleEvent> events(RECORDS_PER_FRAME);
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        std::memset(&events[i], 0, sizeof(WhaleEvent));
+        events[i].price = 96000.0 + i;
+        events[i].quantity = 2.0;
+    }
+
+    Frame* segment = lb.GetPool().Acquire(WhaleRecordsV1MaxSize(events.size()));
+    segment->size = EncodeWhaleRecordsV1(segment->data(), events.data(), events.size(), server.GetSymbolWire(), server.GetCoinCount());
+    segment->count = static_cast<uint32_t>(events.size());
+    segment->ind_symbol = 0;
+
+    // the client does not read: the backlog must stay bounded
+    size_t max_lag = 0;
+    for (size_t i = 0; i < FRAMES; i++)
+    {
+        FramePool::AddRef(segment);
+        session->DeliverSegment(segment);
+
+        if ((i & 63) == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            max_lag = (std::max)(max_lag, session->GetLagBytes());
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    EXPECT_LE(max_lag, MAX_LAG_KB * 1024 + WhaleRecordsV1MaxSize(RECORDS_PER_FRAME));
+    EXPECT_GT(session->GetDroppedCount(), 0u);
+
+    // drain: records + gaps == delivered
+    uint64_t records = 0, gap_records = 0;
+    bool stream_ok = true;
+    uint8_t expected_msg_num = 0;
+
+    client.non_blocking(false);
+    while (records + gap_records < FRAMES * RECORDS_PER_FRAME && stream_ok)
+    {
+        SProtocolHeader hdr;
+        asio::read(client, asio::buffer(&hdr, sizeof(hdr)));
+
+        std::vector<uint8_t> body(net_to_host_u32(hdr.len));
+        asio::read(client, asio::buffer(body));
+
+        if (hdr.msg_num != expected_msg_num++)
+            stream_ok = false;
+
+        uint32_t cnt;
+        std::memcpy(&cnt, body.data(), 4);
+        cnt = net_to_host_u32(cnt);
+
+        if (hdr.data_type == MSG_DATA)
+            records += cnt;
+        else if (hdr.data_type == MSG_GAP)
+            gap_records += cnt;
+        else if (hdr.data_type != MSG_SNAPSHOT || expected_msg_num != 1)   // snapshot goes first
+            stream_ok = false;
+    }
+
+    std::cout << "[          ] Max lag: " << max_lag / 1024 << " KB | delivered: " << records
+        << " | reported in gaps: " << gap_records << std::endl;
+
+    EXPECT_TRUE(stream_ok);
+    EXPECT_EQ(records + gap_records, FRAMES * RECORDS_PER_FRAME);
+    EXPECT_EQ(gap_records, session->GetDroppedCount());
+
+    lb.Stop();
+    FramePool::Release(segment);
+}
+
+TEST(SessionTest, DropOldestReportsGaps) {
+    run_slow_consumer(ESlowConsumerPolicy::DropOldest);
+}
+
+// superseded batches of the symbol are reported too
+TEST(SessionTest, ConflateReportsGaps) {
+    run_slow_consumer(ESlowConsumerPolicy::Conflate);
+}
+
+// A mega-whale delivered behind a deep queue goes out right after the write in flight.
+TEST(SessionTest, ExpressBypassesQueue) {
+    constexpr size_t RECORDS_PER_FRAME = 16;
+    constexpr size_t FRAMES = 256;
+
+    LoopbackServer lb;
+    Server& server = lb.GetServer();
+    auto [client, session] = lb.Connect(false, 4096, 4096);
+
+    std::vector<WhaleEvent> events(RECORDS_PER_FRAME);
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        std::memset(&events[i], 0, sizeof(WhaleEvent));
+        events[i].price = 96000.0 + i;
+        events[i].quantity = 2.0;
+    }
+
+    Frame* segment = lb.GetPool().Acquire(WhaleRecordsV1MaxSize(events.size()));
+    segment->size = EncodeWhaleRecordsV1(segment->data(), events.data(), events.size(), server.GetSymbolWire(), server.GetCoinCount());
+    segment->count = static_cast<uint32_t>(events.size());
+    segment->ind_symbol = 0;
+
+    Frame* mega = lb.GetPool().Acquire(WhaleRecordsV1MaxSize(1));
+    mega->size = EncodeWhaleRecordsV1(mega->data(), events.data(), 1, server.GetSymbolWire(), server.GetCoinCount());
+    mega->count = 1;
+    mega->ind_symbol = 0;
+    mega->express = true;
+    mega->tick_rcvd = __rdtsc();
+
+    // the client does not read yet: the normal frames pile up in the session queue
+    for (size_t i = 0; i < FRAMES; i++)
+    {
+        FramePool::AddRef(segment);
+        session->DeliverSegment(segment);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    FramePool::AddRef(mega);
+    session->DeliverSegment(mega);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // find the express frame in the stream
+    size_t express_pos = 0;
+    bool found = false;
+    for (size_t i = 0; i < FRAMES + 1; i++)
+    {
+        SProtocolHeader hdr;
+        asio::read(client, asio::buffer(&hdr, sizeof(hdr)));
+
+        std::vector<uint8_t> body(net_to_host_u32(hdr.len));
+        asio::read(client, asio::buffer(body));
+
+        uint32_t cnt;
+        std::memcpy(&cnt, body.data(), 4);
+        if (net_to_host_u32(cnt) == 1)
+        {
+            express_pos = i;
+            found = true;
+        }
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));   // write completion
+
+    std::cout << "[          ] Express frame position: " << express_pos << " of " << FRAMES + 1
+        << " (written behind the in-flight gather write only)" << std::endl;
+
+    EXPECT_TRUE(found);
+    EXPECT_LE(express_pos, 2 * SESSION_WRITE_MAX_FRAMES);
+    EXPECT_GT(server.GetDeliveryLatency(true).count.load(), 0u);
+
+    lb.Stop();
+    FramePool::Release(segment);
+    FramePool::Release(mega);
+}
+
+// Query before / without subscription: answered from the published snapshots with the request id.
+TEST(SessionTest, QueryAnswersFromSnapshots) {
+    LoopbackServer lb;
+    Server& server = lb.GetServer();
+    auto [client, session] = lb.Connect();
+
+    // request 77: ETHUSDT + every coin, v2
+    std::vector<uint8_t> payload;
+    uint32_t request_id = host_to_net_u32(77);
+    payload.insert(payload.end(), (uint8_t*)&request_id, (uint8_t*)&request_id + 4);
+    uint16_t cnt = host_to_net_u16(2);
+    payload.insert(payload.end(), (uint8_t*)&cnt, (uint8_t*)&cnt + 2);
+    for (std::string symbol : { std::string("ETHUSDT"), std::string(SUBSCRIBE_ALL_SYMBOLS) })
+    {
+        payload.push_back(static_cast<uint8_t>(symbol.size()));
+        payload.insert(payload.end(), symbol.begin(), symbol.end());
+    }
+
+    std::vector<uint8_t> query(sizeof(SProtocolHeader));
+    WriteFrameHeader(query.data(), PROTOCOL_VERSION_2, MSG_QUERY, static_cast<uint32_t>(payload.size()));
+    query.insert(query.end(), payload.begin(), payload.end());
+    asio::write(client, asio::buffer(query));
+
+    SProtocolHeader hdr;
+    asio::read(client, asio::buffer(&hdr, sizeof(hdr)));
+    std::vector<uint8_t> body(net_to_host_u32(hdr.len));
+    asio::read(client, asio::buffer(body));
+
+    EXPECT_EQ(hdr.data_type, MSG_QUERY_RESULT);
+    EXPECT_EQ(hdr.version, PROTOCOL_VERSION_2);
+    ASSERT_EQ(body.size(), 4 + (1 + server.GetCoinCount()) * sizeof(SSnapshotRecordV2));
+
+    uint32_t id;
+    std::memcpy(&id, body.data(), 4);
+    EXPECT_EQ(id, 77u);
+
+    SSnapshotRecordV2 r;
+    std::memcpy(&r, body.data() + 4, sizeof(r));
+    EXPECT_EQ(r.symbol, 1u);
+    std::memcpy(&r, body.data() + 4 + sizeof(r) * server.GetCoinCount(), sizeof(r));
+    EXPECT_EQ(r.symbol, server.GetCoinCount() - 1);
+
+    EXPECT_EQ(session->GetQueryCount(), 1u);
+}
+
+static void append_symbol(std::vector<uint8_t>& payload, const std::string& symbol, double treshold)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &treshold, 8);
+    bits = host_to_net_u64(bits);
+
+    payload.push_back(static_cast<uint8_t>(symbol.size()));
+    payload.insert(payload.end(), symbol.begin(), symbol.end());
+    payload.insert(payload.end(), (uint8_t*)&bits, (uint8_t*)&bits + 8);
+}
+
+static void send_frame(tcp::socket& client, uint8_t version, uint8_t data_type, const std::vector<uint8_t>& payload)
+{
+    std::vector<uint8_t> frame(sizeof(SProtocolHeader));
+    WriteFrameHeader(frame.data(), version, data_type, static_cast<uint32_t>(payload.size()));
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    asio::write(client, asio::buffer(frame));
+}
+
+// (symbol, treshold) sorted by symbol, read on the io thread (the session's strand changes them)
+static std::vector<std::pair<int, double>> subscriptions_of(Server& server, Session& session)
+{
+    std::promise<std::vector<std::pair<int, double>>> result;
+    asio::post(server.GetIoContext(), [&]()
+        {
+            std::vector<std::pair<int, double>> subs;
+            for (const auto& s : session.GetSubscriptions())
+                subs.emplace_back(s.ind_symbol, s.treshold);
+            std::sort(subs.begin(), subs.end());
+            result.set_value(subs);
+        });
+    return result.get_future().get();
+}
+
+static bool wait_subscriptions(Server& server, Session& session, const std::vector<std::pair<int, double>>& expected)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (subscriptions_of(server, session) != expected)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// In-band updates: a list, the "*" wildcard, an unknown symbol (skipped) and an empty list (no change)
+TEST(SessionTest, SubscriptionUpdateParsing) {
+    LoopbackServer lb;
+    Server& server = lb.GetServer();
+    auto [client, session] = lb.Connect();
+
+    std::vector<uint8_t> subscribe{ static_cast<uint8_t>(EProtocolDataType::Whale) };
+    append_symbol(subscribe, "BTCUSDT", 100000);
+    send_frame(client, PROTOCOL_VERSION_2, MSG_SUBSCRIBE, subscribe);
+    ASSERT_TRUE(wait_subscriptions(server, *session, { { 0, 100000 } }));
+
+    auto update = [&](const std::vector<std::tuple<ESubscriptionAction, std::string, double>>& changes)
+    {
+        std::vector<uint8_t> payload(2);
+        uint16_t cnt = host_to_net_u16(static_cast<uint16_t>(changes.size()));
+        std::memcpy(payload.data(), &cnt, 2);
+        for (const auto& [action, symbol, treshold] : changes)
+        {
+            payload.push_back(static_cast<uint8_t>(action));
+            append_symbol(payload, symbol, treshold);
+        }
+        send_frame(client, PROTOCOL_VERSION_2, MSG_SUBSCRIPTION_UPDATE, payload);
+    };
+
+    update({ { ESubscriptionAction::Set, "ETHUSDT", 50000 }, { ESubscriptionAction::Set, "SOLUSDT", 1000 },
+        { ESubscriptionAction::Set, "BTCUSDT", 200000 } });
+    EXPECT_TRUE(wait_subscriptions(server, *session, { { 0, 200000 }, { 1, 50000 }, { 2, 1000 } }));
+
+    update({ { ESubscriptionAction::Set, SUBSCRIBE_ALL_SYMBOLS, 7 } });
+    EXPECT_TRUE(wait_subscriptions(server, *session, { { 0, 7 }, { 1, 7 }, { 2, 7 }, { 3, 7 } }));
+
+    update({ { ESubscriptionAction::Set, "FOOUSDT", 1 }, { ESubscriptionAction::Remove, "ETHUSDT", 0 } });
+    EXPECT_TRUE(wait_subscriptions(server, *session, { { 0, 7 }, { 2, 7 }, { 3, 7 } }));
+
+    // the empty list leaves them as they are, the stream goes on
+    update({});
+    update({ { ESubscriptionAction::Remove, "BNBUSDT", 0 } });
+    EXPECT_TRUE(wait_subscriptions(server, *session, { { 0, 7 }, { 2, 7 } }));
+    EXPECT_FALSE(session->Expired());
+}
+
+static std::vector<std::pair<Session*, double>> row_of(const RouteTable& routes, size_t ind)
+{
+    std::vector<std::pair<Session*, double>> row;
+    for (const auto& r : routes.Row(ind))
+        row.emplace_back(r.session, r.treshold);
+    return row;
+}
+
+// In-band Set/Remove patch the rows to what a full rebuild gives, at a fraction of its cost
+TEST(SessionTest, RouteUpdateMatchesRebuild) {
+    constexpr size_t SESSIONS = 2000;
+
+    asio::io_context io;
+    Server server(io, 0);
+    server.EnableShowLogMsg(false);
+
+    std::vector<std::shared_ptr<Session>> sessions;
+    for (size_t i = 0; i < SESSIONS; i++)
+    {
+        sessions.push_back(std::make_shared<Session>(tcp::socket(io), server));
+        for (size_t c = 0; c < server.GetCoinCount(); c++)
+            sessions.back()->SetSubscription(static_cast<int>(c), static_cast<double>((i * 7919 + c * 104729) % 1000 + 1) * 1000);
+    }
+
+    RouteTable routes(server.GetCoinCount());
+    routes.Rebuild(sessions);
+    ASSERT_EQ(routes.Row(1).size(), SESSIONS);
+
+    // what UpdateSubscriptions does: the session first, then the route
+    auto update = [&](Session* s, int ind, double treshold, bool remove)
+    {
+        if (remove)
+            s->RemoveSubscription(ind);
+        else
+            s->SetSubscription(ind, treshold);
+        routes.Apply({ s, ind, treshold, remove });
+    };
+
+    Session* a = sessions[10].get();
+    Session* b = sessions[20].get();
+    update(a, 1, 5, false);             // new treshold: moves to the front of the row
+    update(b, 1, 0, true);
+    update(b, 2, 999'999'000, false);   // to the back
+    update(a, 3, 0, true);
+
+    EXPECT_EQ(routes.Row(1).size(), SESSIONS - 1);
+    EXPECT_EQ(routes.Row(1).front().session, a);
+    EXPECT_EQ(routes.Row(1).front().treshold, 5);
+    EXPECT_EQ(routes.Row(2).back().session, b);
+    EXPECT_EQ(routes.Row(3).size(), SESSIONS - 1);
+    EXPECT_TRUE(std::none_of(routes.Row(3).begin(), routes.Row(3).end(), [a](const SessionRoute& r) { return r.session == a; }));
+
+    RouteTable rebuilt(server.GetCoinCount());
+    rebuilt.Rebuild(sessions);
+    for (size_t c = 0; c < server.GetCoinCount(); c++)
+    {
+        EXPECT_TRUE(std::is_sorted(routes.Row(c).begin(), routes.Row(c).end(), route_less));
+        // equal routes may be in any order within a group
+        auto x = row_of(routes, c), y = row_of(rebuilt, c);
+        std::sort(x.begin(), x.end());
+        std::sort(y.begin(), y.end());
+        EXPECT_EQ(x, y);
+    }
+
+    // cost: one update vs the rebuild it replaces
+    constexpr int ROUNDS = 200;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++)
+        rebuilt.Rebuild(sessions);
+    auto t1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++)
+        update(sessions[i].get(), i % 4, static_cast<double>(i) * 1000, false);
+    auto t2 = std::chrono::steady_clock::now();
+
+    const double rebuild_us = std::chrono::duration<double, std::micro>(t1 - t0).count() / ROUNDS;
+    const double update_us = std::chrono::duration<double, std::micro>(t2 - t1).count() / ROUNDS;
+    std::cout << "[          ] " << SESSIONS << " sessions x " << server.GetCoinCount() << " coins: rebuild " << rebuild_us
+        << " us | in-band update " << update_us << " us" << std::endl;
+    EXPECT_LT(update_us, rebuild_us);
+}
+
+// The running pipeline routes whales by the updated subscriptions
+TEST(SessionTest, RouteUpdateDelivery) {
+    LoopbackServer lb(LoopbackServer::StartPipeline);
+    Server& server = lb.GetServer();
+    auto [client, session] = lb.Connect();
+
+    std::vector<uint8_t> subscribe{ static_cast<uint8_t>(EProtocolDataType::Whale) };
+    append_symbol(subscribe, "BTCUSDT", 0);
+    send_frame(client, PROTOCOL_VERSION_2, MSG_SUBSCRIBE, subscribe);
+    ASSERT_TRUE(wait_subscriptions(server, *session, { { 0, 0 } }));
+
+    // the next whale record of the stream (dictionary & snapshot skipped)
+    auto next_whale = [&](SWhaleRecordV2& rec)
+    {
+        SProtocolHeader hdr;
+        std::vector<uint8_t> body;
+        while (LoopbackServer::ReadFrame(client, hdr, body))
+        {
+            if (hdr.data_type != MSG_DATA)
+                continue;
+            EXPECT_EQ(body.size(), sizeof(rec));
+            std::memcpy(&rec, body.data(), sizeof(rec));
+            return true;
+        }
+        return false;
+    };
+
+    SWhaleRecordV2 rec;
+    lb.InjectTrade("BTCUSDT", 1, 96000, 2);
+    ASSERT_TRUE(next_whale(rec));
+    EXPECT_EQ(rec.symbol, 0u);
+
+    std::vector<uint8_t> update(2);
+    uint16_t cnt = host_to_net_u16(2);
+    std::memcpy(update.data(), &cnt, 2);
+    update.push_back(static_cast<uint8_t>(ESubscriptionAction::Remove));
+    append_symbol(update, "BTCUSDT", 0);
+    update.push_back(static_cast<uint8_t>(ESubscriptionAction::Set));
+    append_symbol(update, "ETHUSDT", 0);
+    send_frame(client, PROTOCOL_VERSION_2, MSG_SUBSCRIPTION_UPDATE, update);
+    ASSERT_TRUE(wait_subscriptions(server, *session, { { 1, 0 } }));
+
+    lb.InjectTrade("BTCUSDT", 2, 96000, 2);
+    lb.InjectTrade("ETHUSDT", 1, 2700, 30);
+    ASSERT_TRUE(next_whale(rec));
+    EXPECT_EQ(rec.symbol, 1u);
+    EXPECT_EQ(rec.quantity, 30);
+}
+
+// The VWAP ticker carries only the session's own coins and follows its in-band updates
+TEST(SessionTest, VwapTickerPerSession) {
+    LoopbackServer lb([](Server& server)
+        {
+            server.SetVwapInterval(10);
+            LoopbackServer::StartPipeline(server);
+        });
+    Server& server = lb.GetServer();
+    auto [client_a, session_a] = lb.Connect();
+    auto [client_b, session_b] = lb.Connect();
+
+    auto subscribe = [&](tcp::socket& client, const char* symbol)
+    {
+        std::vector<uint8_t> payload{ static_cast<uint8_t>(EProtocolDataType::VWAP) };
+        append_symbol(payload, symbol, 0);
+        send_frame(client, PROTOCOL_VERSION_2, MSG_SUBSCRIBE, payload);
+    };
+    subscribe(client_a, "BTCUSDT");
+    subscribe(client_b, "ETHUSDT");
+    ASSERT_TRUE(wait_subscriptions(server, *session_a, { { 0, 0 } }));
+    ASSERT_TRUE(wait_subscriptions(server, *session_b, { { 1, 0 } }));
+
+    // coins of the next ticker frame
+    auto next_tick = [](tcp::socket& client)
+    {
+        std::vector<uint32_t> coins;
+        SProtocolHeader hdr;
+        std::vector<uint8_t> body;
+        while (LoopbackServer::ReadFrame(client, hdr, body))
+        {
+            if (hdr.data_type != MSG_VWAP)
+                continue;
+            for (size_t pos = 0; pos + sizeof(SSnapshotRecordV2) <= body.size(); pos += sizeof(SSnapshotRecordV2))
+            {
+                SSnapshotRecordV2 r;
+                std::memcpy(&r, body.data() + pos, sizeof(r));
+                coins.push_back(r.symbol);
+            }
+            break;
+        }
+        return coins;
+    };
+
+    lb.InjectTrade("BTCUSDT", 1, 96000, 0.1);
+    lb.InjectTrade("ETHUSDT", 1, 2700, 0.1);
+    EXPECT_EQ(next_tick(client_a), std::vector<uint32_t>{ 0 });
+    EXPECT_EQ(next_tick(client_b), std::vector<uint32_t>{ 1 });
+
+    auto update = [&](ESubscriptionAction action, const char* symbol)
+    {
+        std::vector<uint8_t> payload(2);
+        uint16_t cnt = host_to_net_u16(1);
+        std::memcpy(payload.data(), &cnt, 2);
+        payload.push_back(static_cast<uint8_t>(action));
+        append_symbol(payload, symbol, 0);
+        send_frame(client_a, PROTOCOL_VERSION_2, MSG_SUBSCRIPTION_UPDATE, payload);
+    };
+
+    update(ESubscriptionAction::Set, "ETHUSDT");
+    ASSERT_TRUE(wait_subscriptions(server, *session_a, { { 0, 0 }, { 1, 0 } }));
+    lb.InjectTrade("ETHUSDT", 2, 2700, 0.1);
+    EXPECT_EQ(next_tick(client_a), std::vector<uint32_t>{ 1 });
+    EXPECT_EQ(next_tick(client_b), std::vector<uint32_t>{ 1 });
+
+    update(ESubscriptionAction::Remove, "BTCUSDT");
+    ASSERT_TRUE(wait_subscriptions(server, *session_a, { { 1, 0 } }));
+    lb.InjectTrade("BTCUSDT", 2, 96000, 0.1);
+    lb.InjectTrade("ETHUSDT", 3, 2700, 0.1);
+    EXPECT_EQ(next_tick(client_a), std::vector<uint32_t>{ 1 });
+    EXPECT_EQ(next_tick(client_b), std::vector<uint32_t>{ 1 });
+}
+
+// A mega-whale takes the express lane while earlier whales of its symbol are still queued: it stays behind them, so
+// the numbers arrive in order and a client that reconnects from the last one it saw loses nothing
+TEST(SessionTest, ExpressKeepsSymbolOrderForResume) {
+    constexpr size_t QUEUED = 400;
+    constexpr size_t MISSED = 5;
+
+    LoopbackServer lb([](Server& server)
+        {
+            server.SetExpressNotional(1'000'000);
+            LoopbackServer::StartPipeline(server);
+        });
+    Server& server = lb.GetServer();
+    auto [client, session] = lb.Connect(true, 4096, 4096);
+
+    std::vector<uint8_t> subscribe{ static_cast<uint8_t>(EProtocolDataType::Whale) };
+    append_symbol(subscribe, "BTCUSDT", 0);
+    send_frame(client, PROTOCOL_VERSION_2, MSG_SUBSCRIBE, subscribe);
+    ASSERT_TRUE(wait_subscriptions(server, *session, { { 0, 0 } }));
+
+    // the client does not read: the whales pile up in the session queue (one frame each, the dispatcher catches up
+    // between them), then the mega-whale comes
+    uint64_t trade_id = 1;
+    for (size_t i = 0; i < QUEUED; i++)
+    {
+        lb.InjectTrade("BTCUSDT", trade_id++, 96000, 2);
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    lb.InjectTrade("BTCUSDT", trade_id++, 96000, 20);
+
+    // whale numbers of the stream, in arrival order
+    auto read_seqs = [](tcp::socket& socket, size_t expected, SResumeRecordV2* resume)
+    {
+        std::vector<uint64_t> seqs;
+        SProtocolHeader hdr;
+        std::vector<uint8_t> body;
+        while ((seqs.size() < expected || resume) && LoopbackServer::ReadFrame(socket, hdr, body))
+        {
+            if (hdr.data_type == MSG_DATA)
+            {
+                for (size_t pos = 0; pos + sizeof(SWhaleRecordV2) <= body.size(); pos += sizeof(SWhaleRecordV2))
+                {
+                    SWhaleRecordV2 rec;
+                    std::memcpy(&rec, body.data() + pos, sizeof(rec));
+                    seqs.push_back(rec.seq);
+                }
+            }
+            else if (hdr.data_type == MSG_RESUME && resume)
+            {
+                EXPECT_EQ(body.size(), sizeof(SResumeRecordV2));
+                std::memcpy(resume, body.data(), sizeof(SResumeRecordV2));
+                break;
+            }
+        }
+        return seqs;
+    };
+
+    const std::vector<uint64_t> seqs = read_seqs(client, QUEUED + 1, nullptr);
+    ASSERT_EQ(seqs.size(), QUEUED + 1);
+    EXPECT_TRUE(std::is_sorted(seqs.begin(), seqs.end()));
+    EXPECT_EQ(std::adjacent_find(seqs.begin(), seqs.end()), seqs.end());
+    const uint64_t last_seq = seqs.back();
+
+    // the client drops, whales go on, it comes back with the last number it saw
+    client.close();
+    for (size_t i = 0; i < MISSED; i++)
+        lb.InjectTrade("BTCUSDT", trade_id++, 96000, 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto [client2, session2] = lb.Connect();
+    std::vector<uint8_t> resume_sub{ static_cast<uint8_t>(EProtocolDataType::Whale) };
+    append_symbol(resume_sub, "BTCUSDT", 0);
+    resume_sub.push_back(static_cast<uint8_t>(EProtocolEncoding::Fixed));
+    resume_sub.push_back(static_cast<uint8_t>(ESlowConsumerPolicy::DropNewest));
+    resume_sub.insert(resume_sub.end(), 4, 0);                      // max_lag_kb: server default
+    uint16_t cnt = host_to_net_u16(1);
+    resume_sub.insert(resume_sub.end(), (uint8_t*)&cnt, (uint8_t*)&cnt + 2);
+    resume_sub.push_back(7);
+    resume_sub.insert(resume_sub.end(), { 'B', 'T', 'C', 'U', 'S', 'D', 'T' });
+    uint64_t seq_be = host_to_net_u64(last_seq);
+    resume_sub.insert(resume_sub.end(), (uint8_t*)&seq_be, (uint8_t*)&seq_be + 8);
+    send_frame(client2, PROTOCOL_VERSION_2, MSG_SUBSCRIBE, resume_sub);
+
+    SResumeRecordV2 result{};
+    const std::vector<uint64_t> replayed = read_seqs(client2, MISSED, &result);
+    std::vector<uint64_t> expected(MISSED);
+    std::iota(expected.begin(), expected.end(), last_seq + 1);
+    EXPECT_EQ(replayed, expected);
+    EXPECT_EQ(result.symbol, 0u);
+    EXPECT_EQ(result.replayed, MISSED);
+    EXPECT_EQ(result.head_seq, last_seq + MISSED);
+    EXPECT_EQ(result.lost, 0u);
+}
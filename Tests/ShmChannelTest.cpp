@@ -0,0 +1,309 @@
+// ShmChannelTest.cpp
+
+#include <gtest/gtest.h>
+#include <ShmChannel.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+
+static std::string shm_name(const char* tag)
+{
+    return std::string("whales_test_") + tag + "_" + std::to_string(getpid());
+}
+
+static SWhaleRecordV2 make_record(uint64_t i)
+{
+    SWhaleRecordV2 r{};
+    r.price = 96000.0 + i;
+    r.quantity = 1.0 + i;
+    r.timestamp = i;
+    r.symbol = static_cast<uint32_t>(i % 3);
+    return r;
+}
+
+
+TEST(ShmChannelTest, ReaderGetsRecordsInOrder) {
+    ShmWriter<SWhaleRecordV2> writer(shm_name("order"), 64);
+    writer.SetSymbols({ "BTCUSDT", "ETHUSDT", "SOLUSDT" });
+
+    writer.Publish(make_record(0));    // before the reader attached: not seen
+
+    ShmReader<SWhaleRecordV2> reader(shm_name("order"));
+    EXPECT_EQ(reader.GetSymbol(1), "ETHUSDT");
+    EXPECT_EQ(reader.GetSymbol(7), "");
+
+    SWhaleRecordV2 r;
+    EXPECT_FALSE(reader.Poll(r));
+
+    for (uint64_t i = 1; i <= 10; i++)
+        writer.Publish(make_record(i));
+
+    for (uint64_t i = 1; i <= 10; i++)
+    {
+        uint64_t tick = 0;
+        ASSERT_TRUE(reader.Poll(r, &tick));
+        EXPECT_EQ(r.timestamp, i);
+        EXPECT_DOUBLE_EQ(r.price, 96000.0 + i);
+        EXPECT_NE(tick, 0u);
+    }
+    EXPECT_FALSE(reader.Poll(r));
+    EXPECT_EQ(reader.GetLostCount(), 0u);
+}
+
+TEST(ShmChannelTest, LappedReaderCountsLostRecords) {
+    ShmWriter<SWhaleRecordV2> writer(shm_name("lap"), 16);
+    ShmReader<SWhaleRecordV2> reader(shm_name("lap"));
+
+    for (uint64_t i = 1; i <= 40; i++)
+        writer.Publish(make_record(i));
+
+    // the ring holds the last 16 records: 25..40
+    SWhaleRecordV2 r;
+    ASSERT_TRUE(reader.Poll(r));
+    EXPECT_GE(r.timestamp, 25u);
+    EXPECT_EQ(reader.GetLostCount(), r.timestamp - 1);
+
+    uint64_t prev = r.timestamp;
+    while (reader.Poll(r))
+    {
+        EXPECT_EQ(r.timestamp, prev + 1);
+        prev = r.timestamp;
+    }
+    EXPECT_EQ(prev, 40u);
+}
+
+TEST(ShmChannelTest, ConcurrentReaderSeesNoTornRecords) {
+    ShmWriter<SWhaleRecordV2> writer(shm_name("torn"), 1024);
+    ShmReader<SWhaleRecordV2> reader(shm_name("torn"));
+
+    const uint64_t cnt = 200'000;
+
+    std::thread producer([&writer, cnt]()
+        {
+            for (uint64_t i = 1; i <= cnt; i++)
+                writer.Publish(make_record(i));
+        });
+
+    uint64_t got = 0, prev = 0;
+    SWhaleRecordV2 r;
+    while (prev < cnt)
+    {
+        if (!reader.Poll(r))
+            continue;
+
+        ASSERT_GT(r.timestamp, prev);
+        ASSERT_DOUBLE_EQ(r.price, 96000.0 + r.timestamp);
+        ASSERT_DOUBLE_EQ(r.quantity, 1.0 + r.timestamp);
+        prev = r.timestamp;
+        got++;
+    }
+    producer.join();
+
+    EXPECT_EQ(got + reader.GetLostCount(), cnt);
+}
+
+TEST(ShmChannelTest, ReaderRejectsOtherRecordType) {
+    ShmWriter<SMarketRecord> writer(shm_name("type"), 16);
+
+    EXPECT_THROW(ShmReader<SWhaleRecordV2> reader(shm_name("type")), std::runtime_error);
+    EXPECT_THROW(ShmReader<SWhaleRecordV2> reader(shm_name("missing")), std::runtime_error);
+}
+
+// a closed and a replaced channel: the reader notices instead of waiting on a ring nobody writes, and moves on
+TEST(ShmChannelTest, WriterRestartIsDetected) {
+    const std::string name = shm_name("restart");
+    auto writer = std::make_unique<ShmWriter<SWhaleRecordV2>>(name, 16);
+    ShmReader<SWhaleRecordV2> reader(name);
+    EXPECT_EQ(reader.GetGeneration(), writer->GetGeneration());
+
+    SWhaleRecordV2 r;
+    writer->Publish(make_record(1));
+    ASSERT_TRUE(reader.Poll(r));
+    EXPECT_FALSE(reader.IsStale());
+
+    // closed: stale, nothing to reattach to until the writer is back
+    writer.reset();
+    EXPECT_TRUE(reader.IsStale());
+    EXPECT_FALSE(reader.Poll(r));
+    EXPECT_FALSE(reader.Reattach());
+
+    writer = std::make_unique<ShmWriter<SWhaleRecordV2>>(name, 16);
+    writer->Publish(make_record(101));
+    writer->Publish(make_record(102));
+
+    ASSERT_TRUE(reader.Reattach());
+    EXPECT_FALSE(reader.IsStale());
+    EXPECT_EQ(reader.GetRestartCount(), 1u);
+    ASSERT_TRUE(reader.Poll(r));
+    EXPECT_EQ(r.timestamp, 101u);
+    ASSERT_TRUE(reader.Poll(r));
+    EXPECT_EQ(r.timestamp, 102u);
+    EXPECT_FALSE(reader.Poll(r));
+    EXPECT_FALSE(reader.Reattach());
+
+    // a writer that finds the channel of a writer that never closed (crashed) replaces it
+    auto restarted = std::make_unique<ShmWriter<SWhaleRecordV2>>(name, 32);
+    writer->Publish(make_record(103));      // into the replaced ring, not seen
+    restarted->Publish(make_record(201));
+
+    EXPECT_TRUE(reader.IsStale());
+    EXPECT_FALSE(reader.Poll(r));
+    ASSERT_TRUE(reader.Reattach());
+    EXPECT_EQ(reader.GetGeneration(), restarted->GetGeneration());
+    ASSERT_TRUE(reader.Poll(r));
+    EXPECT_EQ(r.timestamp, 201u);
+
+    // the replaced writer closing later leaves the new channel alone
+    writer.reset();
+    EXPECT_FALSE(reader.IsStale());
+    ShmReader<SWhaleRecordV2> late(name);
+    EXPECT_EQ(late.GetGeneration(), restarted->GetGeneration());
+}
+
+#ifndef _WIN32
+static bool read_all(int fd, void* data, size_t size)
+{
+    uint8_t* p = static_cast<uint8_t*>(data);
+    while (size > 0)
+    {
+        ssize_t n = read(fd, p, size);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static void write_all(int fd, const void* data, size_t size)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    while (size > 0)
+    {
+        ssize_t n = write(fd, p, size);
+        if (n <= 0)
+            return;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+#endif
+
+// the writer here, the reader in a forked process with its own mapping of the channel: publish -> Poll latency.
+// The records are paced, so the reader keeps up; the sub-microsecond median needs a core for each side and is
+// only checked with two or more cores
+TEST(ShmChannelTest, TwoProcessLatency) {
+#ifdef _WIN32
+    GTEST_SKIP() << "no fork";
+#else
+    constexpr uint64_t CNT = 20'000;
+    constexpr auto PACE = std::chrono::microseconds(10);
+
+    const std::string name = shm_name("latency");
+    ShmWriter<SWhaleRecordV2> writer(name, 64 * 1024);
+
+    auto t0 = std::chrono::steady_clock::now();
+    const uint64_t r0 = __rdtsc();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const double ghz = static_cast<double>(__rdtsc() - r0) / std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+    struct Result
+    {
+        uint64_t got;
+        uint64_t lost;
+    };
+    std::vector<uint64_t> ticks(CNT);      // allocated before the fork, the reader fills its copy
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+
+    const pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0)
+    {
+        close(fds[0]);
+        Result res{ 0, 0 };
+        try
+        {
+            ShmReader<SWhaleRecordV2> reader(name);
+            const char ready = 1;
+            write_all(fds[1], &ready, 1);
+
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            SWhaleRecordV2 r;
+            uint64_t tick_pub = 0;
+            while (res.got + reader.GetLostCount() < CNT && std::chrono::steady_clock::now() < deadline)
+            {
+                for (int i = 0; i < 1024; i++)
+                {
+                    if (!reader.Poll(r, &tick_pub))
+                        continue;
+                    const uint64_t now = __rdtsc();
+                    ticks[res.got++] = now - tick_pub;
+                    if (res.got + reader.GetLostCount() == CNT)
+                        break;
+                }
+            }
+            res.lost = reader.GetLostCount();
+        }
+        catch (const std::exception&)
+        {
+        }
+
+        write_all(fds[1], &res, sizeof(res));
+        write_all(fds[1], ticks.data(), res.got * sizeof(uint64_t));
+        close(fds[1]);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    char ready = 0;
+    ASSERT_TRUE(read_all(fds[0], &ready, 1)) << "reader process failed to attach";
+
+    const uint64_t pace_ticks = static_cast<uint64_t>(std::chrono::duration<double, std::nano>(PACE).count() * ghz);
+    uint64_t next = __rdtsc();
+    for (uint64_t i = 1; i <= CNT; i++)
+    {
+        next += pace_ticks;
+        while (__rdtsc() < next)
+            std::this_thread::yield();
+        writer.Publish(make_record(i));
+    }
+
+    Result res{ 0, 0 };
+    const bool got_result = read_all(fds[0], &res, sizeof(res)) && read_all(fds[0], ticks.data(), res.got * sizeof(uint64_t));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    ASSERT_TRUE(got_result);
+    EXPECT_EQ(res.got + res.lost, CNT);
+    EXPECT_EQ(res.lost, 0u);
+    ASSERT_GT(res.got, 0u);
+
+    ticks.resize(res.got);
+    std::sort(ticks.begin(), ticks.end());
+    auto ns = [&](double p) { return static_cast<double>(ticks[static_cast<size_t>(p * (ticks.size() - 1))]) / ghz; };
+
+    const unsigned cores = std::thread::hardware_concurrency();
+    std::cout << "[          ] two processes, " << cores << " cores | publish -> poll P50 " << ns(0.5) << " ns P99 " << ns(0.99)
+        << " ns P99.9 " << ns(0.999) << " ns" << std::endl;
+
+    if (cores >= 2)
+    {
+        EXPECT_LT(ns(0.5), 1000.0);
+    }
+#endif
+}
@@ -0,0 +1,107 @@
+// SocketProfileTest.cpp
+
+#include <gtest/gtest.h>
+#include "LoopbackServer.h"
+#include <SocketProfile.h>
+#include <boost/asio.hpp>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <cstring>
+
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+
+
+TEST(SocketProfileTest, ParseAndApply) {
+    SocketProfile p = ParseSocketProfile("nodelay=1,sndbuf=262144,rcvbuf=131072,quickack=1,txts=1");
+
+    EXPECT_TRUE(p.no_delay);
+    EXPECT_EQ(p.send_buffer, 262144);
+    EXPECT_EQ(p.recv_buffer, 131072);
+    EXPECT_EQ(p.busy_poll_us, 0);
+    EXPECT_TRUE(p.quick_ack);
+    EXPECT_TRUE(p.tx_timestamps);
+    EXPECT_FALSE(ParseSocketProfile("nodelay=0").no_delay);
+
+    asio::io_context io;
+    tcp::acceptor acceptor(io, tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    tcp::socket client(io);
+    client.connect(acceptor.local_endpoint());
+    tcp::socket peer = acceptor.accept();
+
+    p.tx_timestamps = false;
+    EXPECT_TRUE(ApplySocketProfile(peer, p));
+
+    tcp::no_delay no_delay;
+    peer.get_option(no_delay);
+    EXPECT_TRUE(no_delay.value());
+
+    asio::socket_base::send_buffer_size sndbuf;
+    peer.get_option(sndbuf);
+    EXPECT_GE(sndbuf.value(), p.send_buffer);
+}
+
+TEST(TxLatencyTest, PowerOfTwoBuckets) {
+    TxLatency lat;
+    for (int i = 0; i < 99; i++)
+        lat.Add(1000);      // [512, 1024)... 1000 -> bucket 9, upper bound 1024
+    lat.Add(1'000'000);
+
+    EXPECT_EQ(lat.count.load(), 100u);
+    EXPECT_EQ(lat.Percentile(0.5), 1024u);
+    EXPECT_EQ(lat.Percentile(0.99), 1024u);
+    EXPECT_EQ(lat.Percentile(1.0), 1u << 20);
+
+    TxLatency all;
+    all.Merge(lat);
+    lat.Reset();
+    EXPECT_EQ(lat.Percentile(0.5), 0u);
+    EXPECT_EQ(all.count.load(), 100u);
+}
+
+#ifdef __linux__
+// SO_TIMESTAMPING: every whale write of the session gets its delivery -> kernel transmit time
+TEST(SocketProfileTest, TxTimestampsPerSession) {
+    constexpr int SEGMENTS = 50;
+
+    LoopbackServer lb([](Server& server) { server.SetSocketProfile(ParseSocketProfile("nodelay=1,txts=1")); });
+    Server& server = lb.GetServer();
+    auto [client, session] = lb.Connect();
+
+    WhaleEvent ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.price = 96000.0;
+    ev.quantity = 2.0;
+
+    size_t frame_size = 0;
+    for (int i = 0; i < SEGMENTS; i++)
+    {
+        Frame* segment = lb.GetPool().Acquire(WhaleRecordsV1MaxSize(1));
+        segment->size = EncodeWhaleRecordsV1(segment->data(), &ev, 1, server.GetSymbolWire(), server.GetCoinCount());
+        segment->count = 1;
+        segment->ind_symbol = 0;
+        segment->tick_deliver = __rdtsc();
+        frame_size = WHALE_FRAME_HEAD_SIZE + segment->size;
+
+        session->DeliverSegment(segment);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::vector<uint8_t> buf(frame_size * SEGMENTS);
+    asio::read(client, asio::buffer(buf));
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (session->GetTxLatency().count.load() < static_cast<uint64_t>(SEGMENTS) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    const TxLatency& lat = session->GetTxLatency();
+    std::cout << "[          ] TX timestamps: " << lat.count.load() << " | P50 " << lat.Percentile(0.5) << " ns P99 " << lat.Percentile(0.99) << " ns" << std::endl;
+
+    // one timestamp per write, writes may coalesce several segments
+    EXPECT_GT(lat.count.load(), 0u);
+    EXPECT_LE(lat.count.load(), static_cast<uint64_t>(SEGMENTS));
+    EXPECT_GT(lat.Percentile(0.5), 0u);
+    EXPECT_LT(lat.Percentile(0.5), 1'000'000'000u);
+}
+#endif
@@ -0,0 +1,211 @@
+// TradeIdTrackerTest.cpp
+
+#include <gtest/gtest.h>
+#include "TradeIdTracker.h"
+#include "TradeBackfill.h"
+#include "Server.h"
+#include <ShmChannel.h>
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+
+TEST(TradeIdTrackerTest, DuplicatesAndGaps) {
+    TradeIdTracker ids(2);
+    TradeIdGap gap;
+
+    for (uint64_t id = 100; id <= 103; id++)
+    {
+        EXPECT_TRUE(ids.Accept(0, id, gap));
+        EXPECT_EQ(gap.count, 0u);
+    }
+
+    // the same trade from a second connection
+    EXPECT_FALSE(ids.Accept(0, 102, gap));
+    EXPECT_FALSE(ids.Accept(0, 103, gap));
+    EXPECT_EQ(ids.GetDuplicates(), 2u);
+
+    // 104..106 jumped over, then filled in once
+    EXPECT_EQ(ids.Accept(0, 107, gap), TRADE_ID_FRESH);
+    EXPECT_EQ(gap.from_id, 104u);
+    EXPECT_EQ(gap.count, 3u);
+    EXPECT_EQ(ids.Accept(0, 105, gap), TRADE_ID_RECOVERED);
+    EXPECT_FALSE(ids.Accept(0, 105, gap));
+    EXPECT_EQ(ids.GetMissing(), 3u);
+    EXPECT_EQ(ids.GetRecovered(), 1u);
+
+    // symbols are independent, id 0 (emulator) is never checked
+    EXPECT_TRUE(ids.Accept(1, 5, gap));
+    EXPECT_EQ(gap.count, 0u);
+    EXPECT_TRUE(ids.Accept(0, 0, gap));
+    EXPECT_TRUE(ids.Accept(0, 0, gap));
+    EXPECT_EQ(ids.GetHead(0), 107u);
+
+    // past the window: the bitmap is cleared, older ids are late
+    EXPECT_TRUE(ids.Accept(0, 107 + 3 * TRADE_ID_WINDOW, gap));
+    EXPECT_EQ(gap.count, 3 * TRADE_ID_WINDOW - 1);
+    EXPECT_FALSE(ids.Accept(0, 106, gap));
+    EXPECT_EQ(ids.GetLate(), 1u);
+    EXPECT_TRUE(ids.Accept(0, 108 + 2 * TRADE_ID_WINDOW, gap));
+    EXPECT_FALSE(ids.Accept(0, 108 + 2 * TRADE_ID_WINDOW, gap));
+}
+
+// local stand-in for the exchange REST snapshot: trades 1..'last' of every symbol
+class StandInSource : public TradeSnapshotSource
+{
+public:
+    explicit StandInSource(uint64_t last) : m_last(last) {}
+
+    bool Fetch(const std::string& symbol, uint64_t from_id, uint32_t limit, std::vector<BackfillTrade>& out) override
+    {
+        out.clear();
+        for (uint64_t id = from_id; id <= m_last && out.size() < limit; id++)
+            out.push_back(BackfillTrade{ id, 1700000000000 + id, 100.0 + static_cast<double>(id), 1.0, (id & 1) != 0 });
+        calls++;
+        return symbol == "BTCUSDT";
+    }
+
+    std::atomic<int> calls{ 0 };
+
+private:
+    uint64_t m_last;
+};
+
+TEST(TradeIdTrackerTest, BackfillFromSnapshot) {
+    auto source = std::make_unique<StandInSource>(5000);
+    StandInSource* stand_in = source.get();
+
+    std::mutex mtx;
+    std::vector<BackfillTrade> received;
+    TradeBackfill backfill(std::move(source), { "BTCUSDT", "ETHUSDT" },
+        [&](int ind_symbol, const std::vector<BackfillTrade>& trades)
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            if (ind_symbol == 0)
+                received.insert(received.end(), trades.begin(), trades.end());
+        });
+    backfill.Start();
+
+    // a reconnect lost 11..1999: only the ids still inside the window are requested, in pages
+    TradeIdTracker ids(2);
+    TradeIdGap gap;
+    for (uint64_t id = 1; id <= 10; id++)
+        ids.Accept(0, id, gap);
+    ASSERT_TRUE(ids.Accept(0, 2000, gap));
+    ASSERT_EQ(gap.count, 1989u);
+
+    const uint64_t from_id = std::max(gap.from_id, 2000 + 1 - TRADE_ID_WINDOW);
+    EXPECT_TRUE(backfill.Request(0, from_id, 2000 - from_id));
+    EXPECT_TRUE(backfill.Request(1, 1, 10));     // the snapshot fails for this symbol
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((backfill.GetFetched() < TRADE_ID_WINDOW - 1 || backfill.GetFailed() == 0) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    backfill.Stop();
+
+    EXPECT_EQ(backfill.GetRequests(), 2u);
+    EXPECT_EQ(backfill.GetFailed(), 1u);
+    EXPECT_EQ(stand_in->calls.load(), 4);      // 1023 ids in pages of 500 + the failed one
+
+    // the fetched trades go back through the tracker: each taken once, the gap end (2000) is not refetched
+    ASSERT_EQ(received.size(), TRADE_ID_WINDOW - 1);
+    EXPECT_EQ(received.front().trade_id, from_id);
+    EXPECT_EQ(received.back().trade_id, 1999u);
+    for (const auto& t : received)
+        EXPECT_EQ(ids.Accept(0, t.trade_id, gap), TRADE_ID_RECOVERED);
+    EXPECT_EQ(ids.GetRecovered(), TRADE_ID_WINDOW - 1);
+    EXPECT_FALSE(ids.Accept(0, 1500, gap));
+}
+
+// trades filled in below the head count in the session totals only: the last trade does not go back and no whale is
+// emitted for them
+TEST(TradeIdTrackerTest, RecoveredTradeKeepsLastTrade) {
+    const std::string shm = "whales_test_recovered_" + std::to_string(getpid());
+
+    boost::asio::io_context io;
+    Server server(io, 0);
+    server.EnableShowLogMsg(false);
+    server.EnableDataEmulation(false);
+    server.SetFeedUrl("ws://127.0.0.1:1/ws");       // nothing listens: the trades come from the test only
+    ASSERT_TRUE(server.EnableShm(shm));
+    ShmReader<SWhaleRecordV2> whales(shm + ".whales");
+    server.Start();
+
+    auto trade = [&](uint64_t id, const char* price, const char* qty)
+    {
+        const std::string msg = std::string(R"({"e":"trade","E":)") + std::to_string(1700000000000 + id) +
+            R"(,"s":"BTCUSDT","t":)" + std::to_string(id) + R"(,"p":")" + price + R"(","q":")" + qty + R"(","m":true})";
+        ASSERT_EQ(server.ProcessMarketMsg(msg, msg.size(), __rdtsc()), 1u);
+    };
+
+    // the coin analytics are process-wide: counted from the first trade of this test on
+    CoinSnapshot base{};
+
+    auto wait_trades = [&](uint64_t cnt, CoinSnapshot& snap)
+    {
+        cnt += base.trade_cnt;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!(server.GetCoinSnapshot(0, snap) && snap.trade_cnt >= cnt) && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    };
+
+    trade(100, "96000.1", "0.01");
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!(server.GetCoinSnapshot(0, base) && base.timestamp == 1700000000100u) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    ASSERT_EQ(base.timestamp, 1700000000100u);
+
+    trade(103, "96000.3", "0.01");
+    trade(101, "95000.0", "5");         // recovered, whale-sized
+
+    CoinSnapshot snap;
+    wait_trades(2, snap);
+    EXPECT_EQ(snap.trade_cnt - base.trade_cnt, 2u);
+    EXPECT_DOUBLE_EQ(snap.last_price, 96000.3);
+    EXPECT_EQ(snap.timestamp, 1700000000103u);
+    EXPECT_NEAR(snap.volume_sess - base.volume_sess, 5.01, 1e-9);
+
+    trade(104, "96000.4", "2");         // fresh whale
+    wait_trades(3, snap);
+    EXPECT_DOUBLE_EQ(snap.last_price, 96000.4);
+
+    SWhaleRecordV2 rec;
+    deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    bool got = false;
+    while (!(got = whales.Poll(rec)) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    ASSERT_TRUE(got);
+    EXPECT_DOUBLE_EQ(rec.price, 96000.4);
+    EXPECT_FALSE(whales.Poll(rec));
+
+    server.Stop();
+}
+
+TEST(TradeIdTrackerTest, RestResponse) {
+    std::vector<BackfillTrade> trades;
+
+    const std::string body = R"([{"id":28457,"price":"96000.10","qty":"0.003","quoteQty":"288.0003","time":1700000000000,"isBuyerMaker":true},)"
+        R"({"id":28458,"price":"96000.2","qty":"1.5","quoteQty":"144000.3","time":1700000000001,"isBuyerMaker":false}])";
+    ASSERT_TRUE(RestTradeSource::ParseTrades(body, trades));
+    ASSERT_EQ(trades.size(), 2u);
+    EXPECT_EQ(trades[0].trade_id, 28457u);
+    EXPECT_EQ(trades[0].price, 96000.10);
+    EXPECT_EQ(trades[0].quantity, 0.003);
+    EXPECT_EQ(trades[0].timestamp, 1700000000000u);
+    EXPECT_TRUE(trades[0].is_sell);
+    EXPECT_FALSE(trades[1].is_sell);
+
+    EXPECT_TRUE(RestTradeSource::ParseTrades("[]", trades));
+    EXPECT_TRUE(trades.empty());
+    EXPECT_FALSE(RestTradeSource::ParseTrades(R"({"code":-2014,"msg":"API-key format invalid."})", trades));
+}
@@ -0,0 +1,180 @@
+// TradeParserTest.cpp
+
+#include <gtest/gtest.h>
+#include "TradeParser.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+
+TEST(TradeParserTest, DecimalMatchesFromChars) {
+    std::mt19937_64 rng(42);
+    char text[64];
+
+    for (int i = 0; i < 200'000; i++)
+    {
+        const int scale = static_cast<int>(rng() % 9);
+        const uint64_t units = rng() % 100'000'000'000ull;
+        int len = std::snprintf(text, sizeof(text), "%llu", static_cast<unsigned long long>(units));
+        if (scale > 0)
+        {
+            // "123456" -> "1234.56"
+            std::string s(text, len);
+            while (static_cast<int>(s.size()) <= scale)
+                s.insert(s.begin(), '0');
+            s.insert(s.end() - scale, '.');
+            len = std::snprintf(text, sizeof(text), "%s", s.c_str());
+        }
+
+        double fast = 0.0, ref = 0.0;
+        ASSERT_TRUE(ParseDecimal(text, text + len, fast)) << text;
+        std::from_chars(text, text + len, ref);
+        ASSERT_EQ(fast, ref) << text;
+    }
+
+    // not a plain decimal: std::from_chars decides
+    double v = 0.0;
+    const char exp[] = "1.5e3", neg[] = "-2.25", bad[] = "12a", empty[] = "";
+    EXPECT_TRUE(ParseDecimal(exp, exp + 5, v));
+    EXPECT_EQ(v, 1500.0);
+    EXPECT_TRUE(ParseDecimal(neg, neg + 5, v));
+    EXPECT_EQ(v, -2.25);
+    EXPECT_FALSE(ParseDecimal(bad, bad + 3, v));
+    EXPECT_FALSE(ParseDecimal(empty, empty, v));
+}
+
+TEST(TradeParserTest, MessageShapes) {
+    TradeParser parser;
+    std::vector<TradeFields> trades;
+    std::vector<std::string> symbols;
+    auto collect = [&](const TradeFields& t) { trades.push_back(t); symbols.emplace_back(t.symbol); };
+
+    const std::string trade = R"({"e":"trade","E":1700000000001,"T":1700000000000,"s":"BTCUSDT","t":5001,"p":"96000.10","q":"0.003","X":"MARKET","m":true})";
+    EXPECT_EQ(parser.Parse(trade, collect), 1u);
+    ASSERT_EQ(trades.size(), 1u);
+    EXPECT_EQ(symbols[0], "BTCUSDT");
+    EXPECT_EQ(trades[0].timestamp, 1700000000001u);
+    EXPECT_EQ(trades[0].trade_id, 5001u);
+    EXPECT_EQ(trades[0].price, 96000.10);
+    EXPECT_EQ(trades[0].quantity, 0.003);
+    EXPECT_TRUE(trades[0].is_sell);
+
+    // combined stream, array, fields in another order, subscribe answer
+    EXPECT_EQ(parser.Parse(std::string(R"({"stream":"ethusdt@trade","data":{"e":"trade","E":2,"s":"ETHUSDT","t":7,"p":"2700.5","q":"1.25","m":false}})"), collect), 1u);
+    EXPECT_EQ(parser.Parse(std::string(R"([{"E":3,"s":"SOLUSDT","t":8,"p":"180","q":"2","m":false},{"m":true,"q":"4","p":"600.1","t":9,"s":"BNBUSDT","E":4}])"), collect), 2u);
+    EXPECT_EQ(parser.Parse(std::string(R"({"result":null,"id":1})"), collect), 0u);
+    EXPECT_EQ(parser.Parse(std::string(R"({"E":5,"s":)"), collect), 0u);
+
+    ASSERT_EQ(trades.size(), 4u);
+    EXPECT_EQ(symbols[1], "ETHUSDT");
+    EXPECT_EQ(trades[1].price, 2700.5);
+    EXPECT_EQ(symbols[2], "SOLUSDT");
+    EXPECT_EQ(symbols[3], "BNBUSDT");
+    EXPECT_EQ(trades[3].trade_id, 9u);
+    EXPECT_EQ(trades[3].price, 600.1);
+    EXPECT_TRUE(trades[3].is_sell);
+
+    // an envelope with "data" first, an array in the envelope
+    EXPECT_EQ(parser.Parse(std::string(R"({"data":{"e":"trade","E":6,"s":"BTCUSDT","t":10,"p":"96000","q":"1","m":true},"stream":"btcusdt@trade"})"), collect), 1u);
+    EXPECT_EQ(parser.Parse(std::string(R"({"stream":"btcusdt@trade","data":[{"E":7,"s":"BTCUSDT","t":11,"p":"96001","q":"1","m":true},{"E":8,"s":"BTCUSDT","t":12,"p":"96002","q":"1","m":false}]})"), collect), 2u);
+    ASSERT_EQ(trades.size(), 7u);
+    EXPECT_EQ(trades[4].trade_id, 10u);
+    EXPECT_EQ(trades[6].trade_id, 12u);
+    EXPECT_EQ(trades[6].price, 96002.0);
+}
+
+// frames in the Binance futures trade stream format: the previous DOM + std::from_chars path against On-Demand,
+// and the same trades in the combined stream envelope the feed connections use
+TEST(TradeParserTest, Benchmark) {
+    constexpr size_t FRAMES = 20'000;
+    constexpr int ROUNDS = 5;
+
+    const char* names[] = { "BTCUSDT", "ETHUSDT", "SOLUSDT", "BNBUSDT" };
+    const double prices[] = { 96000.0, 2700.0, 180.0, 600.0 };
+
+    std::mt19937_64 rng(7);
+    std::vector<std::string> frames, envelopes;
+    frames.reserve(FRAMES);
+    envelopes.reserve(FRAMES);
+    char text[256];
+    for (size_t i = 0; i < FRAMES; i++)
+    {
+        const size_t c = i % 4;
+        const double price = prices[c] * (1.0 + (static_cast<int>(rng() % 2001) - 1000) * 1e-5);
+        const double qty = static_cast<double>(rng() % 500'000) / 1000.0;
+        std::snprintf(text, sizeof(text),
+            R"({"e":"trade","E":%llu,"T":%llu,"s":"%s","t":%llu,"p":"%.2f","q":"%.3f","X":"MARKET","m":%s})",
+            1700000000000ull + i, 1700000000000ull + i - 1, names[c], 5000000000ull + i, price, qty, (rng() & 1) ? "true" : "false");
+        frames.emplace_back(text);
+
+        std::string stream(names[c]);
+        std::transform(stream.begin(), stream.end(), stream.begin(), [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+        envelopes.push_back(R"({"stream":")" + stream + R"(@trade","data":)" + frames.back() + "}");
+    }
+
+    double sum_dom = 0.0, sum_od = 0.0, sum_env = 0.0;
+
+    simdjson::dom::parser dom_parser;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        for (const auto& frame : frames)
+        {
+            simdjson::dom::element item = dom_parser.parse(frame);
+            std::string_view s = item["s"].get_string();
+            uint64_t ts = item["E"].get_uint64();
+            double price = 0.0, qty = 0.0;
+            std::string_view p = item["p"].get_string();
+            std::from_chars(p.data(), p.data() + p.size(), price);
+            std::string_view q = item["q"].get_string();
+            std::from_chars(q.data(), q.data() + q.size(), qty);
+            bool is_sell = item["m"].get_bool();
+            uint64_t trade_id = item["t"].get_uint64();
+            sum_dom += price * qty + static_cast<double>(ts + trade_id + s.size() + is_sell);
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    TradeParser parser;
+    size_t cnt = 0;
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        for (const auto& frame : frames)
+        {
+            cnt += parser.Parse(frame, [&](const TradeFields& t)
+                {
+                    sum_od += t.price * t.quantity + static_cast<double>(t.timestamp + t.trade_id + t.symbol.size() + t.is_sell);
+                });
+        }
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    size_t cnt_env = 0;
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        for (const auto& envelope : envelopes)
+        {
+            cnt_env += parser.Parse(envelope, [&](const TradeFields& t)
+                {
+                    sum_env += t.price * t.quantity + static_cast<double>(t.timestamp + t.trade_id + t.symbol.size() + t.is_sell);
+                });
+        }
+    }
+    auto t3 = std::chrono::steady_clock::now();
+
+    const double trades = static_cast<double>(FRAMES * ROUNDS);
+    const double ns_dom = std::chrono::duration<double, std::nano>(t1 - t0).count() / trades;
+    const double ns_od = std::chrono::duration<double, std::nano>(t2 - t1).count() / trades;
+    const double ns_env = std::chrono::duration<double, std::nano>(t3 - t2).count() / trades;
+    std::cout << "[          ] DOM + from_chars: " << ns_dom << " ns/trade | On-Demand + fixed decimal: " << ns_od
+        << " ns/trade | combined stream envelope: " << ns_env << " ns/trade" << std::endl;
+
+    EXPECT_EQ(cnt, FRAMES * ROUNDS);
+    EXPECT_EQ(sum_od, sum_dom);
+    EXPECT_EQ(cnt_env, FRAMES * ROUNDS);
+    EXPECT_EQ(sum_env, sum_dom);
+}
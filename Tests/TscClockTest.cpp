@@ -0,0 +1,77 @@
+// TscClockTest.cpp
+
+#include <gtest/gtest.h>
+#include "TscClock.h"
+#include "DeliveryLatency.h"
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+
+static double measure_ghz()
+{
+    auto t1 = std::chrono::steady_clock::now();
+    uint64_t r1 = __rdtsc();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto t2 = std::chrono::steady_clock::now();
+    uint64_t r2 = __rdtsc();
+    return static_cast<double>(r2 - r1) / std::chrono::duration<double, std::nano>(t2 - t1).count();
+}
+
+TEST(TscClockTest, MapsToWallClock) {
+    TscClock clock;
+    clock.Start(measure_ghz());
+
+    auto check = [&]()
+    {
+        const int64_t before = TscClock::NowEpochNs();
+        const int64_t mapped = clock.ToEpochNs(__rdtsc());
+        const int64_t after = TscClock::NowEpochNs();
+        EXPECT_GE(mapped, before - 1'000'000);
+        EXPECT_LE(mapped, after + 1'000'000);
+    };
+
+    check();
+
+    // re-anchored with the rate measured over a second of baseline
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    clock.Update();
+    check();
+
+    const TscCalibration cal = clock.Get();
+    EXPECT_NEAR(cal.ghz, measure_ghz(), cal.ghz * 0.01);
+
+    // monotonic and ns-scaled around the anchor
+    EXPECT_EQ(cal.ToEpochNs(cal.base_tsc), cal.base_epoch_ns);
+    EXPECT_NEAR(static_cast<double>(cal.ToEpochNs(cal.base_tsc + static_cast<uint64_t>(cal.ghz * 1e6)) - cal.base_epoch_ns), 1e6, 1.0);
+    EXPECT_LT(cal.ToEpochNs(cal.base_tsc - 1000), cal.base_epoch_ns);
+}
+
+TEST(TscClockTest, FeedLatencyStages) {
+    FeedLatency lat;
+    FeedLatency::Local local;
+
+    local.buckets[0][TxLatency::Bucket(3'000'000)] += 10;      // 3 ms exchange -> receive
+    local.buckets[1][TxLatency::Bucket(2'000)] += 10;          // 2 us parse
+    local.buckets[2][TxLatency::Bucket(500)] += 10;
+    local.AddExchange(-5'000'000);                              // stamped ahead of our clock
+    local.AddExchange(-1);
+    local.AddExchange(static_cast<int64_t>(TxLatency::OVERFLOW_NS));    // a clock step, not a latency
+    local.AddExchange(1'700'000'000'000'000'000);               // "E" of 0 would land here
+    lat.Merge(local);
+
+    EXPECT_EQ(lat.exchange.count.load(), 10u);
+    EXPECT_EQ(lat.parse.count.load(), 10u);
+    EXPECT_EQ(lat.ahead.load(), 2u);
+    EXPECT_EQ(lat.late.load(), 2u);
+    EXPECT_EQ(local.ahead, 0u);
+    EXPECT_EQ(local.late, 0u);
+    EXPECT_EQ(lat.exchange.buckets[TxLatency::BUCKET_CNT - 1].load(), 0u);
+    EXPECT_EQ(local.buckets[0][TxLatency::Bucket(3'000'000)], 0u);
+
+    // power-of-two buckets: the bound is within 2x above the value
+    EXPECT_GE(lat.exchange.Percentile(0.5), 3'000'000u);
+    EXPECT_LT(lat.exchange.Percentile(0.5), 6'000'001u);
+    EXPECT_GE(lat.parse.Percentile(0.99), 2'000u);
+    EXPECT_LT(lat.analytics.Percentile(0.99), 1'001u);
+}
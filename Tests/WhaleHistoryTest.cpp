@@ -0,0 +1,68 @@
+// WhaleHistoryTest.cpp
+
+#include <gtest/gtest.h>
+#include "WhaleHistory.h"
+#include <cstring>
+#include <vector>
+
+
+static WhaleEvent make_whale(int ind_symbol, double price)
+{
+    WhaleEvent we;
+    std::memset(&we, 0, sizeof(we));
+    we.index_symbol = static_cast<int16_t>(ind_symbol);
+    we.price = price;
+    we.quantity = 1.0;
+    return we;
+}
+
+TEST(WhaleHistoryTest, NumbersPerSymbol) {
+    WhaleHistory history(2);
+
+    WhaleEvent a = make_whale(0, 1.0), b = make_whale(1, 2.0), c = make_whale(0, 3.0), bad = make_whale(-1, 4.0);
+    history.Add(a);
+    history.Add(b);
+    history.Add(c);
+    history.Add(bad);
+
+    EXPECT_EQ(a.seq, 1u);
+    EXPECT_EQ(b.seq, 1u);
+    EXPECT_EQ(c.seq, 2u);
+    EXPECT_EQ(bad.seq, 0u);
+    EXPECT_EQ(history.GetHead(0), 2u);
+    EXPECT_EQ(history.GetHead(1), 1u);
+
+    std::vector<WhaleEvent> out;
+    EXPECT_EQ(history.CollectAfter(0, 1, out), 0u);
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(out[0].seq, 2u);
+    EXPECT_EQ(out[0].price, 3.0);
+
+    // up to date: nothing to resend
+    out.clear();
+    EXPECT_EQ(history.CollectAfter(1, 1, out), 0u);
+    EXPECT_TRUE(out.empty());
+}
+
+// a client that was away longer than the history: the kept tail is resent, the rest is reported lost
+TEST(WhaleHistoryTest, OverwrittenAreLost) {
+    WhaleHistory history(1);
+
+    const uint64_t total = WHALE_HISTORY_DEPTH + 100;
+    for (uint64_t i = 1; i <= total; i++)
+    {
+        WhaleEvent we = make_whale(0, static_cast<double>(i));
+        history.Add(we);
+    }
+
+    EXPECT_EQ(history.GetFirst(0), 101u);
+
+    std::vector<WhaleEvent> out;
+    EXPECT_EQ(history.CollectAfter(0, 50, out), 50u);
+    ASSERT_EQ(out.size(), WHALE_HISTORY_DEPTH);
+    for (size_t i = 0; i < out.size(); i++)
+    {
+        EXPECT_EQ(out[i].seq, 101 + i);
+        EXPECT_EQ(out[i].price, static_cast<double>(101 + i));
+    }
+}